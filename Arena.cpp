@@ -0,0 +1,44 @@
+#include "Arena.h"
+#include <algorithm>
+
+void* Arena::Grow(size_t bytes, size_t align)
+{
+	// chunks from new[] are aligned for any fundamental type, so only a
+	// larger alignment needs slack
+	size_t need = bytes + (align > alignof(std::max_align_t) ? align : 0);
+
+	// a chunk left behind by Rewind() may still be big enough
+	size_t next = current < chunks.size() ? current + 1 : chunks.size();
+	while (next < chunks.size() && chunks[next].size < need)
+		++next;
+	if (next == chunks.size())
+	{
+		size_t size = std::max(need, chunks.empty() ? chunk_size : chunks.back().size * 2);
+		chunks.push_back(Chunk{ std::unique_ptr<char[]>{ new char[size] }, size });
+	}
+
+	current = next;
+	used = 0;
+	return Allocate_Bytes(bytes, align);
+}
+
+void Arena::Reset(size_t capacity)
+{
+	size_t total = Capacity();
+	if (chunks.size() > 1 || total < capacity)
+	{
+		total = std::max(total, capacity);
+		chunks.clear();
+		chunks.push_back(Chunk{ std::unique_ptr<char[]>{ new char[total] }, total });
+	}
+	current = 0;
+	used = 0;
+}
+
+size_t Arena::Capacity() const
+{
+	size_t total = 0;
+	for (const Chunk& chunk : chunks)
+		total += chunk.size;
+	return total;
+}
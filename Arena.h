@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Monotonic scratch allocator.
+ *
+ * Allocate() bumps a pointer through a chunk of memory and takes the next
+ * chunk when that one is full; nothing is freed on its own. Rewind() goes
+ * back to a Get_Mark() taken earlier, and Reset() releases everything in
+ * O(1). Chunks are never returned to the heap, so once an arena has grown
+ * to the most it is asked to hold at once it makes no further allocations;
+ * Reset() also merges the chunks into one, so the next round is contiguous.
+ *
+ * Nothing in an arena is ever destroyed, hence only trivially destructible
+ * types go in it.
+ */
+class Arena
+{
+public:
+	explicit Arena(size_t chunk_size = 64 << 10) :
+		chunk_size{ chunk_size }
+	{}
+
+	struct Mark
+	{
+		size_t chunk;
+		size_t used;
+	};
+
+	template <typename T>
+	T* Allocate(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destroyed");
+		return static_cast<T*>(Allocate_Bytes(count * sizeof(T), alignof(T)));
+	}
+
+	Mark Get_Mark() const
+	{ return Mark{ current, used }; }
+
+	void Rewind(Mark mark)
+	{ current = mark.chunk; used = mark.used; }
+
+	// with a capacity, the merged chunk also holds at least that many bytes
+	void Reset(size_t capacity = 0);
+
+	// bytes held, whether in use or not
+	size_t Capacity() const;
+
+private:
+	struct Chunk
+	{
+		std::unique_ptr<char[]> data;
+		size_t size;
+	};
+
+	std::vector<Chunk> chunks;
+	size_t current = 0;		// chunk being filled
+	size_t used = 0;		// bytes of it in use
+	size_t chunk_size;
+
+	void* Allocate_Bytes(size_t bytes, size_t align)
+	{
+		if (current < chunks.size())
+		{
+			char* base = chunks[current].data.get();
+			size_t offset = ((reinterpret_cast<uintptr_t>(base) + used + align - 1) & ~(align - 1)) - reinterpret_cast<uintptr_t>(base);
+			if (offset + bytes <= chunks[current].size)
+			{
+				used = offset + bytes;
+				return base + offset;
+			}
+		}
+		return Grow(bytes, align);
+	}
+
+	void* Grow(size_t bytes, size_t align);
+};
@@ -0,0 +1,100 @@
+#include "CsvLoader.h"
+#include "Glicko2.h"
+#include <utility>
+
+CsvLoader::CsvLoader(unsigned threads, std::string directory) :
+	pool{ threads },
+	directory{ std::move(directory) }
+{
+	for (unsigned i = 0; i < pool.Get_Threads(); i++)
+		readers.emplace_back(new CsvReader);
+}
+
+bool CsvLoader::Open(CsvReader& reader, const std::string& filename) const
+{
+	return reader.Open(filename.c_str()) || (!directory.empty() && reader.Open((directory + filename).c_str()));
+}
+
+int CsvLoader::Load(const char* filename, Glicko2& system)
+{
+	error_file.clear();
+	error_line = 0;
+
+	// the system CSV, one row per player
+	CsvReader& in = *readers[0];
+	if (!Open(in, filename))
+		return CANNOT_OPEN;
+
+	std::vector<Row> rows;
+	int status = OK;
+	double rating, rd, volatility;
+	while (in.Next_Row())
+	{
+		if ((in.Num_Fields() != 4 && in.Num_Fields() != 5) || !in.Get_Double(1, rating) || !in.Get_Double(2, rd) || !in.Get_Double(3, volatility))
+		{
+			status = BAD_SYSTEM_ROW;
+			error_file = filename;
+			error_line = in.Get_Line();
+			break;
+		}
+		rows.push_back(Row{ Player{ std::string{ in.Field(0) }, rating, rd, volatility }, std::string{ in.Num_Fields() == 5 ? in.Field(4) : "" } });
+	}
+	if (status == OK && !in.Good())
+		status = CANNOT_OPEN;
+	in.Close();
+
+	// the results files, in parallel; rows cost what their files do, so
+	// small blocks let the pool even out the load
+	pool.Run(rows.size(), 16, [&](unsigned worker, size_t begin, size_t end)
+	{
+		for (size_t r = begin; r < end; r++)
+			Read_Results(*readers[worker], rows[r]);
+	});
+
+	// the first failure in file order, the rows before a bad one first
+	for (const Row& row : rows)
+		if (row.status != OK)
+		{
+			error_file = row.results;
+			error_line = row.error_line;
+			return row.status;
+		}
+	if (status != OK)
+		return status;
+
+	// every player in order, into a system with room for them all
+	size_t num_matches = 0;
+	for (const Row& row : rows)
+		num_matches += row.player.Get_Match_History().size();
+	system.Reserve(rows.size(), num_matches);
+	for (Row& row : rows)
+		system.Add_Player(std::move(row.player));
+	return OK;
+}
+
+void CsvLoader::Read_Results(CsvReader& reader, Row& row) const
+{
+	if (row.results.empty())
+		return;
+	if (!Open(reader, row.results))
+	{
+		row.status = CANNOT_OPEN_RESULTS;
+		return;
+	}
+
+	double rating, rd, volatility;
+	int score;
+	while (reader.Next_Row())
+	{
+		if (reader.Num_Fields() != 5 || !reader.Get_Double(1, rating) || !reader.Get_Double(2, rd) || !reader.Get_Double(3, volatility) || !reader.Get_Int(4, score))
+		{
+			row.status = BAD_RESULTS_ROW;
+			row.error_line = reader.Get_Line();
+			break;
+		}
+		row.player.Add_Match(Player{ std::string{ reader.Field(0) }, rating, rd, volatility }, score);
+	}
+	if (row.status == OK && !reader.Good())
+		row.status = CANNOT_OPEN_RESULTS;
+	reader.Close();
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "CsvReader.h"
+#include "Player.h"
+#include "WorkPool.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Glicko2;
+
+/*
+ * Loads a system CSV and the results file of each of its players into a
+ * Glicko-2 system, reading the results files in parallel.
+ *
+ * Load() runs three stages: the system CSV is read row by row into a
+ * Player per row, then a pool of readers (one CsvReader each, so one
+ * buffer per thread) parses the rows' results files into their match
+ * histories, and last the players are added to the system in file order,
+ * with room reserved for all of them and their matches up front. Players
+ * therefore get the same IDs and the system ends up exactly as if they had
+ * been added one by one, and a failure is the first one in file order,
+ * which is the one a serial load would have stopped at. Nothing is added
+ * to the system unless everything loads.
+ *
+ * Files that can't be opened as named are looked for in `directory` (the
+ * client's ./player-data/).
+ */
+class CsvLoader
+{
+public:
+	// return codes; the error file and line say where it went wrong
+	enum { OK = 0, CANNOT_OPEN = 1, CANNOT_OPEN_RESULTS = 2, BAD_SYSTEM_ROW = 3, BAD_RESULTS_ROW = 4 };
+
+	// a thread count of 0 means one thread per hardware thread
+	explicit CsvLoader(unsigned threads = 1, std::string directory = "");
+
+	CsvLoader(const CsvLoader&) = delete;
+	CsvLoader& operator=(const CsvLoader&) = delete;
+
+	int Load(const char* filename, Glicko2& system);
+
+	// the file as it was named (in the system CSV, for a results file)
+	const std::string& Get_Error_File() const
+	{ return error_file; }
+
+	size_t Get_Error_Line() const
+	{ return error_line; }
+
+private:
+	struct Row
+	{
+		Player player;
+		std::string results;
+		int status = OK;
+		size_t error_line = 0;
+	};
+
+	WorkPool pool;
+	std::string directory;
+	std::vector<std::unique_ptr<CsvReader>> readers;	// one per worker
+	std::string error_file;
+	size_t error_line = 0;
+
+	bool Open(CsvReader& reader, const std::string& filename) const;
+	void Read_Results(CsvReader& reader, Row& row) const;
+};
@@ -0,0 +1,128 @@
+#include "CsvReader.h"
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+CsvReader::CsvReader(size_t buffer_size) :
+	buffer(buffer_size < 64 ? 64 : buffer_size)
+{}
+
+CsvReader::~CsvReader()
+{
+	Close();
+}
+
+bool CsvReader::Open(const char* filename)
+{
+	Close();
+	fd = ::open(filename, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	begin = end = 0;
+	eof = failed = false;
+	line = 0;
+	return true;
+}
+
+void CsvReader::Close()
+{
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+}
+
+bool CsvReader::Fill()
+{
+	// keep the unfinished line, moving it to the front; grow the buffer only
+	// when a single line doesn't fit in it
+	if (begin > 0)
+	{
+		std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+		end -= begin;
+		begin = 0;
+	}
+	if (end == buffer.size())
+		buffer.resize(buffer.size() * 2);
+
+	ssize_t n;
+	do
+		n = ::read(fd, buffer.data() + end, buffer.size() - end);
+	while (n < 0 && errno == EINTR);
+
+	if (n < 0)
+		failed = true;
+	if (n <= 0)
+	{
+		eof = true;
+		return false;
+	}
+	end += n;
+	return true;
+}
+
+bool CsvReader::Next_Row()
+{
+	fields.clear();
+	if (fd < 0)
+		return false;
+
+	while (true)
+	{
+		char* data = buffer.data();
+		char* newline = static_cast<char*>(std::memchr(data + begin, '\n', end - begin));
+		if (!newline && !eof)
+		{
+			Fill();
+			continue;
+		}
+		if (!newline && begin == end)
+			return false;
+
+		// the last line of a file may lack its newline
+		size_t row_end = newline ? newline - data : end;
+		size_t row_begin = begin;
+		begin = newline ? row_end + 1 : end;
+		++line;
+
+		if (row_end > row_begin && data[row_end-1] == '\r')
+			--row_end;
+		if (row_end == row_begin)
+			continue;
+
+		size_t field_begin = row_begin;
+		for (size_t i = row_begin; i <= row_end; i++)
+		{
+			if (i == row_end || data[i] == ',')
+			{
+				fields.emplace_back(data + field_begin, i - field_begin);
+				field_begin = i + 1;
+			}
+		}
+		return true;
+	}
+}
+
+bool CsvReader::Get_Double(size_t i, double& value) const
+{
+	if (i >= fields.size())
+		return false;
+	const char* first = fields[i].data();
+	const char* last = first + fields[i].size();
+	auto result = std::from_chars(first, last, value);
+	return result.ec == std::errc() && result.ptr == last && first != last;
+}
+
+bool CsvReader::Get_Int(size_t i, int& value) const
+{
+	if (i >= fields.size())
+		return false;
+	const char* first = fields[i].data();
+	const char* last = first + fields[i].size();
+	auto result = std::from_chars(first, last, value);
+	return result.ec == std::errc() && result.ptr == last && first != last;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+/*
+ * Streaming reader for the comma-separated files of the client.
+ *
+ * The file is read in large chunks into one reusable buffer and each row is
+ * split into fields in place, so reading a file allocates nothing per row.
+ * Numbers are parsed with std::from_chars, which keeps the full precision
+ * of the doubles written by output_to_csv. Blank lines are skipped and a
+ * trailing '\r' is dropped, so files edited on Windows read the same.
+ *
+ * A row stays valid until the next call to Next_Row().
+ */
+class CsvReader
+{
+public:
+	explicit CsvReader(size_t buffer_size = 1 << 20);
+	~CsvReader();
+
+	CsvReader(const CsvReader&) = delete;
+	CsvReader& operator=(const CsvReader&) = delete;
+
+	bool Open(const char* filename);
+	void Close();
+
+	bool Next_Row();
+
+	// 1-based line number of the current row, for error messages
+	size_t Get_Line() const
+	{ return line; }
+
+	// false if the last Next_Row() stopped because of a read error
+	bool Good() const
+	{ return !failed; }
+
+	size_t Num_Fields() const
+	{ return fields.size(); }
+
+	std::string_view Field(size_t i) const
+	{ return fields[i]; }
+
+	bool Get_Double(size_t i, double& value) const;
+	bool Get_Int(size_t i, int& value) const;
+
+private:
+	int fd = -1;
+	std::vector<char> buffer;
+	size_t begin = 0;
+	size_t end = 0;
+	bool eof = false;
+	bool failed = false;
+	size_t line = 0;
+	std::vector<std::string_view> fields;
+
+	bool Fill();
+};
@@ -0,0 +1,104 @@
+#pragma once
+#include "Kernel.h"
+#include <cmath>
+#include <cstddef>
+
+/*
+ * Score policies: how the integer score recorded for a match maps onto the
+ * Glicko-2 score s_j in [0, 1]. A score is a number of points out of POINTS.
+ */
+
+// 1 for a win, 0 for a loss
+struct Win_Loss_Score
+{
+	static constexpr int POINTS = 1;
+};
+
+// in half points: 2 for a win, 1 for a draw, 0 for a loss
+struct Half_Point_Score
+{
+	static constexpr int POINTS = 2;
+};
+
+/*
+ * Math policies: whether the per-opponent g() and E() are evaluated exactly,
+ * or approximated with a table for g() and a faster exp() (see
+ * Kernel::Accumulate_Approximate()).
+ */
+struct Exact_Math
+{
+	static constexpr bool APPROXIMATE = false;
+};
+
+struct Approximate_Math
+{
+	static constexpr bool APPROXIMATE = true;
+};
+
+/*
+ * The per-opponent arithmetic of a rating period, specialised at compile
+ * time on the floating-point type it runs in, the score policy and the math
+ * policy.
+ *
+ * The constants are folded at compile time: the 173.7178 scale, the 1500
+ * base and pi^2 in g(). Ratings are converted to the Glicko-2 scale in
+ * double and only then narrowed to Real, so Engine<double, Win_Loss_Score>
+ * evaluates exactly the expressions the engine always has, and a float
+ * engine only loses precision in the opponent sums, where it gets SIMD
+ * lanes twice as wide (see Kernel.h). The sums are returned to double; the
+ * volatility solve and the new ratings are always computed in double.
+ */
+template <typename Real, typename Score = Win_Loss_Score, typename Math = Exact_Math>
+struct Engine
+{
+	typedef Real Real_Type;
+	typedef Score Score_Policy;
+	typedef Math Math_Policy;
+
+	static constexpr double SCALE = 173.7178;
+	static constexpr double BASE = 1500;
+	static constexpr Real PI2 = Real(M_PI * M_PI);
+
+	static constexpr Real Mu(double rating)
+	{ return Real((rating - BASE) / SCALE); }
+
+	static constexpr Real Phi(double rd)
+	{ return Real(rd / SCALE); }
+
+	static constexpr Real Score_Value(int score)
+	{ return Score::POINTS == 1 ? Real(score) : Real(score) / Real(Score::POINTS); }
+
+	static Real g(Real phi)
+	{ return 1/(std::sqrt(1+(3*(phi*phi))/PI2)); }
+
+	static Real E(Real mu, Real mu_j, Real phi_j)
+	{ return 1/(1+std::exp(-1*g(phi_j)*(mu-mu_j))); }
+
+	// g() interpolated in Kernel::G_Table(), and exact past its end
+	static double Approximate_g(double phi)
+	{
+		double x = phi * (Kernel::G_TABLE_SIZE / Kernel::G_TABLE_MAX);
+		if (!(x < Kernel::G_TABLE_SIZE))
+			return Engine<double>::g(phi);
+		size_t i = size_t(x);
+		const double* table = Kernel::G_Table();
+		return table[i] + (x - i) * (table[i+1] - table[i]);
+	}
+
+	// what Accumulate() takes for an opponent with the given RD: phi_j, or
+	// with the approximate math g(phi_j) itself
+	static Real Opponent_Phi(double rd)
+	{ return Math::APPROXIMATE ? Real(Approximate_g(rd / SCALE)) : Phi(rd); }
+
+	// nu and delta sums over one player's opponents, see Kernel::Accumulate()
+	static void Accumulate(Real mu, const Real* mu_opp, const Real* phi_opp, const Real* scores, const Real* games, size_t n, double& nu_sum, double& delta_sum)
+	{
+		Real sum1, sum2;
+		if (Math::APPROXIMATE)
+			Kernel::Accumulate_Approximate(mu, mu_opp, phi_opp, scores, games, n, sum1, sum2);
+		else
+			Kernel::Accumulate(mu, mu_opp, phi_opp, scores, games, n, sum1, sum2);
+		nu_sum = sum1;
+		delta_sum = sum2;
+	}
+};
@@ -0,0 +1,290 @@
+#include "Exporter.h"
+#include "Glicko2.h"
+#include "Snapshot.h"
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace
+{
+	const char MAGIC[8] = { 'G', 'L', 'I', 'C', 'K', 'O', '2', 'X' };
+
+	// players per chunk, at least; large exports use bigger chunks so a file
+	// still fits in one writev()
+	const size_t CHUNK_PLAYERS = 4096;
+
+	void Append_Double(std::string& out, double x)
+	{
+		char buffer[32];
+		out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), x).ptr);
+	}
+
+	void Append_Int(std::string& out, int x)
+	{
+		char buffer[16];
+		out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), x).ptr);
+	}
+
+	void Append_JSON_Double(std::string& out, double x)
+	{
+		if (std::isfinite(x))
+			Append_Double(out, x);
+		else
+			out += "null";
+	}
+
+	void Append_JSON_String(std::string& out, const std::string& s)
+	{
+		static const char HEX[] = "0123456789abcdef";
+		out += '"';
+		for (unsigned char c : s)
+		{
+			if (c == '"' || c == '\\')
+			{
+				out += '\\';
+				out += c;
+			}
+			else if (c < 0x20)
+			{
+				out += "\\u00";
+				out += HEX[c >> 4];
+				out += HEX[c & 15];
+			}
+			else
+				out += c;
+		}
+		out += '"';
+	}
+
+	// writes the whole file, opening it fresh
+	int Write_Buffers(const char* filename, std::vector<iovec>& iov)
+	{
+		int fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			return Exporter::CANNOT_OPEN;
+
+		size_t first = 0;
+		bool ok = true;
+		while (ok && first < iov.size())
+		{
+			ssize_t n = ::writev(fd, &iov[first], std::min<size_t>(iov.size() - first, IOV_MAX));
+			ok = n > 0;
+			// skip what went out, which may end partway into a buffer
+			for (size_t done = ok ? n : 0; done > 0; )
+			{
+				size_t step = std::min(done, iov[first].iov_len);
+				iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + step;
+				iov[first].iov_len -= step;
+				done -= step;
+				if (iov[first].iov_len == 0)
+					++first;
+			}
+			while (first < iov.size() && iov[first].iov_len == 0)
+				++first;
+		}
+		ok = (::close(fd) == 0) && ok;
+		return ok ? Exporter::OK : Exporter::WRITE_FAILED;
+	}
+}
+
+Exporter::Exporter(unsigned threads) :
+	pool{ threads }
+{
+}
+
+Exporter::Format Exporter::Format_Of(const char* filename)
+{
+	auto ends_with = [&](const char* suffix)
+	{
+		size_t length = std::strlen(filename), suffix_length = std::strlen(suffix);
+		return length >= suffix_length && std::strcmp(filename + length - suffix_length, suffix) == 0;
+	};
+	if (ends_with(".jsonl"))
+		return JSON_LINES;
+	if (ends_with(".bin"))
+		return BINARY;
+	return CSV;
+}
+
+int Exporter::Write(const char* filename, const Glicko2& system, Format format, const char* results_directory)
+{
+	error_file.clear();
+
+	// the lazily built views are built here, before the threads read them
+	system.Get_Name_Order();
+	system.Get_Matches();
+
+	int status = format == BINARY ? Write_Binary(filename, system) : Write_Text(filename, system, format, results_directory);
+	if (status != OK && error_file.empty())
+		error_file = filename;
+	return status;
+}
+
+int Exporter::Write_Text(const char* filename, const Glicko2& system, Format format, const char* results_directory)
+{
+	const std::vector<uint32_t>& order = system.Get_Name_Order();
+	size_t chunk_size = std::max(CHUNK_PLAYERS, (order.size() + IOV_MAX - 1) / IOV_MAX);
+	size_t num_chunks = (order.size() + chunk_size - 1) / chunk_size;
+	if (chunks.size() < num_chunks)
+		chunks.resize(num_chunks);
+	std::vector<std::string> results (pool.Get_Threads());
+
+	pool.Run(num_chunks, 1, [&](unsigned worker, size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; c++)
+		{
+			Chunk& chunk = chunks[c];
+			chunk.text.clear();
+			chunk.status = OK;
+			size_t last = std::min(order.size(), (c + 1) * chunk_size);
+			for (size_t i = c * chunk_size; i < last; i++)
+			{
+				Glicko2::Player_Ref player = system.Get_Player_Ref(order[i]);
+				bool has_results = results_directory && system.Num_Matches(player.id) != 0;
+				std::string& out = chunk.text;
+
+				if (format == JSON_LINES)
+				{
+					out += "{\"name\":";
+					Append_JSON_String(out, player.name);
+					out += ",\"rating\":";
+					Append_JSON_Double(out, player.rating);
+					out += ",\"rd\":";
+					Append_JSON_Double(out, player.rd);
+					out += ",\"vol\":";
+					Append_JSON_Double(out, player.vol);
+					if (results_directory)
+					{
+						const char* separator = "";
+						out += ",\"opponents\":[";
+						system.For_Each_Match(player.id, [&](const Glicko2::Player_Ref& opp, int)
+						{
+							out += separator;
+							Append_JSON_String(out, opp.name);
+							separator = ",";
+						});
+						separator = "";
+						out += "],\"scores\":[";
+						system.For_Each_Match(player.id, [&](const Glicko2::Player_Ref&, int score)
+						{
+							out += separator;
+							Append_Int(out, score);
+							separator = ",";
+						});
+						out += ']';
+					}
+					out += "}\n";
+					continue;
+				}
+
+				out += player.name;
+				out += ',';
+				Append_Double(out, player.rating);
+				out += ',';
+				Append_Double(out, player.rd);
+				out += ',';
+				Append_Double(out, player.vol);
+				out += ',';
+				if (has_results)
+				{
+					out += player.name;
+					out += "-results.csv";
+				}
+				out += '\n';
+
+				// the player's results file, written as soon as it is formatted
+				if (!has_results || chunk.status != OK)
+					continue;
+				std::string& text = results[worker];
+				text.clear();
+				system.For_Each_Match(player.id, [&](const Glicko2::Player_Ref& opp, int score)
+				{
+					text += opp.name;
+					text += ',';
+					Append_Double(text, opp.rating);
+					text += ',';
+					Append_Double(text, opp.rd);
+					text += ',';
+					Append_Double(text, opp.vol);
+					text += ',';
+					Append_Int(text, score);
+					text += '\n';
+				});
+				std::string results_filename = std::string{ results_directory } + player.name + "-results.csv";
+				std::vector<iovec> iov { iovec{ &text[0], text.size() } };
+				chunk.status = Write_Buffers(results_filename.c_str(), iov);
+				if (chunk.status != OK)
+					chunk.error_file = std::move(results_filename);
+			}
+		}
+	});
+
+	// the first failure in file order, as a serial export would have had it
+	for (size_t c = 0; c < num_chunks; c++)
+		if (chunks[c].status != OK)
+		{
+			error_file = chunks[c].error_file;
+			return chunks[c].status;
+		}
+
+	std::vector<iovec> iov;
+	for (size_t c = 0; c < num_chunks; c++)
+		iov.push_back(iovec{ &chunks[c].text[0], chunks[c].text.size() });
+	return Write_Buffers(filename, iov);
+}
+
+int Exporter::Write_Binary(const char* filename, const Glicko2& system)
+{
+	// the columns are gathered in parallel, and the names copied in parallel
+	// to offsets worked out beforehand
+	const std::vector<uint32_t>& order = system.Get_Name_Order();
+	const RatingStore& store = system.Get_Store();
+	size_t n = order.size();
+	std::vector<double> rating (n), rd (n), vol (n);
+	std::vector<uint64_t> name_offsets (n + 1, 0);
+	for (size_t i = 0; i < n; i++)
+		name_offsets[i+1] = name_offsets[i] + store.Get_Name(order[i]).size() + 1;
+	std::string strings (name_offsets[n], '\0');
+
+	pool.Run(n, CHUNK_PLAYERS, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			uint32_t id = order[i];
+			rating[i] = store.Get_Rating(id);
+			rd[i] = system.Get_Current_RD(id);
+			vol[i] = store.Get_Vol(id);
+			const std::string& name = store.Get_Name(id);
+			std::memcpy(&strings[name_offsets[i]], name.data(), name.size());
+		}
+	});
+
+	std::vector<iovec> iov;
+	Export_Header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.header_size = sizeof(header);
+	header.count = n;
+	header.strings_size = strings.size();
+	iov.push_back(iovec{ &header, sizeof(header) });
+	iov.push_back(iovec{ rating.data(), n * sizeof(double) });
+	iov.push_back(iovec{ rd.data(), n * sizeof(double) });
+	iov.push_back(iovec{ vol.data(), n * sizeof(double) });
+	iov.push_back(iovec{ name_offsets.data(), (n + 1) * sizeof(uint64_t) });
+	iov.push_back(iovec{ &strings[0], strings.size() });
+
+	// every column but the last is whole words, so checksumming them in turn
+	// comes to the same as over the bytes in one go
+	uint64_t checksum = Snapshot::Checksum(nullptr, 0);
+	for (size_t i = 1; i < iov.size(); i++)
+		checksum = Snapshot::Checksum(iov[i].iov_base, iov[i].iov_len, checksum);
+	header.checksum = checksum;
+	return Write_Buffers(filename, iov);
+}
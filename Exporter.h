@@ -0,0 +1,90 @@
+#pragma once
+#include "WorkPool.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Glicko2;
+
+/*
+ * Writes the rated players of a Glicko-2 system out in bulk, in name order,
+ * as CSV, JSON Lines or a columnar binary file.
+ *
+ * The players are cut into chunks that a pool of threads formats into
+ * buffers of their own, doubles with std::to_chars (the shortest text that
+ * reads back as the same double), and the buffers then go out with writev()
+ * in as few calls as the system allows, so a large export costs about what
+ * writing its bytes does. RDs are written as of the current period (see
+ * Glicko2::Get_Current_RD()).
+ *
+ * CSV rows are the client's system CSV, name,rating,rd,volatility,results;
+ * given a results directory, each player with matches gets a
+ * "<name>-results.csv" file there, one opponent,rating,rd,volatility,score
+ * row per game, and the last field names it (otherwise it is empty). The
+ * results files are formatted and written in parallel, each with a single
+ * write. JSON Lines has one object per player, with "opponents" and
+ * "scores" arrays given a results directory (which is otherwise unused).
+ * Non-finite numbers are written as null.
+ *
+ * The binary file is a fixed header (Export_Header) followed by the columns
+ *
+ *     rating[n], rd[n], vol[n]      doubles
+ *     name_offsets[n+1]             uint64 offsets into the strings
+ *     strings                       NUL-terminated names
+ *
+ * in the native byte order, with a checksum over them like a Snapshot's;
+ * matches aren't included, a Snapshot has those.
+ */
+struct Export_Header
+{
+	char magic[8];			// "GLICKO2X"
+	uint32_t version;
+	uint32_t header_size;
+	uint64_t count;
+	uint64_t strings_size;
+	uint64_t checksum;		// over all bytes after the header
+};
+
+class Exporter
+{
+public:
+	static const uint32_t VERSION = 1;
+
+	enum Format { CSV, JSON_LINES, BINARY };
+
+	// return codes, the same as Snapshot's
+	enum { OK = 0, CANNOT_OPEN = 1, WRITE_FAILED = 4 };
+
+	// a thread count of 0 means one thread per hardware thread
+	explicit Exporter(unsigned threads = 1);
+
+	Exporter(const Exporter&) = delete;
+	Exporter& operator=(const Exporter&) = delete;
+
+	int Write(const char* filename, const Glicko2& system, Format format, const char* results_directory = nullptr);
+
+	// by extension: ".jsonl" and ".bin", and CSV for anything else
+	static Format Format_Of(const char* filename);
+
+	// the file a failed Write() couldn't write, which may be a results file
+	const std::string& Get_Error_File() const
+	{ return error_file; }
+
+private:
+	// a run of players formatted by one thread, and how writing their
+	// results files went
+	struct Chunk
+	{
+		std::string text;
+		int status = OK;
+		std::string error_file;
+	};
+
+	WorkPool pool;
+	std::vector<Chunk> chunks;	// in file order, kept to reuse their buffers
+	std::string error_file;
+
+	int Write_Text(const char* filename, const Glicko2& system, Format format, const char* results_directory);
+	int Write_Binary(const char* filename, const Glicko2& system);
+};
@@ -1,137 +1,881 @@
 #include "Glicko2.h"
+#include "Arena.h"
+#include "Kernel.h"
+#include "MatchLog.h"
+#include "Shard.h"
+#include "Snapshot.h"
+#include "Stats.h"
+#include "Volatility.h"
+#include <algorithm>
+#include <functional>
+#include <type_traits>
 #include <vector>
 #include <utility>
 #include <cmath>
 
+namespace
+{
+	// the canonical ratings are always double
+	const double SCALE = Engine<double>::SCALE;
+}
+
 Glicko2::Glicko2(double tau) :
 	SYS_CONST{ tau }
-{}
+{
+	Select_Engine();
+}
 
 Glicko2::Glicko2(std::map<std::string, Player> players, double tau) :
-	SYS_CONST{ tau },
-	players{ players }
-{}
+	SYS_CONST{ tau }
+{
+	Select_Engine();
+	store.Reserve(players.size());
+	for (const auto& player : players)
+		Add_Player(player.second);
+}
 
 void Glicko2::Run()
 {
-	for (const auto& player : players)
-		Run(player.first);
+	Stats::Count(Stats::PERIODS);
+	if (log)
+		log->Append_Run();
+	Index_Matches();
+
+	// every player is rated against the pre-period snapshot held in the
+	// store; the new ratings go to a second set of columns swapped in at the
+	// end, and the old ones are kept to be reused by the next run
+	size_t num_players = store.Size();
+	spare_rating.assign(store.Ratings(), store.Ratings() + num_players);
+	spare_rd.assign(store.RDs(), store.RDs() + num_players);
+	spare_vol.assign(store.Vols(), store.Vols() + num_players);
+	iterations.assign(num_players, 0);
+
+	auto rate = [&](unsigned worker, size_t begin, size_t end)
+	{
+		(this->*rate_block)(begin, end, nullptr, arenas[worker], &spare_rating[begin], &spare_rd[begin], &spare_vol[begin], &iterations[begin]);
+	};
+
+	// players are independent given the snapshot, so the parallel path
+	// produces exactly the same ratings as the serial one
+	if (pool)
+		pool->Run(num_players, 256, rate);
+	else
+		rate(0, 0, num_players);
+
+	store.Swap_Columns(spare_rating, spare_rd, spare_vol);
+	Release_Scratch();
+
+	++period;
+	for (uint32_t id = 0; id < num_players; id++)
+		if (store.Is_Member(id))
+			rated_period[id] = period;
+	Clear_Active();
+	matches_rated = matches.Size() != 0;
+
+	ranking_stale = true;
+	Update_Ranking();
 }
 
 void Glicko2::Run(const std::string& name)
 {
-	double rating = players[name].Get_Rating();
-	double rd = players[name].Get_RD();
-	double volatility = players[name].Get_Vol();
-	
-	std::vector<std::pair<Player, int>> mh = players[name].Get_Match_History();
-	int num_matches = mh.size();
+	uint32_t id = store.Find(name);
+	if (id == RatingStore::npos || !store.Is_Member(id))
+		return;
+
+	if (log)
+		log->Append_Run(id);
+	Index_Matches();
+	if (iterations.size() < store.Size())
+		iterations.resize(store.Size(), 0);
+
+	double rating_p, rd_p, vol_p;
+	(this->*rate_block)(id, id+1, nullptr, arenas[0], &rating_p, &rd_p, &vol_p, &iterations[id]);
+	store.Set_Rating(id, rating_p);
+	store.Set_RD(id, rd_p);
+	store.Set_Vol(id, vol_p);
+	rated_period[id] = period;
+	Rank_Changed(id);
+}
 
-	std::vector<double> opp_rating;
-	std::vector<double> opp_rd;
-	std::vector<int> scores;
-	for (const auto& match : mh)
+void Glicko2::Run_Shard(uint32_t shard, uint32_t num_shards, Shard& result)
+{
+	// the players the shard owns, and each one's slot among them; their
+	// matches are grouped by slot as in Close_Period(), in the same order
+	// Run() reads them, so the sums come out bit for bit the same
+	size_t num_players = store.Size(), count = 0;
+	uint32_t* owned = period_arena.Allocate<uint32_t>(num_players);
+	uint32_t* slot = period_arena.Allocate<uint32_t>(num_players);
+	for (uint32_t id = 0; id < num_players; id++)
+	{
+		slot[id] = RatingStore::npos;
+		if (store.Is_Member(id) && Shard::Owner(id, num_shards) == shard)
+		{
+			slot[id] = count;
+			owned[count++] = id;
+		}
+	}
 	{
-		opp_rating.push_back(match.first.Get_Rating());
-		opp_rd.push_back(match.first.Get_RD());
-		scores.push_back(match.second);
+		Stats::Timer timer { Stats::INDEX_MATCHES };
+		matches.Build_Index(count, slot);
 	}
 
-	std::vector<double> primes = Single_Run(rating, rd, volatility, num_matches, opp_rating, opp_rd, scores);
+	double* rating_p = period_arena.Allocate<double>(count);
+	double* rd_p = period_arena.Allocate<double>(count);
+	double* vol_p = period_arena.Allocate<double>(count);
+	int* iters = period_arena.Allocate<int>(count);
+	auto rate = [&](unsigned worker, size_t begin, size_t end)
+	{
+		(this->*rate_block)(begin, end, owned, arenas[worker], &rating_p[begin], &rd_p[begin], &vol_p[begin], &iters[begin]);
+	};
+	if (pool)
+		pool->Run(count, 256, std::ref(rate));
+	else
+		rate(0, 0, count);
 
-	players[name].Set_Rating(primes[0]);
-	players[name].Set_RD(primes[1]);
-	players[name].Set_Vol(primes[2]);
+	result.Reset(shard, num_shards);
+	result.Reserve(count);
+	for (size_t k = 0; k < count; k++)
+		result.Add(owned[k], rating_p[k], rd_p[k], vol_p[k], iters[k]);
+	Release_Scratch();
 }
 
-void Glicko2::Add_Player(const Player& player)
+bool Glicko2::Merge_Shards(const std::vector<Shard>& shards)
 {
-	players.insert(std::pair<std::string, Player>{ player.Get_Name(), player });
+	// every shard once, from the same source, each with only its own rated
+	// players in ascending order; then covering every rated player means
+	// covering each exactly once
+	size_t num_shards = shards.size(), covered = 0;
+	std::vector<bool> seen (num_shards);
+	for (const Shard& result : shards)
+	{
+		if (result.Get_Num_Shards() != num_shards || seen[result.Get_Shard()] || result.Get_Source() != shards[0].Get_Source())
+			return false;
+		seen[result.Get_Shard()] = true;
+		for (size_t i = 0; i < result.Size(); i++)
+		{
+			uint32_t id = result.Get_ID(i);
+			if (id >= store.Size() || !store.Is_Member(id) || Shard::Owner(id, num_shards) != result.Get_Shard() || (i > 0 && id <= result.Get_ID(i-1)))
+				return false;
+		}
+		covered += result.Size();
+	}
+	if (covered != store.Num_Members())
+		return false;
+
+	// from here on it is Run()'s ending; replaying the log runs the period
+	// locally, which comes to the same ratings
+	Stats::Count(Stats::PERIODS);
+	if (log)
+		log->Append_Run();
+
+	iterations.assign(store.Size(), 0);
+	for (const Shard& result : shards)
+		for (size_t i = 0; i < result.Size(); i++)
+		{
+			uint32_t id = result.Get_ID(i);
+			store.Set_Rating(id, result.Get_Rating(i));
+			store.Set_RD(id, result.Get_RD(i));
+			store.Set_Vol(id, result.Get_Vol(i));
+			iterations[id] = result.Get_Iterations(i);
+		}
+
+	++period;
+	for (uint32_t id = 0; id < store.Size(); id++)
+		if (store.Is_Member(id))
+			rated_period[id] = period;
+	Clear_Active();
+	matches_rated = matches.Size() != 0;
+
+	ranking_stale = true;
+	Update_Ranking();
+	return true;
 }
 
-std::vector<double> Glicko2::Single_Run(double rating, double rd, double volatility, int num_matches, const std::vector<double>& opp_rating, const std::vector<double>& opp_rd, const std::vector<int>& scores)
+bool Glicko2::Close_Period()
 {
-	double rating_p;
-	double rd_p;
-	double volatility_p;
-	double mu_p, phi_p;
+	if (matches_rated)
+		return false;
+
+	Stats::Count(Stats::PERIODS);
+	if (log)
+		log->Append_Close_Period();
 
-	if (num_matches == 0)
+	size_t count = active.size();
+	if (count > 0)
 	{
-		phi_p = std::sqrt(std::pow(rd / 173.7178, 2) + std::pow(volatility,2));
-		std::vector<double> primes { rating, 173.7178*phi_p, volatility };
-		return primes;
+		// group this period's matches by active player, then rate just those
+		// players into temporaries so every read sees the pre-period values
+		{
+			Stats::Timer timer { Stats::INDEX_MATCHES };
+			matches.Build_Index(count, active_slot.data());
+		}
+
+		double* rating_p = period_arena.Allocate<double>(count);
+		double* rd_p = period_arena.Allocate<double>(count);
+		double* vol_p = period_arena.Allocate<double>(count);
+		int* iters = period_arena.Allocate<int>(count);
+		auto rate = [&](unsigned worker, size_t begin, size_t end)
+		{
+			(this->*rate_block)(begin, end, active.data(), arenas[worker], &rating_p[begin], &rd_p[begin], &vol_p[begin], &iters[begin]);
+		};
+		// by reference: the captures are too many for the std::function to
+		// hold without allocating
+		if (pool)
+			pool->Run(count, 256, std::ref(rate));
+		else
+			rate(0, 0, count);
+
+		if (iterations.size() < store.Size())
+			iterations.resize(store.Size(), 0);
+		for (size_t k = 0; k < count; k++)
+		{
+			uint32_t id = active[k];
+			store.Set_Rating(id, rating_p[k]);
+			store.Set_RD(id, rd_p[k]);
+			store.Set_Vol(id, vol_p[k]);
+			iterations[id] = iters[k];
+			rated_period[id] = period + 1;
+		}
 	}
 
-	double mu = (rating-1500) / 173.7178, phi = rd / 173.7178;
-	double nu, delta;
-	std::vector<double> mu_opp;
-	std::vector<double> phi_opp;
-	for (double opprtg : opp_rating)
-		mu_opp.push_back((opprtg - 1500) / 173.7178);
-	for (double opprd : opp_rd)
-		phi_opp.push_back(opprd / 173.7178);
+	++period;
+	matches.Clear();
+	Release_Scratch();
 
-	// set nu
-	double sum1 = 0;
-	for (int j = 0; j < num_matches; j++)
-		sum1 += (std::pow(g(phi_opp[j]),2) * E(mu, mu_opp[j], phi_opp[j]) * (1-E(mu, mu_opp[j], phi_opp[j])));
-	nu = 1 / sum1;
+	// the conservative key of every idle player drops a little each period
+	if (rank_key == RankIndex::CONSERVATIVE)
+		ranking_stale = true;
+	for (uint32_t id : active)
+		Rank_Changed(id);
+	Clear_Active();
+	Update_Ranking();
+	return true;
+}
 
-	// set delta
-	double sum2 = 0;
-	for (int j = 0; j < num_matches; j++)
-		sum2 += (g(phi_opp[j]) * (scores[j] - E(mu, mu_opp[j], phi_opp[j])));
-	delta = nu * sum2;
+void Glicko2::Clear_Matches()
+{
+	if (log)
+		log->Append_Clear_Matches();
+	matches.Clear();
+	Clear_Active();
+	matches_rated = false;
+}
 
-	// get new volatility
-	double a = std::log(std::pow(volatility, 2));
-	auto comp = [=](double x) -> double
+bool Glicko2::Add_Match(const std::string& player, const std::string& opponent, int score)
+{
+	return Add_Match(store.Find(player), store.Find(opponent), score);
+}
+
+bool Glicko2::Add_Match(uint32_t player, uint32_t opponent, int score)
+{
+	if (player >= store.Size() || opponent >= store.Size() || !store.Is_Member(player) || score < 0 || score > Get_Max_Score())
+		return false;
+
+	Record_Match(player, opponent, score);
+	return true;
+}
+
+double Glicko2::Get_Current_RD(uint32_t id) const
+{
+	// one step of the idle-player update per period the player sat out,
+	// exactly as an eager rating period would have applied it
+	double rd = store.Get_RD(id);
+	if (!store.Is_Member(id))
+		return rd;
+	for (uint32_t p = rated_period[id]; p < period; p++)
 	{
-		return ((std::exp(x)*(std::pow(delta,2)-std::pow(phi,2)-nu-std::exp(x))) / (2*std::pow(std::pow(phi,2)+nu+std::exp(x),2)))-((x-a) / std::pow(SYS_CONST,2));
-	};
-	double epsilon = 0.000001;
+		double phi_p = std::sqrt(std::pow(rd / SCALE, 2) + std::pow(store.Get_Vol(id),2));
+		rd = SCALE*phi_p;
+	}
+	return rd;
+}
+
+template <typename Engine_Type>
+void Glicko2::Rate(size_t begin, size_t end, const uint32_t* ids, Arena& arena, double* rating_p, double* rd_p, double* vol_p, int* iterations) const
+{
+	typedef typename Engine_Type::Real_Type Real;
+
+	// the block's scratch comes from the arena and is handed back at the end
+	Arena::Mark block_mark = arena.Get_Mark();
+	size_t size = end - begin;
+	uint32_t* block_ids = arena.Allocate<uint32_t>(size);
+	double* block_mu = arena.Allocate<double>(size);
+	double* block_phi = arena.Allocate<double>(size);
+	double* block_nu = arena.Allocate<double>(size);
+	double* block_delta = arena.Allocate<double>(size);
+	double* block_sum = arena.Allocate<double>(size);
+	double* block_sigma = arena.Allocate<double>(size);
+	double* block_sigma_p = arena.Allocate<double>(size);
+	int* block_iterations = arena.Allocate<int>(size);
 
-	double A = a;
-	double B;
-	if (std::pow(delta, 2) > std::pow(phi, 2) + nu)
-		B = std::log(std::pow(delta, 2)-std::pow(phi, 2)-nu);
+	// nu and delta of every player in the block that played this period;
+	// players without matches only have their RD inflated
+	Stats::Timer opponents_timer { Stats::RATE_OPPONENTS };
+	size_t count = 0, rated = 0, matches_read = 0;
+	for (size_t g = begin; g < end; g++)
+	{
+		uint32_t id = ids ? ids[g] : g;
+		if (!store.Is_Member(id))
+			continue;
+		++rated;
+
+		double rating = store.Get_Rating(id);
+		double rd = Get_Current_RD(id);
+		double volatility = store.Get_Vol(id);
+
+		uint32_t first = matches.Begin(g), last = matches.End(g);
+		size_t num_runs = last - first;
+		if (num_runs == 0)
+		{
+			double phi_p = std::sqrt(std::pow(rd / SCALE, 2) + std::pow(volatility,2));
+			rating_p[g-begin] = rating;
+			rd_p[g-begin] = SCALE*phi_p;
+			vol_p[g-begin] = volatility;
+			iterations[g-begin] = 0;
+			continue;
+		}
+
+		// gather the opponents from the snapshot, already on the Glicko-2
+		// scale, into scratch that only lives for this player; runs against
+		// the same opponent in a row, whatever their scores, become one
+		// opponent with their games and total score
+		Arena::Mark player_mark = arena.Get_Mark();
+		Real* mu_opp = arena.Allocate<Real>(num_runs);
+		Real* phi_opp = arena.Allocate<Real>(num_runs);
+		Real* scores = arena.Allocate<Real>(num_runs);
+		Real* games = arena.Allocate<Real>(num_runs);
+		size_t num_opponents = 0;
+		for (uint32_t i = first; i < last; i++)
+		{
+			uint32_t opp = matches.Get_Opponent(i), run = matches.Get_Games(i);
+			Real total = Engine_Type::Score_Value(matches.Get_Score(i)) * Real(run);
+			matches_read += run;
+			if (num_opponents > 0 && opp == matches.Get_Opponent(i-1))
+			{
+				scores[num_opponents-1] += total;
+				games[num_opponents-1] += Real(run);
+				continue;
+			}
+			mu_opp[num_opponents] = Engine_Type::Mu(store.Get_Rating(opp));
+			phi_opp[num_opponents] = Engine_Type::Opponent_Phi(Get_Current_RD(opp));
+			scores[num_opponents] = total;
+			games[num_opponents] = Real(run);
+			++num_opponents;
+		}
+
+		double mu = Engine<double>::Mu(rating), phi = Engine<double>::Phi(rd);
+
+		// one fused pass gives both the nu and the delta sums
+		double sum1, sum2;
+		Engine_Type::Accumulate(Real(mu), mu_opp, phi_opp, scores, games, num_opponents, sum1, sum2);
+		arena.Rewind(player_mark);
+		double nu = 1 / sum1;
+
+		block_ids[count] = g;
+		block_mu[count] = mu;
+		block_phi[count] = phi;
+		block_nu[count] = nu;
+		block_delta[count] = nu * sum2;
+		block_sum[count] = sum2;
+		block_sigma[count] = volatility;
+		++count;
+	}
+
+	opponents_timer.Stop();
+	Stats::Count(Stats::PLAYERS_RATED, rated);
+	Stats::Count(Stats::MATCHES_READ, matches_read);
+
+	// new volatilities for the whole block at once
+	Stats::Timer volatility_timer { Stats::RATE_VOLATILITY };
+	Volatility::Solve(block_phi, block_nu, block_delta, block_sigma, count, SYS_CONST, block_sigma_p, block_iterations);
+	volatility_timer.Stop();
+	Stats::Record_Iterations(block_iterations, count);
+
+	// calibrate the rating and the rating deviation
+	Stats::Timer update_timer { Stats::RATE_UPDATE };
+	for (size_t k = 0; k < count; k++)
+	{
+		size_t i = block_ids[k] - begin;
+		double phi = block_phi[k], volatility_p = block_sigma_p[k];
+
+		double phi_star = std::sqrt(std::pow(phi,2) + std::pow(volatility_p,2));
+		double phi_p = 1 / std::sqrt((1/std::pow(phi_star,2)) + (1/block_nu[k]));
+
+		// the rating update uses the same sum as delta
+		double mu_p = block_mu[k] + std::pow(phi_p,2)*block_sum[k];
+
+		rating_p[i] = SCALE * mu_p + Engine<double>::BASE;
+		rd_p[i] = SCALE * phi_p;
+		vol_p[i] = volatility_p;
+		iterations[i] = block_iterations[k];
+	}
+	arena.Rewind(block_mark);
+}
+
+void Glicko2::Set_Threads(unsigned threads)
+{
+	if (threads == 1)
+		pool.reset();
 	else
+		pool.reset(new WorkPool{ threads });
+	arenas.resize(Get_Threads());
+}
+
+void Glicko2::Set_Precision(Precision precision)
+{
+	this->precision = precision;
+	Select_Engine();
+}
+
+void Glicko2::Set_Scoring(Scoring scoring)
+{
+	this->scoring = scoring;
+	Select_Engine();
+}
+
+void Glicko2::Set_Accuracy(Accuracy accuracy)
+{
+	this->accuracy = accuracy;
+	Select_Engine();
+}
+
+void Glicko2::Select_Engine()
+{
+	rate_block = accuracy == APPROXIMATE ? Select_Rate<Approximate_Math>() : Select_Rate<Exact_Math>();
+}
+
+template <typename Math>
+Glicko2::Rate_Fn Glicko2::Select_Rate() const
+{
+	if (precision == FLOAT)
+		return scoring == HALF_POINTS ? &Glicko2::Rate<Engine<float, Half_Point_Score, Math>> : &Glicko2::Rate<Engine<float, Win_Loss_Score, Math>>;
+	return scoring == HALF_POINTS ? &Glicko2::Rate<Engine<double, Half_Point_Score, Math>> : &Glicko2::Rate<Engine<double, Win_Loss_Score, Math>>;
+}
+
+void Glicko2::Release_Scratch()
+{
+	// stealing may hand any worker the heaviest block next time, so each
+	// keeps room for the most any of them needed
+	size_t capacity = 0;
+	for (const Arena& arena : arenas)
+		capacity = std::max(capacity, arena.Capacity());
+	for (Arena& arena : arenas)
+		arena.Reset(capacity);
+	period_arena.Reset();
+}
+
+bool Glicko2::Add_Player(const Player& player)
+{
+	return Enter_Player(player);
+}
+
+bool Glicko2::Add_Player(Player&& player)
+{
+	return Enter_Player(std::move(player));
+}
+
+void Glicko2::Reserve(size_t players, size_t matches)
+{
+	store.Reserve(players);
+	this->matches.Reserve(matches);
+	rated_period.reserve(players);
+	active_slot.reserve(players);
+}
+
+// shared by both Add_Player()s: from an rvalue, the names of the player and
+// of their new opponents are moved into the store rather than copied
+template <typename P>
+bool Glicko2::Enter_Player(P&& player)
+{
+	// the log can't record longer names; turn the player down before
+	// anything changes
+	if (log)
 	{
-		int k = 1;
-		while (f(a-k*SYS_CONST, comp) < 0)
-			++k;
-		B = a - k*SYS_CONST;
+		if (player.Get_Name().size() > MatchLog::MAX_NAME)
+			return false;
+		for (auto& match : player.Get_Match_History())
+			if (match.first.Get_Name().size() > MatchLog::MAX_NAME)
+				return false;
 	}
 
-	double fa = f(A, comp); double fb = f(B, comp);
-	while (std::abs(B-A) > epsilon)
+	uint32_t id = store.Find(player.Get_Name());
+	if (id == RatingStore::npos)
+		id = Add_To_Store(std::forward<P>(player).Get_Name(), player.Get_Rating(), player.Get_RD(), player.Get_Vol(), true);
+	else if (store.Is_Member(id))
+		return true;
+	else
+		Promote(id, player.Get_Rating(), player.Get_RD(), player.Get_Vol());
+
+	// opponents are referenced by ID; ones not yet known are recorded with
+	// the stats given in this player's results
+	using Opponent = std::conditional_t<std::is_lvalue_reference<P>::value, const Player&, Player&&>;
+	auto&& history = std::forward<P>(player).Get_Match_History();
+	for (auto& match : history)
 	{
-		double C = A + (A-B)*fa/(fb-fa);
-		double fc = f(C, comp);
-		if (fc*fb < 0)
-		{ A = B; fa = fb; }
-		else
-			fa /= 2;
-		B = C; fb = fc;
-		if (std::abs(B-A) <= epsilon)
+		auto& opp = match.first;
+		uint32_t opp_id = store.Find(opp.Get_Name());
+		if (opp_id == RatingStore::npos)
+			opp_id = Add_To_Store(static_cast<Opponent>(opp).Get_Name(), opp.Get_Rating(), opp.Get_RD(), opp.Get_Vol(), false);
+		Record_Match(id, opp_id, match.second);
+	}
+	return true;
+}
+
+void Glicko2::Load(const Snapshot& snapshot)
+{
+	Stats::Timer timer { Stats::SNAPSHOT_LOAD };
+
+	// the columns are bulk-copied out of the mapping; only the names need
+	// to be materialised one by one
+	size_t num_players = snapshot.Size();
+	std::vector<const char*> names (num_players);
+	std::vector<uint8_t> members (num_players);
+	for (uint32_t id = 0; id < num_players; id++)
+	{
+		names[id] = snapshot.Get_Name(id);
+		members[id] = snapshot.Is_Member(id);
+	}
+
+	SYS_CONST = snapshot.Get_Tau();
+	scoring = static_cast<Scoring>(snapshot.Get_Scoring());
+	Select_Engine();
+	store.Assign(num_players, snapshot.Ratings(), snapshot.RDs(), snapshot.Vols(), members.data(), names.data());
+	matches.Assign(num_players, snapshot.Match_Offsets(), snapshot.Opponents(), snapshot.Scores());
+	matches_rated = snapshot.Matches_Rated();
+	iterations.clear();
+
+	period = snapshot.Get_Period();
+	rated_period.assign(snapshot.Rated_Periods(), snapshot.Rated_Periods() + num_players);
+	active.clear();
+	active_slot.assign(num_players, RatingStore::npos);
+	for (uint32_t id = 0; id < num_players; id++)
+		if (snapshot.Is_Active(id))
+			Mark_Active(id);
+	ranking_stale = true;
+	rank_pending.clear();
+	name_order_stale = true;
+}
+
+int Glicko2::Open_Log(const char* log_filename, const char* checkpoint_filename)
+{
+	Snapshot checkpoint;
+	int ret = checkpoint.Open(checkpoint_filename);
+	if (ret != Snapshot::OK && ret != Snapshot::CANNOT_OPEN)
+		return ret;
+	bool checkpointed = ret == Snapshot::OK;
+	if (checkpointed)
+		Load(checkpoint);
+
+	// replay before the log is attached, so the replay isn't logged again
+	std::unique_ptr<MatchLog> opened { new MatchLog };
+	ret = opened->Open(log_filename, checkpointed ? checkpoint.Get_Log_Sequence() : 0, [this](const MatchLog::Record& record)
+	{ Replay(record); });
+	if (ret != MatchLog::OK)
+		return ret;
+
+	log = std::move(opened);
+	this->checkpoint_filename = checkpoint_filename;
+
+	// without a checkpoint, the state from before the log isn't durable yet
+	return checkpointed ? Snapshot::OK : Checkpoint();
+}
+
+bool Glicko2::Commit_Log()
+{
+	return !log || log->Commit();
+}
+
+int Glicko2::Checkpoint()
+{
+	if (!log)
+		return Snapshot::CANNOT_OPEN;
+	if (!log->Commit())
+		return Snapshot::WRITE_FAILED;
+
+	int ret = Snapshot::Write(checkpoint_filename.c_str(), *this, log->Get_Sequence());
+	if (ret != Snapshot::OK)
+		return ret;
+	return log->Reset() ? Snapshot::OK : Snapshot::WRITE_FAILED;
+}
+
+void Glicko2::Replay(const MatchLog::Record& record)
+{
+	switch (record.type)
+	{
+		case MatchLog::PLAYER:
+			{
+				std::string name { record.name };
+				uint32_t id = store.Find(name);
+				if (id == RatingStore::npos)
+					Add_To_Store(name, record.rating, record.rd, record.vol, record.member);
+				else if (record.member && !store.Is_Member(id))
+					Promote(id, record.rating, record.rd, record.vol);
+			}
+			break;
+		case MatchLog::MATCH:
+			if (record.player < store.Size() && record.opponent < store.Size())
+				Record_Match(record.player, record.opponent, record.score);
+			break;
+		case MatchLog::RUN:
+			Run();
 			break;
+		case MatchLog::RUN_PLAYER:
+			if (record.player < store.Size())
+				Run(store.Get_Name(record.player));
+			break;
+		case MatchLog::CLOSE_PERIOD:
+			Close_Period();
+			break;
+		case MatchLog::CLEAR_MATCHES:
+			Clear_Matches();
+			break;
+	}
+}
+
+const RankIndex& Glicko2::Get_Ranking() const
+{
+	if (!ranking_enabled)
+	{
+		ranking_enabled = true;
+		ranking_stale = true;
 	}
+	Update_Ranking();
+	return ranking;
+}
 
-	volatility_p = std::exp(A/2);
+void Glicko2::Set_Rank_Key(RankIndex::Key key)
+{
+	rank_key = key;
+	ranking_stale = true;
+	Update_Ranking();
+}
 
-	// calibrate the rating and the rating deviation
-	double phi_star = std::sqrt(std::pow(phi,2) + std::pow(volatility_p,2));
-	phi_p = 1 / std::sqrt((1/std::pow(phi_star,2)) + (1/nu));
+void Glicko2::Predict(const uint32_t* players, const uint32_t* opponents, size_t n, double* expected, double* win_change, double* loss_change) const
+{
+	// gathered into the Glicko-2 scale a block at a time, on the stack so
+	// concurrent callers share nothing
+	const size_t BLOCK = 256;
+	double mu[BLOCK], phi[BLOCK], sigma[BLOCK], mu_opp[BLOCK], phi_opp[BLOCK], gain[BLOCK];
+	for (size_t begin = 0; begin < n; begin += BLOCK)
+	{
+		size_t count = std::min(BLOCK, n - begin);
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t id = players[begin + i], opp = opponents[begin + i];
+			mu[i] = Engine<double>::Mu(store.Get_Rating(id));
+			phi[i] = Engine<double>::Phi(Get_Current_RD(id));
+			sigma[i] = store.Get_Vol(id);
+			mu_opp[i] = Engine<double>::Mu(store.Get_Rating(opp));
+			phi_opp[i] = Engine<double>::Phi(Get_Current_RD(opp));
+		}
+		Kernel::Predict(mu, phi, sigma, mu_opp, phi_opp, count, expected + begin, gain);
+
+		if (win_change)
+			for (size_t i = 0; i < count; i++)
+				win_change[begin + i] = SCALE * gain[i] * (1 - expected[begin + i]);
+		if (loss_change)
+			for (size_t i = 0; i < count; i++)
+				loss_change[begin + i] = -SCALE * gain[i] * expected[begin + i];
+	}
+}
+
+size_t Glicko2::Best_Opponents(uint32_t id, size_t k, uint32_t* opponents, double* expected) const
+{
+	const RankIndex& index = Get_Ranking();
+	size_t rank = index.Rank_Of(id);
+	if (rank == RankIndex::npos)
+		return 0;
+
+	// the k nearest on the leaderboard, walking out from the player's rank
+	// to whichever side is closer in key
+	k = std::min(k, index.Size() - 1);
+	double key = index.Key_At(rank);
+	size_t above = rank, below = rank + 1;
+	std::vector<uint32_t> candidates;
+	candidates.reserve(k);
+	while (candidates.size() < k)
+	{
+		bool up = above > 0 && (below == index.Size() || index.Key_At(above - 1) - key <= key - index.Key_At(below));
+		candidates.push_back(up ? index.At(--above) : index.At(below++));
+	}
+
+	// then the most even games first, the nearest first among equals
+	std::vector<uint32_t> players (k, id);
+	std::vector<double> odds (k);
+	Predict(players.data(), candidates.data(), k, odds.data());
+	std::vector<uint32_t> order (k);
+	for (uint32_t i = 0; i < k; i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+	{
+		return std::fabs(odds[a] - 0.5) < std::fabs(odds[b] - 0.5);
+	});
+	for (size_t i = 0; i < k; i++)
+	{
+		opponents[i] = candidates[order[i]];
+		if (expected)
+			expected[i] = odds[order[i]];
+	}
+	return k;
+}
 
-	double sum3 = 0;
-	for (int j = 0; j < num_matches; j++)
-		sum3 += g(phi_opp[j]) * (scores[j] - E(mu, mu_opp[j], phi_opp[j]));
-	mu_p = mu + std::pow(phi_p,2)*sum3;
+std::map<std::string, Player> Glicko2::Get_Players() const
+{
+	Index_Matches();
+
+	// built in key order, so each insert goes straight to the end
+	std::map<std::string, Player> players;
+	for (uint32_t id : Get_Name_Order())
+		players.emplace_hint(players.end(), store.Get_Name(id), Make_Player(id));
+	return players;
+}
+
+Player Glicko2::Get_Player(const std::string& name) const
+{
+	uint32_t id = store.Find(name);
+	if (id == RatingStore::npos || !store.Is_Member(id))
+		return Player{};
+
+	Index_Matches();
+	return Make_Player(id);
+}
+
+void Glicko2::Index_Matches() const
+{
+	if (!matches.Is_Indexed())
+	{
+		Stats::Timer timer { Stats::INDEX_MATCHES };
+		matches.Build_Index(store.Size());
+	}
+}
+
+uint32_t Glicko2::Add_To_Store(std::string name, double rating, double rd, double volatility, bool member)
+{
+	uint32_t id = store.Add(std::move(name), rating, rd, volatility, member);
+	Stats::Count(Stats::PLAYERS_ADDED);
+	rated_period.push_back(period);
+	active_slot.push_back(RatingStore::npos);
+	if (member)
+	{
+		Rank_Changed(id);
+		name_order_stale = true;
+	}
+	if (log)
+		log->Append_Player(store.Get_Name(id), rating, rd, volatility, member);
+	return id;
+}
+
+void Glicko2::Promote(uint32_t id, double rating, double rd, double volatility)
+{
+	// promote an opponent seen in earlier results to a rated player
+	store.Set_Rating(id, rating);
+	store.Set_RD(id, rd);
+	store.Set_Vol(id, volatility);
+	store.Set_Member(id, true);
+	rated_period[id] = period;
+	Rank_Changed(id);
+	name_order_stale = true;
+	if (log)
+		log->Append_Player(store.Get_Name(id), rating, rd, volatility, true);
+}
+
+void Glicko2::Record_Match(uint32_t player, uint32_t opponent, int score)
+{
+	matches.Add(player, opponent, score);
+	Stats::Count(Stats::MATCHES_ADDED);
+	Mark_Active(player);
+	if (log)
+		log->Append_Match(player, opponent, score);
+}
+
+void Glicko2::Mark_Active(uint32_t id)
+{
+	if (active_slot[id] != RatingStore::npos)
+		return;
+	active_slot[id] = active.size();
+	active.push_back(id);
+}
+
+void Glicko2::Clear_Active()
+{
+	for (uint32_t id : active)
+		active_slot[id] = RatingStore::npos;
+	active.clear();
+}
+
+Player Glicko2::Make_Player(uint32_t id) const
+{
+	Player player { store.Get_Name(id), store.Get_Rating(id), Get_Current_RD(id), store.Get_Vol(id) };
+	std::vector<std::pair<Player, int>> history;
+	history.reserve(Num_Matches(id));
+	for (uint32_t i = matches.Begin(id); i < matches.End(id); i++)
+	{
+		uint32_t opp = matches.Get_Opponent(i);
+		Player opponent { store.Get_Name(opp), store.Get_Rating(opp), Get_Current_RD(opp), store.Get_Vol(opp) };
+		for (uint32_t k = 0; k < matches.Get_Games(i); k++)
+			history.emplace_back(opponent, matches.Get_Score(i));
+	}
+	player.Set_Match_History(std::move(history));
+	return player;
+}
 
-	rating_p = 173.7178 * mu_p + 1500;
-	rd_p = 173.7178 * phi_p;
+const std::vector<uint32_t>& Glicko2::Get_Name_Order() const
+{
+	if (name_order_stale)
+	{
+		name_order.clear();
+		name_order.reserve(store.Num_Members());
+		for (uint32_t id = 0; id < store.Size(); id++)
+			if (store.Is_Member(id))
+				name_order.push_back(id);
+		std::sort(name_order.begin(), name_order.end(), [this](uint32_t a, uint32_t b) { return store.Get_Name(a) < store.Get_Name(b); });
+		name_order_stale = false;
+	}
+	return name_order;
+}
+
+void Glicko2::Rank_Changed(uint32_t id)
+{
+	if (ranking_enabled && !ranking_stale)
+		rank_pending.push_back(id);
+}
 
-	std::vector<double> primes { rating_p, rd_p, volatility_p };
-	return primes;
+void Glicko2::Update_Ranking() const
+{
+	if (!ranking_enabled)
+		return;
+
+	Stats::Timer timer { Stats::RANKING };
+	std::vector<uint32_t> ids;
+	if (ranking_stale)
+	{
+		for (uint32_t id = 0; id < store.Size(); id++)
+			if (store.Is_Member(id))
+				ids.push_back(id);
+	}
+	else
+	{
+		// a player may have changed more than once since the last update
+		std::sort(rank_pending.begin(), rank_pending.end());
+		rank_pending.erase(std::unique(rank_pending.begin(), rank_pending.end()), rank_pending.end());
+		ids.swap(rank_pending);
+	}
+
+	std::vector<double> keys (ids.size());
+	for (size_t i = 0; i < ids.size(); i++)
+		keys[i] = Rank_Key_Of(ids[i]);
+
+	if (ranking_stale)
+		ranking.Build(ids.data(), keys.data(), ids.size());
+	else
+		ranking.Update(ids.data(), keys.data(), ids.size());
+	ranking_stale = false;
+	rank_pending.clear();
+}
+
+double Glicko2::Rank_Key_Of(uint32_t id) const
+{
+	if (rank_key == RankIndex::CONSERVATIVE)
+		return store.Get_Rating(id) - 2*Get_Current_RD(id);
+	return store.Get_Rating(id);
 }
@@ -1,11 +1,21 @@
 #pragma once
+#include "Arena.h"
+#include "Engine.h"
+#include "MatchLog.h"
+#include "MatchTable.h"
 #include "Player.h"
-#include <functional>
+#include "RankIndex.h"
+#include "RatingStore.h"
+#include "WorkPool.h"
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include <cmath>
 
+class Shard;
+class Snapshot;
+
 class Glicko2
 {
 public:
@@ -14,26 +24,301 @@ public:
 
 	void Run();
 	void Run(const std::string& name);
-	void Add_Player(const Player&);
 
-	std::map<std::string, Player> Get_Players() const
-	{ return players; }
+	// a player already rated is left as is; while a log is open, a player
+	// whose name or whose new opponent's name is longer than
+	// MatchLog::MAX_NAME is turned down, changing nothing, with false
+	bool Add_Player(const Player&);
+	bool Add_Player(Player&&);
+
+	// copies the snapshot in, period clock included (see Snapshot.h); it
+	// may be closed afterwards
+	void Load(const Snapshot&);
+
+	// room for this many players, rated or not, and matches
+	void Reserve(size_t players, size_t matches);
+
+	/*
+	 * Incremental use: record results as they come in with Add_Match(), then
+	 * Close_Period() rates only the players that played this period. The RD
+	 * inflation of everyone who sat the period out is deferred; it is
+	 * applied on the fly whenever their RD is read (Get_Current_RD(),
+	 * Get_Player(), or as an opponent) and written back the next time they
+	 * play, so closing a period costs time proportional to the active
+	 * players and their matches. Run() instead rates every player and keeps
+	 * the recorded matches; both advance the period clock. The matches a
+	 * Run() kept have been rated, so Close_Period() refuses, returning false
+	 * and changing nothing, until Clear_Matches() drops them along with any
+	 * recorded since; snapshots and the match log keep track of this.
+	 * Add_Match() returns false, recording nothing, unless the player is
+	 * rated, the opponent known and the score between 0 and Get_Max_Score().
+	 */
+	bool Add_Match(const std::string& player, const std::string& opponent, int score);
+	bool Add_Match(uint32_t player, uint32_t opponent, int score);
+	bool Close_Period();
+	void Clear_Matches();
+
+	// whether the recorded matches were rated by a Run()
+	bool Has_Rated_Matches() const
+	{ return matches_rated; }
+
+	uint32_t Get_Period() const
+	{ return period; }
+
+	size_t Num_Active() const
+	{ return active.size(); }
+
+	// the players Close_Period() will rate, in order of their first match
+	const std::vector<uint32_t>& Get_Active() const
+	{ return active; }
+
+	bool Is_Active(uint32_t id) const
+	{ return active_slot[id] != RatingStore::npos; }
+
+	double Get_Current_RD(uint32_t id) const;
+
+	// the period the stored RD of player `id` is current as of
+	uint32_t Get_Rated_Period(uint32_t id) const
+	{ return rated_period[id]; }
+
+	/*
+	 * Durability: Open_Log() restores the system from its last checkpoint,
+	 * replays the match log written since, and from then on logs every
+	 * change to the system. Without a checkpoint the log is replayed on top
+	 * of the current state, which is then checkpointed. Commit_Log() makes
+	 * everything logged so far durable; Checkpoint() writes a new checkpoint
+	 * and empties the log. Load() isn't logged, so checkpoint after it.
+	 * Neither the precision nor the accuracy is logged or checkpointed, so
+	 * replay only reproduces the ratings when both are set as they were
+	 * before Open_Log(). These return Snapshot's codes.
+	 */
+	int Open_Log(const char* log_filename, const char* checkpoint_filename);
+	bool Commit_Log();
+	int Checkpoint();
+
+	bool Has_Log() const
+	{ return log != nullptr; }
+
+	/*
+	 * Sharded use: Run_Shard() rates the players that shard `shard` of
+	 * `num_shards` owns (Shard::Owner()) exactly as Run() would, leaving the
+	 * system as it was, so each shard can be rated by its own process from a
+	 * snapshot of the system. Merge_Shards() then takes the results of every
+	 * shard, computed from this system's current state, and finishes the
+	 * period as Run() does; it returns false, changing nothing, unless they
+	 * cover each rated player exactly once.
+	 */
+	void Run_Shard(uint32_t shard, uint32_t num_shards, Shard& result);
+	bool Merge_Shards(const std::vector<Shard>& shards);
+
+	void Set_Threads(unsigned threads);
+	unsigned Get_Threads() const
+	{ return pool ? pool->Get_Threads() : 1; }
+
+	double Get_Tau() const
+	{ return SYS_CONST; }
+
+	/*
+	 * Engine selection (see Engine.h). The precision is that of the opponent
+	 * sums in every rating period; the stored ratings stay double either
+	 * way. The scoring says what recorded scores mean and is saved with
+	 * snapshots: WIN_LOSS takes 1 or 0, HALF_POINTS takes 2 for a win, 1 for
+	 * a draw and 0 for a loss. APPROXIMATE accuracy rates with a table for
+	 * g() and a faster exp() (see Kernel::Accumulate_Approximate()), for bulk
+	 * analytics that can take ratings off by up to
+	 * Kernel::APPROXIMATE_TOLERANCE; it isn't saved with snapshots, and
+	 * Predict() is always exact.
+	 */
+	enum Precision { DOUBLE, FLOAT };
+	enum Scoring { WIN_LOSS, HALF_POINTS };
+	enum Accuracy { EXACT, APPROXIMATE };
+
+	void Set_Precision(Precision precision);
+	Precision Get_Precision() const
+	{ return precision; }
+
+	void Set_Scoring(Scoring scoring);
+	Scoring Get_Scoring() const
+	{ return scoring; }
+
+	void Set_Accuracy(Accuracy accuracy);
+	Accuracy Get_Accuracy() const
+	{ return accuracy; }
 
-	Player Get_Player(const std::string& name)
-	{ return players[name]; }
+	// the score of a win
+	int Get_Max_Score() const
+	{ return scoring == HALF_POINTS ? Half_Point_Score::POINTS : Win_Loss_Score::POINTS; }
+
+	/*
+	 * Leaderboard of the rated players, best first (see RankIndex.h). It is
+	 * built the first time it is asked for and from then on kept up to date
+	 * in bulk at the end of every Run() and Close_Period(); players added or
+	 * rated on their own in between are merged in when it is next read.
+	 * Keeping it up to date costs O(k (RankIndex::BLOCK_SIZE + log n)) for
+	 * the k players a period rated, or O(n + k log k) when they are many.
+	 * The CONSERVATIVE key is the exception: the RD of every idle player
+	 * grows each period, so every key moves, and Close_Period() leaves the
+	 * whole board to be rebuilt in O(n log n) on the next read.
+	 */
+	const RankIndex& Get_Ranking() const;
+	void Set_Rank_Key(RankIndex::Key key);
+	RankIndex::Key Get_Rank_Key() const
+	{ return rank_key; }
+
+	/*
+	 * Match prediction, without changing anything. Predict() takes n pairs
+	 * of player IDs and returns the expected score of each player against
+	 * their opponent as of the current period (0 to 1, whatever the
+	 * scoring), and optionally the rating change a win or a loss would bring
+	 * the player were it their only game of the period (with their
+	 * volatility held, which moves the result by well under a point). It is
+	 * safe to call from several threads at once on disjoint output.
+	 * Best_Opponents() finds the k players nearest player `id` on the
+	 * leaderboard, ordered by how even a game against them would be, the
+	 * most even first; it returns how many it found.
+	 */
+	void Predict(const uint32_t* players, const uint32_t* opponents, size_t n, double* expected, double* win_change = nullptr, double* loss_change = nullptr) const;
+	size_t Best_Opponents(uint32_t id, size_t k, uint32_t* opponents, double* expected = nullptr) const;
+
+	std::map<std::string, Player> Get_Players() const;
+	Player Get_Player(const std::string& name) const;
+
+	/*
+	 * Copy-free reads. A Player_Ref shows one player as Get_Player() would,
+	 * without building a Player, and is valid until the system next
+	 * changes. For_Each_Player() visits the rated players in name order,
+	 * the order of Get_Players(); For_Each_Match() visits the opponents and
+	 * scores recorded for one player.
+	 */
+	struct Player_Ref
+	{
+		uint32_t id;
+		const std::string& name;
+		double rating;
+		double rd;
+		double vol;
+	};
+
+	size_t Num_Players() const
+	{ return store.Num_Members(); }
+
+	Player_Ref Get_Player_Ref(uint32_t id) const
+	{ return Player_Ref{ id, store.Get_Name(id), store.Get_Rating(id), Get_Current_RD(id), store.Get_Vol(id) }; }
+
+	size_t Num_Matches(uint32_t id) const
+	{
+		Index_Matches();
+		size_t count = 0;
+		for (uint32_t i = matches.Begin(id); i < matches.End(id); i++)
+			count += matches.Get_Games(i);
+		return count;
+	}
+
+	// the IDs of the rated players in name order, for visiting them out of
+	// order or in parallel; valid until a player is added
+	const std::vector<uint32_t>& Get_Name_Order() const;
+
+	template <typename Visitor>
+	void For_Each_Player(Visitor&& visit) const
+	{
+		for (uint32_t id : Get_Name_Order())
+			visit(Get_Player_Ref(id));
+	}
+
+	template <typename Visitor>
+	void For_Each_Match(uint32_t id, Visitor&& visit) const
+	{
+		Index_Matches();
+		for (uint32_t i = matches.Begin(id); i < matches.End(id); i++)
+			for (uint32_t k = 0; k < matches.Get_Games(i); k++)
+				visit(Get_Player_Ref(matches.Get_Opponent(i)), matches.Get_Score(i));
+	}
+
+	// RDs in the store are current as of the last period each player was
+	// rated in; use Get_Current_RD() for the RD as of the current period
+	const RatingStore& Get_Store() const
+	{ return store; }
+
+	const MatchTable& Get_Matches() const
+	{ Index_Matches(); return matches; }
+
+	// volatility solver iterations per player ID from the last Run()
+	const std::vector<int>& Get_Solver_Iterations() const
+	{ return iterations; }
 
 private:
 	double SYS_CONST;
-	std::map<std::string, Player> players;
-	
-	double f (double x, std::function<double(double)> compute)
-	{ return compute(x); }
+	RatingStore store;
+	mutable MatchTable matches;
+	std::unique_ptr<WorkPool> pool;
+	std::unique_ptr<MatchLog> log;
+	std::string checkpoint_filename;
+
+	// iterations the volatility solver needed per player in the last run
+	std::vector<int> iterations;
+
+	// period clock; rated_period[id] is the period the stored RD of player
+	// `id` is current as of
+	uint32_t period = 0;
+	std::vector<uint32_t> rated_period;
+
+	// players with matches in the current period, and each player's
+	// position in that list (npos while idle)
+	std::vector<uint32_t> active;
+	std::vector<uint32_t> active_slot;
+
+	// set by Run() when it keeps matches, which Close_Period() would rate
+	// a second time
+	bool matches_rated = false;
+
+	// the leaderboard; off until first asked for, then either rebuilt in
+	// full (stale) or updated for the pending players
+	mutable RankIndex ranking;
+	RankIndex::Key rank_key = RankIndex::RATING;
+	mutable bool ranking_enabled = false;
+	mutable bool ranking_stale = false;
+	mutable std::vector<uint32_t> rank_pending;
+
+	// rated players sorted by name, rebuilt when one is added
+	mutable std::vector<uint32_t> name_order;
+	mutable bool name_order_stale = true;
+
+	// scratch memory, handed back in one go at the end of every period: one
+	// arena per worker for the blocks of players being rated, and one for
+	// the period's own temporaries; once they have grown to a period's
+	// needs, rating allocates nothing (see Arena.h)
+	std::vector<Arena> arenas = std::vector<Arena>(1);
+	Arena period_arena;
 
-	std::vector<double> Single_Run(double rating, double rd, double volatility, int num_matches, const std::vector<double>& opp_rating, const std::vector<double>& opp_rd, const std::vector<int>& scores);
+	// the columns the next Run() writes into, the ones the last run replaced
+	std::vector<double> spare_rating;
+	std::vector<double> spare_rd;
+	std::vector<double> spare_vol;
 
-	double g (double p)
-	{ return 1/(std::sqrt(1+(3*(std::pow(p,2))/(std::pow(M_PI,2))))); }
+	// Rate() instantiated for the precision, scoring and accuracy in use
+	Precision precision = DOUBLE;
+	Scoring scoring = WIN_LOSS;
+	Accuracy accuracy = EXACT;
+	typedef void (Glicko2::*Rate_Fn)(size_t, size_t, const uint32_t*, Arena&, double*, double*, double*, int*) const;
+	Rate_Fn rate_block = nullptr;
 
-	double E (double m, double mj, double pj)
-	{ return 1/(1+std::exp(-1*g(pj)*(m-mj))); }
+	template <typename Engine_Type>
+	void Rate(size_t begin, size_t end, const uint32_t* ids, Arena& arena, double* rating_p, double* rd_p, double* vol_p, int* iterations) const;
+	void Select_Engine();
+	template <typename Math>
+	Rate_Fn Select_Rate() const;
+	void Index_Matches() const;
+	void Release_Scratch();
+	template <typename P>
+	bool Enter_Player(P&& player);
+	uint32_t Add_To_Store(std::string name, double rating, double rd, double volatility, bool member);
+	void Promote(uint32_t id, double rating, double rd, double volatility);
+	void Record_Match(uint32_t player, uint32_t opponent, int score);
+	void Replay(const MatchLog::Record& record);
+	void Mark_Active(uint32_t id);
+	void Clear_Active();
+	void Rank_Changed(uint32_t id);
+	void Update_Ranking() const;
+	double Rank_Key_Of(uint32_t id) const;
+	Player Make_Player(uint32_t id) const;
 };
@@ -0,0 +1,104 @@
+#include "IngestQueue.h"
+#include "Glicko2.h"
+#include <algorithm>
+
+IngestQueue::IngestQueue(size_t capacity)
+{
+	size_t size = 1;
+	while (size < capacity)
+		size *= 2;
+	slots.reset(new Slot[size]);
+	mask = size - 1;
+	for (size_t i = 0; i < size; i++)
+		slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool IngestQueue::Push(uint32_t player, uint32_t opponent, int score)
+{
+	// no system has this ID, so it's dropped here rather than taken for a
+	// seal
+	if (player == SEAL)
+	{
+		invalid.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	return Enqueue(player, opponent, score);
+}
+
+bool IngestQueue::Seal()
+{
+	return Enqueue(SEAL, 0, 0);
+}
+
+bool IngestQueue::Enqueue(uint32_t player, uint32_t opponent, int score)
+{
+	// a slot is free for the push at position `pos` when its sequence
+	// number is `pos`; one still holding the record from a lap before means
+	// the queue is full
+	uint64_t pos = tail.load(std::memory_order_relaxed);
+	Slot* slot;
+	for (;;)
+	{
+		slot = &slots[pos & mask];
+		int64_t diff = int64_t(slot->sequence.load(std::memory_order_acquire) - pos);
+		if (diff == 0)
+		{
+			if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{
+			rejected.fetch_add(1, std::memory_order_relaxed);
+			high_water.store(Get_Capacity(), std::memory_order_relaxed);
+			return false;
+		}
+		else
+			pos = tail.load(std::memory_order_relaxed);
+	}
+
+	slot->player = player;
+	slot->opponent = opponent;
+	slot->score = score;
+	slot->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+size_t IngestQueue::Drain(Glicko2& system, size_t max)
+{
+	uint64_t pos = head.load(std::memory_order_relaxed);
+	size_t depth = Get_Depth();
+	if (depth > high_water.load(std::memory_order_relaxed))
+		high_water.store(depth, std::memory_order_relaxed);
+
+	size_t taken = 0;
+	for (; taken < max; taken++)
+	{
+		// filled when its sequence number has moved one past the position;
+		// the slot is handed back for the next lap as soon as it's read
+		Slot& slot = slots[pos & mask];
+		if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+			break;
+		uint32_t player = slot.player, opponent = slot.opponent;
+		int score = slot.score;
+		slot.sequence.store(pos + mask + 1, std::memory_order_release);
+		head.store(++pos, std::memory_order_release);
+
+		if (player == SEAL)
+		{
+			if (system.Close_Period())
+				closed.fetch_add(1, std::memory_order_relaxed);
+		}
+		else if (!system.Add_Match(player, opponent, score))
+			invalid.fetch_add(1, std::memory_order_relaxed);
+	}
+	return taken;
+}
+
+size_t IngestQueue::Get_Depth() const
+{
+	// every push the head has passed happened before this read of the
+	// tail, so the tail can't be seen behind the head
+	uint64_t first = head.load(std::memory_order_acquire);
+	uint64_t last = tail.load(std::memory_order_relaxed);
+	return std::min<uint64_t>(last - first, Get_Capacity());
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class Glicko2;
+
+/*
+ * Bounded, lock-free queue feeding match results from any number of
+ * producer threads into a Glicko2 system owned by a single consumer.
+ *
+ * Producers Push() (player ID, opponent ID, score) records, and Seal() to
+ * end the rating period: the consumer's Drain() records every match queued
+ * before the seal with Glicko2::Add_Match(), in queue order, then closes
+ * the period with Glicko2::Close_Period() and goes on with the next one.
+ * The rating is done on the consumer's thread, so producers never wait on
+ * it; while a close runs they fill the queue instead, and the capacity is
+ * how much of a backlog that may build up. A push to a full queue fails at
+ * once and is counted as rejected, which is the backpressure: the producer
+ * may retry, shed the match or slow down. Records Glicko2::Add_Match()
+ * turns down, for IDs the system doesn't have or a score out of range, are
+ * dropped by the consumer and counted as invalid. If the system keeps a
+ * match log, committing it is up to the consumer too.
+ *
+ * The ring is Vyukov's bounded queue: every slot carries a sequence number
+ * that tells a producer whether it is free and the consumer whether it is
+ * filled, so a push is one compare-and-swap on the shared tail and a pop
+ * involves no atomic read-modify-write at all. The consumer side isn't
+ * thread-safe; only one thread may drain. The depth and counters may be
+ * read from any thread, and are exact once the producers have stopped.
+ */
+class IngestQueue
+{
+public:
+	// a capacity that isn't a power of two is rounded up to one
+	explicit IngestQueue(size_t capacity);
+
+	IngestQueue(const IngestQueue&) = delete;
+	IngestQueue& operator=(const IngestQueue&) = delete;
+
+	// false, without waiting, if the queue is full
+	bool Push(uint32_t player, uint32_t opponent, int score);
+	bool Seal();
+
+	// records up to `max` queued records into `system`, closing a period
+	// at each seal; returns how many it took, seals included
+	size_t Drain(Glicko2& system, size_t max = SIZE_MAX);
+
+	size_t Get_Capacity() const
+	{ return mask + 1; }
+
+	// records queued but not yet drained
+	size_t Get_Depth() const;
+
+	// the most records that have been queued at once, as seen by the
+	// consumer (or the capacity, once a push has been rejected)
+	size_t Get_High_Water() const
+	{ return high_water.load(std::memory_order_relaxed); }
+
+	// seals included
+	uint64_t Get_Pushed() const
+	{ return tail.load(std::memory_order_relaxed); }
+
+	uint64_t Get_Rejected() const
+	{ return rejected.load(std::memory_order_relaxed); }
+
+	uint64_t Get_Invalid() const
+	{ return invalid.load(std::memory_order_relaxed); }
+
+	// periods the consumer has closed; a seal the system refuses to close
+	// on (see Glicko2::Close_Period()) isn't counted
+	uint64_t Get_Closed() const
+	{ return closed.load(std::memory_order_relaxed); }
+
+private:
+	// a player ID no system has, marking a seal
+	static const uint32_t SEAL = UINT32_MAX;
+
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence;
+		uint32_t player;
+		uint32_t opponent;
+		int32_t score;
+	};
+
+	std::unique_ptr<Slot[]> slots;
+	size_t mask;
+
+	// producer and consumer positions on cache lines of their own, so
+	// pushing doesn't contend with draining
+	alignas(64) std::atomic<uint64_t> tail { 0 };
+	std::atomic<uint64_t> rejected { 0 };
+	alignas(64) std::atomic<uint64_t> head { 0 };
+	std::atomic<size_t> high_water { 0 };
+	std::atomic<uint64_t> invalid { 0 };
+	std::atomic<uint64_t> closed { 0 };
+
+	bool Enqueue(uint32_t player, uint32_t opponent, int score);
+};
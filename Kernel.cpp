@@ -0,0 +1,284 @@
+#include "Kernel.h"
+#include "Engine.h"
+#include <cmath>
+#include "SimdMath.h"
+
+namespace
+{
+	const double PI2 = Engine<double>::PI2;
+	const float PI2_FLOAT = Engine<float>::PI2;
+
+	// every kernel comes in an exact and an approximate version; the
+	// approximate one takes g(phi_j) in place of phi_j and uses
+	// Exp_Approximate() for the double exp()
+	template <typename Real, bool APPROXIMATE = false>
+	void Accumulate_Scalar(Real mu, const Real* mu_opp, const Real* phi_opp, const Real* scores, const Real* games, size_t n, Real& nu_sum, Real& delta_sum)
+	{
+		// the sums are kept in double whatever the element type, so a long
+		// run of opponents doesn't lose the float path its precision
+		double sum1 = 0, sum2 = 0;
+		for (size_t j = 0; j < n; j++)
+		{
+			Real g = APPROXIMATE ? phi_opp[j] : Engine<Real>::g(phi_opp[j]);
+			Real E = APPROXIMATE ? Real(1/(1+Exp_Approximate(-1*g*(mu-mu_opp[j])))) : 1/(1+std::exp(-1*g*(mu-mu_opp[j])));
+			sum1 += games[j] * (g*g * E * (1-E));
+			sum2 += g * (scores[j] - games[j]*E);
+		}
+		nu_sum = sum1;
+		delta_sum = sum2;
+	}
+
+	template <bool APPROXIMATE>
+	__attribute__((target("avx2,fma")))
+	void Accumulate_AVX2(double mu, const double* mu_opp, const double* phi_opp, const double* scores, const double* games, size_t n, double& nu_sum, double& delta_sum)
+	{
+		const __m256d one = _mm256_set1_pd(1.0);
+		const __m256d three_over_pi2 = _mm256_set1_pd(3/PI2);
+		const __m256d vmu = _mm256_set1_pd(mu);
+
+		__m256d sum1 = _mm256_setzero_pd(), sum2 = _mm256_setzero_pd();
+		size_t j = 0;
+		for (; j + 4 <= n; j += 4)
+		{
+			__m256d phi = _mm256_loadu_pd(phi_opp + j);
+			__m256d g = APPROXIMATE ? phi : _mm256_div_pd(one, _mm256_sqrt_pd(_mm256_fmadd_pd(_mm256_mul_pd(phi, phi), three_over_pi2, one)));
+			__m256d diff = _mm256_mul_pd(g, _mm256_sub_pd(_mm256_loadu_pd(mu_opp + j), vmu));
+			__m256d E = _mm256_div_pd(one, _mm256_add_pd(one, APPROXIMATE ? Exp_Approximate_AVX2(diff) : Exp_AVX2(diff)));
+			__m256d w = _mm256_loadu_pd(games + j);
+			sum1 = _mm256_fmadd_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(g, g), E), w), _mm256_sub_pd(one, E), sum1);
+			sum2 = _mm256_fmadd_pd(g, _mm256_fnmadd_pd(w, E, _mm256_loadu_pd(scores + j)), sum2);
+		}
+
+		double lanes1[4], lanes2[4];
+		_mm256_storeu_pd(lanes1, sum1);
+		_mm256_storeu_pd(lanes2, sum2);
+		double tail1, tail2;
+		// GCC leaves out the vzeroupper before the call when the tail has no
+		// calls of its own, and the SSE code would then run with the upper
+		// halves dirty, several times slower
+		_mm256_zeroupper();
+		Accumulate_Scalar<decltype(mu), APPROXIMATE>(mu, mu_opp + j, phi_opp + j, scores + j, games + j, n - j, tail1, tail2);
+
+		nu_sum = ((lanes1[0] + lanes1[1]) + (lanes1[2] + lanes1[3])) + tail1;
+		delta_sum = ((lanes2[0] + lanes2[1]) + (lanes2[2] + lanes2[3])) + tail2;
+	}
+
+	template <bool APPROXIMATE>
+	__attribute__((target("avx512f")))
+	void Accumulate_AVX512(double mu, const double* mu_opp, const double* phi_opp, const double* scores, const double* games, size_t n, double& nu_sum, double& delta_sum)
+	{
+		const __m512d one = _mm512_set1_pd(1.0);
+		const __m512d three_over_pi2 = _mm512_set1_pd(3/PI2);
+		const __m512d vmu = _mm512_set1_pd(mu);
+
+		__m512d sum1 = _mm512_setzero_pd(), sum2 = _mm512_setzero_pd();
+		for (size_t j = 0; j < n; j += 8)
+		{
+			// the last block is loaded under a mask, inactive lanes add 0
+			__mmask8 mask = n - j >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n - j)) - 1);
+			__m512d phi = _mm512_maskz_loadu_pd(mask, phi_opp + j);
+			__m512d g = APPROXIMATE ? phi : _mm512_div_pd(one, _mm512_sqrt_pd(_mm512_fmadd_pd(_mm512_mul_pd(phi, phi), three_over_pi2, one)));
+			__m512d diff = _mm512_mul_pd(g, _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, mu_opp + j), vmu));
+			__m512d E = _mm512_div_pd(one, _mm512_add_pd(one, APPROXIMATE ? Exp_Approximate_AVX512(diff) : Exp_AVX512(diff)));
+			__m512d w = _mm512_maskz_loadu_pd(mask, games + j);
+			sum1 = _mm512_mask3_fmadd_pd(_mm512_mul_pd(_mm512_mul_pd(_mm512_mul_pd(g, g), E), w), _mm512_sub_pd(one, E), sum1, mask);
+			sum2 = _mm512_mask3_fmadd_pd(g, _mm512_fnmadd_pd(w, E, _mm512_maskz_loadu_pd(mask, scores + j)), sum2, mask);
+		}
+
+		nu_sum = _mm512_reduce_add_pd(sum1);
+		delta_sum = _mm512_reduce_add_pd(sum2);
+	}
+
+	template <bool APPROXIMATE>
+	__attribute__((target("avx2,fma")))
+	void Accumulate_AVX2_Float(float mu, const float* mu_opp, const float* phi_opp, const float* scores, const float* games, size_t n, float& nu_sum, float& delta_sum)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 three_over_pi2 = _mm256_set1_ps(3/PI2_FLOAT);
+		const __m256 vmu = _mm256_set1_ps(mu);
+
+		__m256 sum1 = _mm256_setzero_ps(), sum2 = _mm256_setzero_ps();
+		size_t j = 0;
+		for (; j + 8 <= n; j += 8)
+		{
+			__m256 phi = _mm256_loadu_ps(phi_opp + j);
+			__m256 g = APPROXIMATE ? phi : _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_fmadd_ps(_mm256_mul_ps(phi, phi), three_over_pi2, one)));
+			__m256 diff = _mm256_sub_ps(_mm256_loadu_ps(mu_opp + j), vmu);
+			__m256 E = _mm256_div_ps(one, _mm256_add_ps(one, Exp_AVX2(_mm256_mul_ps(g, diff))));
+			__m256 w = _mm256_loadu_ps(games + j);
+			sum1 = _mm256_fmadd_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(g, g), E), w), _mm256_sub_ps(one, E), sum1);
+			sum2 = _mm256_fmadd_ps(g, _mm256_fnmadd_ps(w, E, _mm256_loadu_ps(scores + j)), sum2);
+		}
+
+		float lanes1[8], lanes2[8];
+		_mm256_storeu_ps(lanes1, sum1);
+		_mm256_storeu_ps(lanes2, sum2);
+		float tail1, tail2;
+		_mm256_zeroupper();
+		Accumulate_Scalar<decltype(mu), APPROXIMATE>(mu, mu_opp + j, phi_opp + j, scores + j, games + j, n - j, tail1, tail2);
+
+		nu_sum = (((lanes1[0] + lanes1[1]) + (lanes1[2] + lanes1[3])) + ((lanes1[4] + lanes1[5]) + (lanes1[6] + lanes1[7]))) + tail1;
+		delta_sum = (((lanes2[0] + lanes2[1]) + (lanes2[2] + lanes2[3])) + ((lanes2[4] + lanes2[5]) + (lanes2[6] + lanes2[7]))) + tail2;
+	}
+
+	template <bool APPROXIMATE>
+	__attribute__((target("avx512f")))
+	void Accumulate_AVX512_Float(float mu, const float* mu_opp, const float* phi_opp, const float* scores, const float* games, size_t n, float& nu_sum, float& delta_sum)
+	{
+		const __m512 one = _mm512_set1_ps(1.0f);
+		const __m512 three_over_pi2 = _mm512_set1_ps(3/PI2_FLOAT);
+		const __m512 vmu = _mm512_set1_ps(mu);
+
+		__m512 sum1 = _mm512_setzero_ps(), sum2 = _mm512_setzero_ps();
+		for (size_t j = 0; j < n; j += 16)
+		{
+			__mmask16 mask = n - j >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (n - j)) - 1);
+			__m512 phi = _mm512_maskz_loadu_ps(mask, phi_opp + j);
+			__m512 g = APPROXIMATE ? phi : _mm512_div_ps(one, _mm512_sqrt_ps(_mm512_fmadd_ps(_mm512_mul_ps(phi, phi), three_over_pi2, one)));
+			__m512 diff = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, mu_opp + j), vmu);
+			__m512 E = _mm512_div_ps(one, _mm512_add_ps(one, Exp_AVX512(_mm512_mul_ps(g, diff))));
+			__m512 w = _mm512_maskz_loadu_ps(mask, games + j);
+			sum1 = _mm512_mask3_fmadd_ps(_mm512_mul_ps(_mm512_mul_ps(_mm512_mul_ps(g, g), E), w), _mm512_sub_ps(one, E), sum1, mask);
+			sum2 = _mm512_mask3_fmadd_ps(g, _mm512_fnmadd_ps(w, E, _mm512_maskz_loadu_ps(mask, scores + j)), sum2, mask);
+		}
+
+		nu_sum = _mm512_reduce_add_ps(sum1);
+		delta_sum = _mm512_reduce_add_ps(sum2);
+	}
+
+	void Predict_Scalar(const double* mu, const double* phi, const double* sigma, const double* mu_opp, const double* phi_opp, size_t n, double* expected, double* gain)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			double g = Engine<double>::g(phi_opp[i]);
+			double E = 1/(1+std::exp(-1*g*(mu[i]-mu_opp[i])));
+			expected[i] = E;
+			gain[i] = g / (1/(phi[i]*phi[i] + sigma[i]*sigma[i]) + g*g * E * (1-E));
+		}
+	}
+
+	__attribute__((target("avx2,fma")))
+	void Predict_AVX2(const double* mu, const double* phi, const double* sigma, const double* mu_opp, const double* phi_opp, size_t n, double* expected, double* gain)
+	{
+		const __m256d one = _mm256_set1_pd(1.0);
+		const __m256d three_over_pi2 = _mm256_set1_pd(3/PI2);
+
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256d phi_j = _mm256_loadu_pd(phi_opp + i);
+			__m256d g = _mm256_div_pd(one, _mm256_sqrt_pd(_mm256_fmadd_pd(_mm256_mul_pd(phi_j, phi_j), three_over_pi2, one)));
+			__m256d diff = _mm256_sub_pd(_mm256_loadu_pd(mu_opp + i), _mm256_loadu_pd(mu + i));
+			__m256d E = _mm256_div_pd(one, _mm256_add_pd(one, Exp_AVX2(_mm256_mul_pd(g, diff))));
+			__m256d p = _mm256_loadu_pd(phi + i), s = _mm256_loadu_pd(sigma + i);
+			__m256d info = _mm256_div_pd(one, _mm256_fmadd_pd(p, p, _mm256_mul_pd(s, s)));
+			info = _mm256_fmadd_pd(_mm256_mul_pd(_mm256_mul_pd(g, g), E), _mm256_sub_pd(one, E), info);
+			_mm256_storeu_pd(expected + i, E);
+			_mm256_storeu_pd(gain + i, _mm256_div_pd(g, info));
+		}
+		Predict_Scalar(mu + i, phi + i, sigma + i, mu_opp + i, phi_opp + i, n - i, expected + i, gain + i);
+	}
+
+	__attribute__((target("avx512f")))
+	void Predict_AVX512(const double* mu, const double* phi, const double* sigma, const double* mu_opp, const double* phi_opp, size_t n, double* expected, double* gain)
+	{
+		const __m512d one = _mm512_set1_pd(1.0);
+		const __m512d three_over_pi2 = _mm512_set1_pd(3/PI2);
+
+		for (size_t i = 0; i < n; i += 8)
+		{
+			// the inactive lanes of the last block get phi = 1, not 0, so
+			// nothing divides by zero
+			__mmask8 mask = n - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (n - i)) - 1);
+			__m512d phi_j = _mm512_maskz_loadu_pd(mask, phi_opp + i);
+			__m512d g = _mm512_div_pd(one, _mm512_sqrt_pd(_mm512_fmadd_pd(_mm512_mul_pd(phi_j, phi_j), three_over_pi2, one)));
+			__m512d diff = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, mu_opp + i), _mm512_maskz_loadu_pd(mask, mu + i));
+			__m512d E = _mm512_div_pd(one, _mm512_add_pd(one, Exp_AVX512(_mm512_mul_pd(g, diff))));
+			__m512d p = _mm512_mask_loadu_pd(one, mask, phi + i), s = _mm512_maskz_loadu_pd(mask, sigma + i);
+			__m512d info = _mm512_div_pd(one, _mm512_fmadd_pd(p, p, _mm512_mul_pd(s, s)));
+			info = _mm512_fmadd_pd(_mm512_mul_pd(_mm512_mul_pd(g, g), E), _mm512_sub_pd(one, E), info);
+			_mm512_mask_storeu_pd(expected + i, mask, E);
+			_mm512_mask_storeu_pd(gain + i, mask, _mm512_div_pd(g, info));
+		}
+	}
+}
+
+namespace
+{
+	const double* Make_G_Table()
+	{
+		static double table[Kernel::G_TABLE_SIZE + 1];
+		for (int i = 0; i <= Kernel::G_TABLE_SIZE; i++)
+			table[i] = Engine<double>::g(i * (Kernel::G_TABLE_MAX / Kernel::G_TABLE_SIZE));
+		return table;
+	}
+}
+
+Kernel::ISA Kernel::isa = Kernel::SCALAR;
+Kernel::Accumulate_Fn Kernel::accumulate = &Accumulate_Scalar<double>;
+Kernel::Accumulate_Float_Fn Kernel::accumulate_float = &Accumulate_Scalar<float>;
+Kernel::Predict_Fn Kernel::predict = &Predict_Scalar;
+Kernel::Accumulate_Fn Kernel::accumulate_approximate = &Accumulate_Scalar<double, true>;
+Kernel::Accumulate_Float_Fn Kernel::accumulate_approximate_float = &Accumulate_Scalar<float, true>;
+const double* Kernel::g_table = Make_G_Table();
+
+namespace
+{
+	// pick the best kernel before main() runs
+	const Kernel::ISA initial_isa = Kernel::Select_ISA(Kernel::Best_ISA());
+}
+
+
+const char* Kernel::Get_ISA_Name()
+{
+	switch (isa)
+	{
+		case AVX512: return "avx512";
+		case AVX2: return "avx2";
+		default: return "scalar";
+	}
+}
+
+Kernel::ISA Kernel::Best_ISA()
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return AVX512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return AVX2;
+	return SCALAR;
+}
+
+Kernel::ISA Kernel::Select_ISA(ISA requested)
+{
+	ISA best = Best_ISA();
+	if (requested > best)
+		requested = best;
+
+	switch (requested)
+	{
+		case AVX512:
+			accumulate = &Accumulate_AVX512<false>;
+			accumulate_float = &Accumulate_AVX512_Float<false>;
+			accumulate_approximate = &Accumulate_AVX512<true>;
+			accumulate_approximate_float = &Accumulate_AVX512_Float<true>;
+			predict = &Predict_AVX512;
+			break;
+		case AVX2:
+			accumulate = &Accumulate_AVX2<false>;
+			accumulate_float = &Accumulate_AVX2_Float<false>;
+			accumulate_approximate = &Accumulate_AVX2<true>;
+			accumulate_approximate_float = &Accumulate_AVX2_Float<true>;
+			predict = &Predict_AVX2;
+			break;
+		default:
+			accumulate = &Accumulate_Scalar<double>;
+			accumulate_float = &Accumulate_Scalar<float>;
+			accumulate_approximate = &Accumulate_Scalar<double, true>;
+			accumulate_approximate_float = &Accumulate_Scalar<float, true>;
+			predict = &Predict_Scalar;
+			break;
+	}
+	isa = requested;
+	return isa;
+}
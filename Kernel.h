@@ -0,0 +1,128 @@
+#pragma once
+#include <cstddef>
+
+/*
+ * Fused per-opponent kernel of a Glicko-2 rating period.
+ *
+ * Accumulate() makes a single pass over a player's opponents, held as SoA
+ * arrays on the Glicko-2 scale (mu_j, phi_j), with the number of games w_j
+ * played against each and the total score s_j of those games. It computes
+ * g(phi_j) and E(mu, mu_j, phi_j) once per opponent, however many games,
+ * returning
+ *
+ *     nu_sum    = sum_j w_j * g(phi_j)^2 * E_j * (1 - E_j)
+ *     delta_sum = sum_j g(phi_j) * (s_j - w_j * E_j)
+ *
+ * which is the sum over the games with each one counted separately. With
+ * one game per opponent the weights are multiplications by 1, exact, so the
+ * results are the same as the unweighted sums bit for bit.
+ *
+ * The implementation is chosen at runtime from the instruction sets the CPU
+ * supports. The scalar version evaluates exactly the same expressions as the
+ * original three-pass code and is bit-identical to it. The AVX2 and AVX-512
+ * versions keep one partial sum per lane and use a polynomial exp() accurate
+ * to about 1 ULP, so they differ from the scalar path by rounding only. The
+ * sums are added in a different order, so that difference grows with the
+ * number of opponents n: the ratings and RDs a rating period produces
+ * through them stay within Ulp_Tolerance(n) ULPs of the scalar results
+ * (at most 0.7 ULP per opponent measured, e.g. 34000 ULPs, 4e-12 relative,
+ * for a player with 300000). The new volatility is only solved to the 1e-6
+ * tolerance of the Illinois iteration, so it is held to that instead.
+ * glicko2-bench checks all three. Every path is deterministic, so a given
+ * ISA always produces the same ratings regardless of thread count.
+ *
+ * The float overload runs twice as many opponents per vector (8 with AVX2,
+ * 16 with AVX-512), with the SIMD lanes accumulating in float too; ratings
+ * and RDs rated through it stay within Float_Tolerance(n) (relative) of the
+ * double path, which likewise grows with the opponents (3.5e-8 per opponent
+ * measured, 2e-4 for 700000). It is for bulk recomputation where that is
+ * enough (see Engine.h), not for the canonical ratings.
+ *
+ * Predict() is the same arithmetic over n independent games, each of a
+ * player (mu, phi, sigma) against an opponent (mu_j, phi_j) as the player's
+ * only game of a rating period with the volatility held, returning
+ *
+ *     expected = E(mu, mu_j, phi_j)
+ *     gain     = phi'^2 * g(phi_j) = g / (1/(phi^2 + sigma^2) + g^2 * E * (1 - E))
+ *
+ * so that a score s would move mu by gain * (s - E). The SIMD versions
+ * differ from the scalar one by the rounding of exp() only.
+ *
+ * Accumulate_Approximate() is Accumulate() for bulk runs that can trade a
+ * little accuracy for speed. It takes g(phi_j) itself in place of phi_j,
+ * which the caller looks up in G_Table() (linear interpolation there is
+ * within 4e-8 of g() on [0, G_TABLE_MAX], i.e. RDs up to about 695), and
+ * the double versions replace exp() with a division-free polynomial within
+ * 3e-9 relative error (Exp_Approximate() in SimdMath.h). The float SIMD
+ * exp() has no division to save, so the float versions only skip g().
+ * One period moves ratings about 2e-6 rating points off the exact path;
+ * from there the difference compounds through the volatility solve, as
+ * the rounding differences between ISAs do, and ratings and RDs stay within
+ * APPROXIMATE_TOLERANCE rating points of it over APPROXIMATE_PERIODS periods
+ * of the bench's synthetic league (about 2e-3 measured; glicko2-bench
+ * reports the drift).
+ */
+class Kernel
+{
+public:
+	enum ISA { SCALAR, AVX2, AVX512 };
+
+	static const int ULP_TOLERANCE = 64;
+	static constexpr double ULPS_PER_OPPONENT = 2;
+	static constexpr double FLOAT_TOLERANCE = 1e-5;
+	static constexpr double FLOAT_TOLERANCE_PER_OPPONENT = 1e-7;
+	static constexpr double APPROXIMATE_TOLERANCE = 1e-2;
+	static const int APPROXIMATE_PERIODS = 10;
+
+	// g(i * G_TABLE_MAX / G_TABLE_SIZE) for i = 0 to G_TABLE_SIZE
+	static const int G_TABLE_SIZE = 4096;
+	static constexpr double G_TABLE_MAX = 4;
+
+	// for a player rated against n opponents
+	static double Ulp_Tolerance(size_t n)
+	{ return ULP_TOLERANCE + ULPS_PER_OPPONENT * n; }
+
+	static double Float_Tolerance(size_t n)
+	{ return FLOAT_TOLERANCE + FLOAT_TOLERANCE_PER_OPPONENT * n; }
+
+	static void Accumulate(double mu, const double* mu_opp, const double* phi_opp, const double* scores, const double* games, size_t n, double& nu_sum, double& delta_sum)
+	{ accumulate(mu, mu_opp, phi_opp, scores, games, n, nu_sum, delta_sum); }
+
+	static void Accumulate(float mu, const float* mu_opp, const float* phi_opp, const float* scores, const float* games, size_t n, float& nu_sum, float& delta_sum)
+	{ accumulate_float(mu, mu_opp, phi_opp, scores, games, n, nu_sum, delta_sum); }
+
+	static void Accumulate_Approximate(double mu, const double* mu_opp, const double* g_opp, const double* scores, const double* games, size_t n, double& nu_sum, double& delta_sum)
+	{ accumulate_approximate(mu, mu_opp, g_opp, scores, games, n, nu_sum, delta_sum); }
+
+	static void Accumulate_Approximate(float mu, const float* mu_opp, const float* g_opp, const float* scores, const float* games, size_t n, float& nu_sum, float& delta_sum)
+	{ accumulate_approximate_float(mu, mu_opp, g_opp, scores, games, n, nu_sum, delta_sum); }
+
+	static const double* G_Table()
+	{ return g_table; }
+
+	static void Predict(const double* mu, const double* phi, const double* sigma, const double* mu_opp, const double* phi_opp, size_t n, double* expected, double* gain)
+	{ predict(mu, phi, sigma, mu_opp, phi_opp, n, expected, gain); }
+
+	static ISA Get_ISA()
+	{ return isa; }
+
+	static const char* Get_ISA_Name();
+
+	// Overrides the runtime choice; falls back to SCALAR when the CPU lacks
+	// the requested instruction set. Returns the ISA actually selected.
+	static ISA Select_ISA(ISA requested);
+	static ISA Best_ISA();
+
+private:
+	typedef void (*Accumulate_Fn)(double, const double*, const double*, const double*, const double*, size_t, double&, double&);
+	typedef void (*Accumulate_Float_Fn)(float, const float*, const float*, const float*, const float*, size_t, float&, float&);
+	typedef void (*Predict_Fn)(const double*, const double*, const double*, const double*, const double*, size_t, double*, double*);
+
+	static ISA isa;
+	static Accumulate_Fn accumulate;
+	static Accumulate_Float_Fn accumulate_float;
+	static Predict_Fn predict;
+	static Accumulate_Fn accumulate_approximate;
+	static Accumulate_Float_Fn accumulate_approximate_float;
+	static const double* g_table;
+};
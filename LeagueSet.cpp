@@ -0,0 +1,292 @@
+#include "LeagueSet.h"
+#include "Engine.h"
+#include "Stats.h"
+#include "Volatility.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const double SCALE = Engine<double>::SCALE;
+}
+
+LeagueSet::LeagueSet(unsigned threads) :
+	pool{ threads },
+	arenas(pool.Get_Threads())
+{
+}
+
+std::string LeagueSet::Key(uint32_t league, const std::string& name)
+{
+	std::string key (sizeof(league), '\0');
+	std::memcpy(&key[0], &league, sizeof(league));
+	return key += name;
+}
+
+uint32_t LeagueSet::Add_League(double tau)
+{
+	League league;
+	league.tau = tau;
+	leagues.push_back(league);
+	return leagues.size() - 1;
+}
+
+uint32_t LeagueSet::Add_Player(uint32_t league, std::string name, double rating, double rd, double volatility)
+{
+	if (league >= leagues.size())
+		return npos;
+
+	auto inserted = index.emplace(Key(league, name), names.size());
+	if (!inserted.second)
+		return inserted.first->second;
+
+	Stats::Count(Stats::PLAYERS_ADDED);
+	this->rating.push_back(rating);
+	this->rd.push_back(rd);
+	vol.push_back(volatility);
+	league_of.push_back(league);
+	rated_period.push_back(leagues[league].period);
+	names.push_back(std::move(name));
+	active_slot.push_back(npos);
+	++leagues[league].players;
+	return names.size() - 1;
+}
+
+uint32_t LeagueSet::Find(uint32_t league, const std::string& name) const
+{
+	auto it = index.find(Key(league, name));
+	return it == index.end() ? npos : it->second;
+}
+
+bool LeagueSet::Add_Match(uint32_t player, uint32_t opponent, int score)
+{
+	if (player >= names.size() || opponent >= names.size() || league_of[player] != league_of[opponent] || score < 0 || score > 1)
+		return false;
+
+	matches.Add(player, opponent, score);
+	Stats::Count(Stats::MATCHES_ADDED);
+	if (active_slot[player] == npos)
+	{
+		active_slot[player] = active.size();
+		active.push_back(player);
+		++leagues[league_of[player]].active;
+	}
+	return true;
+}
+
+bool LeagueSet::Schedule_Close(uint32_t league)
+{
+	if (league >= leagues.size())
+		return false;
+	if (!leagues[league].due)
+	{
+		leagues[league].due = true;
+		due.push_back(league);
+	}
+	return true;
+}
+
+void LeagueSet::Reserve(size_t players, size_t matches)
+{
+	rating.reserve(players);
+	rd.reserve(players);
+	vol.reserve(players);
+	league_of.reserve(players);
+	rated_period.reserve(players);
+	names.reserve(players);
+	active_slot.reserve(players);
+	index.reserve(players);
+	this->matches.Reserve(matches);
+}
+
+double LeagueSet::Get_Current_RD(uint32_t id) const
+{
+	// as Glicko2::Get_Current_RD(), against the player's league's clock
+	double rd = this->rd[id];
+	for (uint32_t p = rated_period[id]; p < leagues[league_of[id]].period; p++)
+	{
+		double phi_p = std::sqrt(std::pow(rd / SCALE, 2) + std::pow(vol[id],2));
+		rd = SCALE*phi_p;
+	}
+	return rd;
+}
+
+size_t LeagueSet::Close_Due()
+{
+	if (due.empty())
+		return 0;
+	Stats::Count(Stats::PERIODS, due.size());
+
+	// the active players of the due leagues are rated, grouped by league so
+	// that a block mostly shares a tau; the others stay active, mapped out of
+	// the batch meanwhile
+	batch.clear();
+	size_t kept = 0;
+	for (uint32_t id : active)
+	{
+		if (leagues[league_of[id]].due)
+			batch.push_back(id);
+		else
+		{
+			active[kept++] = id;
+			active_slot[id] = npos;
+		}
+	}
+	active.resize(kept);
+	// in order of arrival within a league, by the slots they still hold
+	std::sort(batch.begin(), batch.end(), [&](uint32_t a, uint32_t b)
+	{
+		return league_of[a] != league_of[b] ? league_of[a] < league_of[b] : active_slot[a] < active_slot[b];
+	});
+
+	size_t count = batch.size();
+	for (size_t k = 0; k < count; k++)
+		active_slot[batch[k]] = k;
+	{
+		Stats::Timer timer { Stats::INDEX_MATCHES };
+		matches.Build_Index(count, active_slot.data());
+	}
+
+	// every player is rated into temporaries, so every read sees the
+	// pre-period values
+	rating_p.resize(count);
+	rd_p.resize(count);
+	vol_p.resize(count);
+	pool.Run(count, 256, [&](unsigned worker, size_t begin, size_t end)
+	{
+		Rate(begin, end, arenas[worker]);
+	});
+
+	for (size_t k = 0; k < count; k++)
+	{
+		uint32_t id = batch[k];
+		rating[id] = rating_p[k];
+		rd[id] = rd_p[k];
+		vol[id] = vol_p[k];
+		rated_period[id] = leagues[league_of[id]].period + 1;
+	}
+
+	// the batch's matches are done with; the other leagues' wait for their
+	// own close
+	if (kept == 0)
+		matches.Clear();
+	else
+		matches.Remove(count, active_slot.data());
+	for (uint32_t id : batch)
+		active_slot[id] = npos;
+	for (size_t k = 0; k < kept; k++)
+		active_slot[active[k]] = k;
+
+	size_t closed = due.size();
+	for (uint32_t league : due)
+	{
+		++leagues[league].period;
+		leagues[league].active = 0;
+		leagues[league].due = false;
+	}
+	due.clear();
+	// as in Glicko2, every worker keeps room for the most any of them needed
+	size_t capacity = 0;
+	for (const Arena& arena : arenas)
+		capacity = std::max(capacity, arena.Capacity());
+	for (Arena& arena : arenas)
+		arena.Reset(capacity);
+	return closed;
+}
+
+void LeagueSet::Rate(size_t begin, size_t end, Arena& arena)
+{
+	// the same steps as Glicko2::Rate(), for the double engine
+	typedef Engine<double> Engine_Type;
+
+	Arena::Mark block_mark = arena.Get_Mark();
+	size_t size = end - begin;
+	double* block_mu = arena.Allocate<double>(size);
+	double* block_phi = arena.Allocate<double>(size);
+	double* block_nu = arena.Allocate<double>(size);
+	double* block_delta = arena.Allocate<double>(size);
+	double* block_sum = arena.Allocate<double>(size);
+	double* block_sigma = arena.Allocate<double>(size);
+	double* block_sigma_p = arena.Allocate<double>(size);
+	int* block_iterations = arena.Allocate<int>(size);
+
+	Stats::Timer opponents_timer { Stats::RATE_OPPONENTS };
+	size_t matches_read = 0;
+	for (size_t g = begin; g < end; g++)
+	{
+		uint32_t id = batch[g];
+		uint32_t first = matches.Begin(g), last = matches.End(g);
+		size_t num_runs = last - first;
+
+		// runs against the same opponent in a row become one opponent
+		Arena::Mark player_mark = arena.Get_Mark();
+		double* mu_opp = arena.Allocate<double>(num_runs);
+		double* phi_opp = arena.Allocate<double>(num_runs);
+		double* scores = arena.Allocate<double>(num_runs);
+		double* games = arena.Allocate<double>(num_runs);
+		size_t num_opponents = 0;
+		for (uint32_t i = first; i < last; i++)
+		{
+			uint32_t opp = matches.Get_Opponent(i), run = matches.Get_Games(i);
+			double total = Engine_Type::Score_Value(matches.Get_Score(i)) * double(run);
+			matches_read += run;
+			if (num_opponents > 0 && opp == matches.Get_Opponent(i-1))
+			{
+				scores[num_opponents-1] += total;
+				games[num_opponents-1] += double(run);
+				continue;
+			}
+			mu_opp[num_opponents] = Engine_Type::Mu(rating[opp]);
+			phi_opp[num_opponents] = Engine_Type::Opponent_Phi(Get_Current_RD(opp));
+			scores[num_opponents] = total;
+			games[num_opponents] = double(run);
+			++num_opponents;
+		}
+
+		double mu = Engine_Type::Mu(rating[id]), phi = Engine_Type::Phi(Get_Current_RD(id));
+		double sum1, sum2;
+		Engine_Type::Accumulate(mu, mu_opp, phi_opp, scores, games, num_opponents, sum1, sum2);
+		arena.Rewind(player_mark);
+		double nu = 1 / sum1;
+
+		size_t k = g - begin;
+		block_mu[k] = mu;
+		block_phi[k] = phi;
+		block_nu[k] = nu;
+		block_delta[k] = nu * sum2;
+		block_sum[k] = sum2;
+		block_sigma[k] = vol[id];
+	}
+	opponents_timer.Stop();
+	Stats::Count(Stats::PLAYERS_RATED, size);
+	Stats::Count(Stats::MATCHES_READ, matches_read);
+
+	// new volatilities, one solve per league in the block
+	Stats::Timer volatility_timer { Stats::RATE_VOLATILITY };
+	for (size_t k = 0; k < size; )
+	{
+		uint32_t league = league_of[batch[begin+k]];
+		size_t run = 1;
+		while (k + run < size && league_of[batch[begin+k+run]] == league)
+			++run;
+		Volatility::Solve(&block_phi[k], &block_nu[k], &block_delta[k], &block_sigma[k], run, leagues[league].tau, &block_sigma_p[k], &block_iterations[k]);
+		k += run;
+	}
+	volatility_timer.Stop();
+	Stats::Record_Iterations(block_iterations, size);
+
+	Stats::Timer update_timer { Stats::RATE_UPDATE };
+	for (size_t k = 0; k < size; k++)
+	{
+		double phi = block_phi[k], volatility_p = block_sigma_p[k];
+		double phi_star = std::sqrt(std::pow(phi,2) + std::pow(volatility_p,2));
+		double phi_p = 1 / std::sqrt((1/std::pow(phi_star,2)) + (1/block_nu[k]));
+		double mu_p = block_mu[k] + std::pow(phi_p,2)*block_sum[k];
+
+		rating_p[begin+k] = SCALE * mu_p + Engine<double>::BASE;
+		rd_p[begin+k] = SCALE * phi_p;
+		vol_p[begin+k] = volatility_p;
+	}
+	arena.Rewind(block_mark);
+}
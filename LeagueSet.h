@@ -0,0 +1,152 @@
+#pragma once
+#include "Arena.h"
+#include "MatchTable.h"
+#include "WorkPool.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Many independent Glicko-2 ladders ("leagues") rated in one process.
+ *
+ * The players of every league share one set of SoA columns (rating, RD,
+ * volatility, name, league), addressed by a dense global player ID, and
+ * the results of every league go into one shared MatchTable; a league
+ * itself is only its tau, its period clock and a few counters, so a small
+ * league costs a few dozen bytes plus its players, not a Glicko2 instance
+ * of its own. Names are unique within a league, and found through a
+ * single index over all of them.
+ *
+ * Periods are incremental, as with Glicko2::Close_Period(): a match is
+ * recorded for its player against an opponent of the same league, and
+ * closing a league's period rates the players that played in it, while the
+ * RD inflation of those who sat it out is deferred until their RD is read
+ * (Get_Current_RD()). Leagues close on their own clocks: Schedule_Close()
+ * marks a league as due, and Close_Due() then closes every due league in
+ * one batch, rating all of their active players together in parallel, each
+ * with their own league's tau, and leaves the matches of the other leagues
+ * for their next close. A player is rated exactly as by a Glicko2 with the
+ * same tau, players and matches, bit for bit.
+ *
+ * Scores are WIN_LOSS (see Glicko2::Scoring), and the rating is always
+ * done in double with the exact math.
+ */
+class LeagueSet
+{
+public:
+	static constexpr uint32_t npos = UINT32_MAX;
+
+	// a thread count of 0 means one thread per hardware thread
+	explicit LeagueSet(unsigned threads = 1);
+
+	LeagueSet(const LeagueSet&) = delete;
+	LeagueSet& operator=(const LeagueSet&) = delete;
+
+	uint32_t Add_League(double tau = 0.6);
+
+	// the ID of the player in the league with this name, added with the
+	// given rating if there's none yet; npos if there's no such league
+	uint32_t Add_Player(uint32_t league, std::string name, double rating = 1500, double rd = 350, double volatility = 0.06);
+	uint32_t Find(uint32_t league, const std::string& name) const;
+
+	// false if either player doesn't exist, they are in different leagues
+	// or the score isn't 0 or 1
+	bool Add_Match(uint32_t player, uint32_t opponent, int score);
+
+	// false if there's no such league
+	bool Schedule_Close(uint32_t league);
+
+	// closes the period of every scheduled league; returns how many
+	size_t Close_Due();
+
+	void Reserve(size_t players, size_t matches);
+
+	size_t Num_Leagues() const
+	{ return leagues.size(); }
+
+	size_t Num_Players() const
+	{ return names.size(); }
+
+	double Get_Tau(uint32_t league) const
+	{ return leagues[league].tau; }
+
+	// false if there's no such league
+	bool Set_Tau(uint32_t league, double tau)
+	{
+		if (league >= leagues.size())
+			return false;
+		leagues[league].tau = tau;
+		return true;
+	}
+
+	uint32_t Get_Period(uint32_t league) const
+	{ return leagues[league].period; }
+
+	uint32_t Num_Players(uint32_t league) const
+	{ return leagues[league].players; }
+
+	// players of the league that have played since its last close
+	uint32_t Num_Active(uint32_t league) const
+	{ return leagues[league].active; }
+
+	bool Is_Due(uint32_t league) const
+	{ return leagues[league].due; }
+
+	uint32_t Get_League(uint32_t id) const
+	{ return league_of[id]; }
+
+	const std::string& Get_Name(uint32_t id) const
+	{ return names[id]; }
+
+	double Get_Rating(uint32_t id) const
+	{ return rating[id]; }
+
+	double Get_Current_RD(uint32_t id) const;
+
+	double Get_Vol(uint32_t id) const
+	{ return vol[id]; }
+
+	const MatchTable& Get_Matches() const
+	{ return matches; }
+
+private:
+	struct League
+	{
+		double tau;
+		uint32_t period = 0;
+		uint32_t players = 0;
+		uint32_t active = 0;
+		bool due = false;
+	};
+
+	std::vector<League> leagues;
+	std::vector<uint32_t> due;
+
+	// the players of every league
+	std::vector<double> rating;
+	std::vector<double> rd;
+	std::vector<double> vol;
+	std::vector<uint32_t> league_of;
+	std::vector<uint32_t> rated_period;	// of their league's clock, as in Glicko2
+	std::vector<std::string> names;
+	std::unordered_map<std::string, uint32_t> index;	// by Key()
+
+	// the players with matches this period, in order of their first, and
+	// where each is in the list (npos when idle)
+	MatchTable matches;
+	std::vector<uint32_t> active;
+	std::vector<uint32_t> active_slot;
+
+	// Close_Due() state, kept so closing doesn't allocate once it's warm
+	WorkPool pool;
+	std::vector<Arena> arenas;
+	std::vector<uint32_t> batch;
+	std::vector<double> rating_p;
+	std::vector<double> rd_p;
+	std::vector<double> vol_p;
+
+	static std::string Key(uint32_t league, const std::string& name);
+	void Rate(size_t begin, size_t end, Arena& arena);
+};
@@ -0,0 +1,340 @@
+#include "MatchLog.h"
+#include "Snapshot.h"
+#include "Stats.h"
+#include <cstddef>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	const char MAGIC[8] = { 'G', 'L', 'I', 'C', 'K', 'O', '2', 'L' };
+	const uint32_t BATCH_MAGIC = 0x48435442;	// "BTCH"
+
+	struct Log_Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t header_size;
+		uint64_t base_sequence;
+	};
+
+	struct Batch_Header
+	{
+		uint32_t magic;
+		uint32_t payload_size;
+		uint64_t first_sequence;
+		uint32_t count;
+		uint32_t reserved;
+		uint64_t checksum;	// over the fields above, then the payload
+	};
+
+	uint64_t Batch_Checksum(const Batch_Header& header, const char* payload)
+	{
+		uint64_t seed = Snapshot::Checksum(&header, offsetof(Batch_Header, checksum));
+		return Snapshot::Checksum(payload, header.payload_size, seed);
+	}
+
+	bool Read_At(int fd, void* bytes, size_t count, uint64_t offset)
+	{
+		char* p = static_cast<char*>(bytes);
+		while (count > 0)
+		{
+			ssize_t n = ::pread(fd, p, count, offset);
+			if (n <= 0)
+				return false;
+			p += n; count -= n; offset += n;
+		}
+		return true;
+	}
+
+	// bounds-checked reads from a batch payload
+	struct Payload_Reader
+	{
+		const char* p;
+		const char* end;
+
+		template <typename T>
+		bool Get(T& value)
+		{
+			if (end - p < static_cast<ptrdiff_t>(sizeof(T)))
+				return false;
+			std::memcpy(&value, p, sizeof(T));
+			p += sizeof(T);
+			return true;
+		}
+	};
+}
+
+MatchLog::~MatchLog()
+{
+	Close();
+}
+
+int MatchLog::Open(const char* filename, uint64_t first_sequence, const std::function<void(const Record&)>& replay)
+{
+	Close();
+	fd = ::open(filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return CANNOT_OPEN;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		Close();
+		return CANNOT_OPEN;
+	}
+
+	// a new log, or one that crashed before its header was complete
+	Log_Header header;
+	if (static_cast<size_t>(st.st_size) < sizeof(header))
+	{
+		sequence = first_sequence;
+		if (!Write_Header(first_sequence))
+		{
+			Close();
+			return WRITE_FAILED;
+		}
+		return OK;
+	}
+
+	if (!Read_At(fd, &header, sizeof(header), 0)
+		|| std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+		|| header.version != VERSION
+		|| header.header_size != sizeof(header)
+		|| header.base_sequence > first_sequence)
+	{
+		Close();
+		return BAD_FORMAT;
+	}
+
+	// replay whole batches up to the first one that's torn or out of sequence
+	uint64_t offset = sizeof(header), size = st.st_size;
+	uint64_t next = header.base_sequence;
+	std::vector<char> payload;
+	Batch_Header batch;
+	while (offset + sizeof(batch) <= size && Read_At(fd, &batch, sizeof(batch), offset))
+	{
+		if (batch.magic != BATCH_MAGIC || batch.first_sequence != next || offset + sizeof(batch) + batch.payload_size > size)
+			break;
+		payload.resize(batch.payload_size);
+		if (!Read_At(fd, payload.data(), payload.size(), offset + sizeof(batch)) || Batch_Checksum(batch, payload.data()) != batch.checksum)
+			break;
+
+		Payload_Reader in { payload.data(), payload.data() + payload.size() };
+		for (uint32_t i = 0; i < batch.count; i++)
+		{
+			Record record {};
+			uint8_t type = 0;
+			bool ok = in.Get(type);
+			record.type = static_cast<Record_Type>(type);
+			record.sequence = next + i;
+			switch (type)
+			{
+				case PLAYER:
+					{
+						uint8_t member;
+						uint16_t length;
+						ok = ok && in.Get(member) && in.Get(record.rating) && in.Get(record.rd) && in.Get(record.vol) && in.Get(length)
+							&& in.end - in.p >= length;
+						if (ok)
+						{
+							record.member = member != 0;
+							record.name = std::string_view{ in.p, length };
+							in.p += length;
+						}
+					}
+					break;
+				case MATCH:
+					ok = ok && in.Get(record.player) && in.Get(record.opponent) && in.Get(record.score);
+					break;
+				case RUN_PLAYER:
+					ok = ok && in.Get(record.player);
+					break;
+				case RUN:
+				case CLOSE_PERIOD:
+				case CLEAR_MATCHES:
+					break;
+				default:
+					ok = false;
+			}
+
+			// a batch that passed its checksum but doesn't decode wasn't
+			// written by this code
+			if (!ok)
+			{
+				Close();
+				return BAD_FORMAT;
+			}
+			if (record.sequence >= first_sequence)
+				replay(record);
+		}
+
+		next += batch.count;
+		offset += sizeof(batch) + batch.payload_size;
+	}
+
+	// all of it is covered by the checkpoint; start over from there so the
+	// numbering stays contiguous
+	if (next < first_sequence)
+	{
+		sequence = first_sequence;
+		if (!Write_Header(first_sequence))
+		{
+			Close();
+			return WRITE_FAILED;
+		}
+		return OK;
+	}
+
+	// cut off a torn tail, so new batches follow the last good one
+	sequence = next;
+	if ((offset < size && (::ftruncate(fd, offset) != 0 || ::fdatasync(fd) != 0)) || ::lseek(fd, offset, SEEK_SET) < 0)
+	{
+		Close();
+		return WRITE_FAILED;
+	}
+	return OK;
+}
+
+void MatchLog::Close()
+{
+	if (fd >= 0)
+	{
+		Commit();
+		::close(fd);
+	}
+	fd = -1;
+	buffer.clear();
+	pending = 0;
+}
+
+template <typename T>
+void MatchLog::Put(T value)
+{
+	const char* p = reinterpret_cast<const char*>(&value);
+	buffer.insert(buffer.end(), p, p + sizeof(T));
+}
+
+void MatchLog::Begin_Record(Record_Type type)
+{
+	// the batch header goes in front of the records; Commit() fills it in
+	if (pending == 0)
+		buffer.assign(sizeof(Batch_Header), 0);
+	Put(type);
+	++pending;
+	++sequence;
+}
+
+bool MatchLog::Append_Player(std::string_view name, double rating, double rd, double vol, bool member)
+{
+	if (name.size() > MAX_NAME)
+		return false;
+	uint16_t length = name.size();
+	Begin_Record(PLAYER);
+	Put(static_cast<uint8_t>(member));
+	Put(rating);
+	Put(rd);
+	Put(vol);
+	Put(length);
+	buffer.insert(buffer.end(), name.data(), name.data() + length);
+	if (buffer.size() >= GROUP_BYTES)
+		Commit();
+	return true;
+}
+
+void MatchLog::Append_Match(uint32_t player, uint32_t opponent, int32_t score)
+{
+	Begin_Record(MATCH);
+	Put(player);
+	Put(opponent);
+	Put(score);
+	if (buffer.size() >= GROUP_BYTES)
+		Commit();
+}
+
+void MatchLog::Append_Run()
+{
+	Begin_Record(RUN);
+}
+
+void MatchLog::Append_Run(uint32_t player)
+{
+	Begin_Record(RUN_PLAYER);
+	Put(player);
+}
+
+void MatchLog::Append_Close_Period()
+{
+	Begin_Record(CLOSE_PERIOD);
+}
+
+void MatchLog::Append_Clear_Matches()
+{
+	Begin_Record(CLEAR_MATCHES);
+}
+
+bool MatchLog::Commit()
+{
+	if (fd < 0 || pending == 0)
+		return fd >= 0;
+	Stats::Timer timer { Stats::LOG_COMMIT };
+
+	Batch_Header header;
+	header.magic = BATCH_MAGIC;
+	header.payload_size = buffer.size() - sizeof(header);
+	header.first_sequence = sequence - pending;
+	header.count = pending;
+	header.reserved = 0;
+	header.checksum = Batch_Checksum(header, buffer.data() + sizeof(header));
+	std::memcpy(buffer.data(), &header, sizeof(header));
+
+	off_t start = ::lseek(fd, 0, SEEK_CUR);
+	size_t done = 0;
+	while (done < buffer.size())
+	{
+		ssize_t n = ::write(fd, buffer.data() + done, buffer.size() - done);
+		if (n <= 0)
+			break;
+		done += n;
+	}
+
+	// on failure the batch stays buffered; take back what made it to the
+	// file, so a later commit doesn't land after a torn batch
+	if (done < buffer.size() || ::fdatasync(fd) != 0)
+	{
+		if (start >= 0 && ::ftruncate(fd, start) == 0)
+			::lseek(fd, start, SEEK_SET);
+		return false;
+	}
+
+	buffer.clear();
+	pending = 0;
+	return true;
+}
+
+bool MatchLog::Reset()
+{
+	return Commit() && Write_Header(sequence);
+}
+
+bool MatchLog::Write_Header(uint64_t base_sequence)
+{
+	Log_Header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.header_size = sizeof(header);
+	header.base_sequence = base_sequence;
+
+	// the new header goes in before the old batches are cut off: if that is
+	// interrupted, the batches no longer follow on from the header and are
+	// dropped when the log is reopened
+	return ::pwrite(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header))
+		&& ::fdatasync(fd) == 0
+		&& ::ftruncate(fd, sizeof(header)) == 0
+		&& ::fdatasync(fd) == 0
+		&& ::lseek(fd, sizeof(header), SEEK_SET) >= 0;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+/*
+ * Append-only write-ahead log of everything that changes a Glicko2 system:
+ * players entering the store, matches, rating runs, period closes and the
+ * clearing of matches. Replaying it on top of the checkpoint it continues
+ * from rebuilds the system exactly, since the engine is deterministic.
+ *
+ * Every record gets the next sequence number. Records are buffered and
+ * written in batches, each with a header and a checksum, by Commit(), which
+ * also fdatasync()s the file; one sync thus covers every record since the
+ * last (group commit). A full buffer commits by itself. A crash can only
+ * lose what wasn't committed, and a torn last batch is detected by its
+ * checksum and cut off when the log is reopened.
+ *
+ * The file starts with a header holding the sequence number of its first
+ * record. After a checkpoint, Reset() empties the log while the numbering
+ * carries on, so a checkpoint records the sequence number it covers up to.
+ * All numbers are stored in the native (little-endian) byte order.
+ */
+class MatchLog
+{
+public:
+	static const uint32_t VERSION = 1;
+	static const size_t GROUP_BYTES = 1 << 20;
+
+	// the longest player name a record can hold
+	static const size_t MAX_NAME = UINT16_MAX;
+
+	// return codes of Open(), the same as Snapshot's
+	enum { OK = 0, CANNOT_OPEN = 1, BAD_FORMAT = 2, WRITE_FAILED = 4 };
+
+	enum Record_Type : uint8_t { PLAYER = 1, MATCH = 2, RUN = 3, RUN_PLAYER = 4, CLOSE_PERIOD = 5, CLEAR_MATCHES = 6 };
+
+	// one decoded record; which fields are set depends on the type
+	struct Record
+	{
+		Record_Type type;
+		uint64_t sequence;
+		uint32_t player;		// MATCH, RUN_PLAYER
+		uint32_t opponent;		// MATCH
+		int32_t score;			// MATCH
+		bool member;			// PLAYER
+		double rating, rd, vol;	// PLAYER
+		std::string_view name;	// PLAYER
+	};
+
+	MatchLog() = default;
+	~MatchLog();
+
+	MatchLog(const MatchLog&) = delete;
+	MatchLog& operator=(const MatchLog&) = delete;
+
+	/*
+	 * Opens the log for appending, creating it if needed. The records already
+	 * in it with a sequence number of at least `first_sequence` are handed to
+	 * `replay` in order first. Returns BAD_FORMAT if the log starts after
+	 * `first_sequence`, as the records in between are lost.
+	 */
+	int Open(const char* filename, uint64_t first_sequence, const std::function<void(const Record&)>& replay);
+	void Close();
+
+	bool Is_Open() const
+	{ return fd >= 0; }
+
+	// sequence number of the next record
+	uint64_t Get_Sequence() const
+	{ return sequence; }
+
+	// returns false, appending nothing, if the name is longer than MAX_NAME
+	bool Append_Player(std::string_view name, double rating, double rd, double vol, bool member);
+	void Append_Match(uint32_t player, uint32_t opponent, int32_t score);
+	void Append_Run();
+	void Append_Run(uint32_t player);
+	void Append_Close_Period();
+	void Append_Clear_Matches();
+
+	// writes the buffered records as one batch and syncs them to disk
+	bool Commit();
+
+	// drops every record, once a checkpoint covers them
+	bool Reset();
+
+private:
+	int fd = -1;
+	uint64_t sequence = 0;
+	uint32_t pending = 0;		// records in the buffer
+	std::vector<char> buffer;
+
+	template <typename T>
+	void Put(T value);
+	void Begin_Record(Record_Type type);
+	bool Write_Header(uint64_t base_sequence);
+};
@@ -0,0 +1,125 @@
+#include "MatchTable.h"
+#include <algorithm>
+#include <vector>
+
+void MatchTable::Add(uint32_t player, uint32_t opponent, int score, uint32_t games)
+{
+	num_games += games;
+	indexed = false;
+	if (!players.empty() && players.back() == player && opponents.back() == opponent && scores.back() == score)
+	{
+		this->games.back() += games;
+		return;
+	}
+	players.push_back(player);
+	opponents.push_back(opponent);
+	scores.push_back(score);
+	this->games.push_back(games);
+}
+
+void MatchTable::Build_Index(size_t num_players)
+{
+	Build_Index(num_players, nullptr);
+}
+
+void MatchTable::Build_Index(size_t num_groups, const uint32_t* group_of_player)
+{
+	// counting sort of the runs by group (by player when there's no map);
+	// runs whose player maps outside [0, num_groups) are left out
+	auto group = [=](uint32_t player) -> size_t { return group_of_player ? group_of_player[player] : player; };
+
+	offsets.assign(num_groups+1, 0);
+	for (uint32_t player : players)
+		if (group(player) < num_groups)
+			++offsets[group(player)+1];
+	for (size_t g = 0; g < num_groups; g++)
+		offsets[g+1] += offsets[g];
+
+	cursor.assign(offsets.begin(), offsets.end()-1);
+	runs.resize(offsets[num_groups]);
+	for (size_t i = 0; i < players.size(); i++)
+	{
+		size_t g = group(players[i]);
+		if (g < num_groups)
+			runs[cursor[g]++] = Run{ opponents[i], scores[i], games[i] };
+	}
+
+	// a grouped index is only good until the caller is done with it
+	indexed = group_of_player == nullptr;
+}
+
+void MatchTable::Assign(size_t num_players, const uint32_t* offsets, const uint32_t* opponents, const int32_t* scores)
+{
+	// already grouped by player, so the runs come out indexed; a game that
+	// repeats the one before it extends its run
+	size_t count = offsets[num_players];
+	Clear();
+	Reserve(count);
+	num_games = count;
+	this->offsets.assign(num_players+1, 0);
+	for (size_t id = 0; id < num_players; id++)
+	{
+		for (uint32_t i = offsets[id]; i < offsets[id+1]; i++)
+		{
+			if (i > offsets[id] && opponents[i] == opponents[i-1] && scores[i] == scores[i-1])
+			{
+				++games.back();
+				continue;
+			}
+			players.push_back(id);
+			this->opponents.push_back(opponents[i]);
+			this->scores.push_back(scores[i]);
+			games.push_back(1);
+		}
+		this->offsets[id+1] = players.size();
+	}
+
+	runs.resize(players.size());
+	for (size_t i = 0; i < players.size(); i++)
+		runs[i] = Run{ this->opponents[i], this->scores[i], games[i] };
+	indexed = true;
+}
+
+void MatchTable::Reserve(size_t count)
+{
+	players.reserve(count);
+	opponents.reserve(count);
+	scores.reserve(count);
+	games.reserve(count);
+}
+
+void MatchTable::Remove(size_t num_groups, const uint32_t* group_of_player)
+{
+	size_t kept = 0;
+	num_games = 0;
+	for (size_t i = 0; i < players.size(); i++)
+	{
+		if (group_of_player[players[i]] < num_groups)
+			continue;
+		players[kept] = players[i];
+		opponents[kept] = opponents[i];
+		scores[kept] = scores[i];
+		games[kept] = games[i];
+		num_games += games[i];
+		++kept;
+	}
+	players.resize(kept);
+	opponents.resize(kept);
+	scores.resize(kept);
+	games.resize(kept);
+	offsets.clear();
+	runs.clear();
+	indexed = false;
+}
+
+void MatchTable::Clear()
+{
+	players.clear();
+	opponents.clear();
+	scores.clear();
+	games.clear();
+	num_games = 0;
+	offsets.clear();
+	runs.clear();
+	indexed = false;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Flat, append-only table of match results for a rating period.
+ *
+ * Each record is a (player_id, opponent_id, score, games) run referring into
+ * a RatingStore: `games` games in a row between the same two players, each
+ * with the same score. Add() extends the last run when it can, so W wins
+ * and then L losses against one opponent take two records rather than W+L,
+ * while the games can still be listed one by one, in order. Size() counts
+ * games, not runs.
+ *
+ * Runs are appended in arrival order; Build_Index() groups them by player
+ * into CSR form (an offset array of one entry per player plus one, and an
+ * array of (opponent, score, games) runs, kept together so that indexing
+ * scatters each with a single write) so that the runs of player `id` are
+ * the half-open range [Begin(id), End(id)) of that array. The grouping is
+ * stable, so each player's runs keep their arrival order.
+ *
+ * Build_Index() can also group the records by an arbitrary map from player
+ * ID to group (e.g. the players active in the current period); Begin() and
+ * End() then take a group number, and records of players that map to no
+ * group are left out of the index.
+ */
+class MatchTable
+{
+public:
+	void Add(uint32_t player, uint32_t opponent, int score, uint32_t games = 1);
+	void Build_Index(size_t num_players);
+	void Build_Index(size_t num_groups, const uint32_t* group_of_player);
+
+	// one entry per game, grouped by player, as in a snapshot
+	void Assign(size_t num_players, const uint32_t* offsets, const uint32_t* opponents, const int32_t* scores);
+
+	void Reserve(size_t count);
+	void Clear();
+
+	// drops the runs of the players that map into [0, num_groups), as for
+	// Build_Index(), keeping the rest in order
+	void Remove(size_t num_groups, const uint32_t* group_of_player);
+
+	size_t Size() const
+	{ return num_games; }
+
+	size_t Num_Runs() const
+	{ return players.size(); }
+
+	bool Is_Indexed() const
+	{ return indexed; }
+
+	uint32_t Begin(uint32_t group) const
+	{ return offsets[group]; }
+
+	uint32_t End(uint32_t group) const
+	{ return offsets[group+1]; }
+
+	uint32_t Get_Player(uint32_t record) const
+	{ return players[record]; }
+
+	uint32_t Get_Opponent(uint32_t i) const
+	{ return runs[i].opponent; }
+
+	// the score of each game of the run
+	int Get_Score(uint32_t i) const
+	{ return runs[i].score; }
+
+	uint32_t Get_Games(uint32_t i) const
+	{ return runs[i].games; }
+
+	const uint32_t* Offsets() const
+	{ return offsets.data(); }
+
+private:
+	// append-only runs, in arrival order
+	std::vector<uint32_t> players;
+	std::vector<uint32_t> opponents;
+	std::vector<int> scores;
+	std::vector<uint32_t> games;
+	size_t num_games = 0;
+
+	// CSR index built from the records
+	struct Run
+	{
+		uint32_t opponent;
+		int score;
+		uint32_t games;
+	};
+
+	bool indexed = false;
+	std::vector<uint32_t> offsets;
+	std::vector<Run> runs;
+
+	// Build_Index() scratch, kept so indexing every period doesn't allocate
+	std::vector<uint32_t> cursor;
+};
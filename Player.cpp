@@ -3,32 +3,39 @@
 #include <utility>
 
 Player::Player(std::string name, double rating, double rd, double volatility) :
-	name{ name },
+	name{ std::move(name) },
 	rating{ rating },
 	rd{ rd },
 	volatility{ volatility }
 {}
 
-Player::Player(std::string name, double rating, double rd, double volatility, std::vector<Player>& opps, std::vector<int>& scores) :
-	name{ name },
+Player::Player(std::string name, double rating, double rd, double volatility, const std::vector<Player>& opps, const std::vector<int>& scores) :
+	name{ std::move(name) },
 	rating{ rating },
 	rd{ rd },
 	volatility{ volatility }
 {
+	match_history.reserve(opps.size());
 	for (size_t i = 0; i < opps.size(); i++)
-	{
-		std::pair<Player, int> match { opps[i], scores[i] };
-		match_history.push_back(match);
-	}
+		match_history.emplace_back(opps[i], scores[i]);
 }
 
 void Player::Add_Match (const Player& player, int result)
 {
-	std::pair<Player, int> match { player, result };
-	match_history.push_back(match);
+	match_history.emplace_back(player, result);
+}
+
+void Player::Add_Match (Player&& player, int result)
+{
+	match_history.emplace_back(std::move(player), result);
 }
 
 void Player::Add_Match (const std::pair<Player, int>& match)
 {
 	match_history.push_back(match);
 }
+
+void Player::Add_Match (std::pair<Player, int>&& match)
+{
+	match_history.push_back(std::move(match));
+}
@@ -6,12 +6,17 @@
 class Player
 {
 public:
-	Player (std::string name, double rating, double rd, double volatility, std::vector<Player>& opps, std::vector<int>& scores);
+	Player (std::string name, double rating, double rd, double volatility, const std::vector<Player>& opps, const std::vector<int>& scores);
 	Player(std::string name = "Player", double rating = 1500, double rd = 350, double volatility = 0.06);
 
-	std::string Get_Name() const
+	// the getters of a temporary hand over its name and history instead of
+	// copying them
+	const std::string& Get_Name() const &
 	{ return name; }
 
+	std::string Get_Name() &&
+	{ return std::move(name); }
+
 	double Get_Rating() const
 	{ return rating; }
 
@@ -21,9 +26,12 @@ public:
 	double Get_Vol() const
 	{ return volatility; }
 
-	std::vector<std::pair<Player, int>> Get_Match_History() const
+	const std::vector<std::pair<Player, int>>& Get_Match_History() const &
 	{ return match_history; }
 
+	std::vector<std::pair<Player, int>> Get_Match_History() &&
+	{ return std::move(match_history); }
+
 	void Set_Name(const std::string& name)
 	{ this->name = name; }
 
@@ -39,8 +47,13 @@ public:
 	void Set_Match_History (const std::vector<std::pair<Player, int>>& mh)
 	{ this->match_history = mh; }
 
+	void Set_Match_History (std::vector<std::pair<Player, int>>&& mh)
+	{ this->match_history = std::move(mh); }
+
 	void Add_Match (const Player&, int);
+	void Add_Match (Player&&, int);
 	void Add_Match (const std::pair<Player, int>&);
+	void Add_Match (std::pair<Player, int>&&);
 
 private:
 	std::string name;
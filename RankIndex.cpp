@@ -0,0 +1,322 @@
+#include "RankIndex.h"
+#include <algorithm>
+
+namespace
+{
+	const uint32_t NONE = UINT32_MAX;
+
+	// higher key first, then lower ID
+	bool Before(double key_a, uint32_t a, double key_b, uint32_t b)
+	{ return key_a != key_b ? key_a > key_b : a < b; }
+
+	// where (key, id) is or would go among a block's sorted entries
+	size_t Lower_Bound(const std::vector<uint32_t>& ids, const std::vector<double>& keys, double key, uint32_t id)
+	{
+		size_t low = 0, high = ids.size();
+		while (low < high)
+		{
+			size_t mid = low + (high - low) / 2;
+			if (Before(keys[mid], ids[mid], key, id))
+				low = mid + 1;
+			else
+				high = mid;
+		}
+		return low;
+	}
+}
+
+void RankIndex::Clear()
+{
+	blocks.clear();
+	free_blocks.clear();
+	block_order.clear();
+	block_position.clear();
+	tree.clear();
+	block_of.clear();
+	key_of.clear();
+	size = 0;
+}
+
+void RankIndex::Build(const uint32_t* ids, const double* keys, size_t count)
+{
+	Clear();
+	Update(ids, keys, count);
+}
+
+void RankIndex::Update(const uint32_t* ids, const double* keys, size_t count)
+{
+	if (count == 0)
+		return;
+
+	uint32_t max_id = *std::max_element(ids, ids + count);
+	if (block_of.size() <= max_id)
+	{
+		block_of.resize(max_id + 1, NONE);
+		key_of.resize(max_id + 1);
+	}
+
+	// a few players are moved one at a time, each in O(BLOCK_SIZE + log n)
+	if (count * 32 <= size)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			if (block_of[ids[i]] != NONE)
+				Remove(ids[i]);
+			Insert(ids[i], keys[i]);
+		}
+		return;
+	}
+
+	// many are sorted and merged with the unchanged entries, still in order,
+	// in O(n + k log k); their old entries are flagged for removal
+	changed.resize(count);
+	for (size_t i = 0; i < count; i++)
+		changed[i] = { keys[i], ids[i] };
+	std::sort(changed.begin(), changed.end(), [](const std::pair<double, uint32_t>& a, const std::pair<double, uint32_t>& b)
+	{ return Before(a.first, a.second, b.first, b.second); });
+
+	const uint32_t REMOVED = NONE - 1;
+	for (size_t i = 0; i < count; i++)
+		if (block_of[ids[i]] != NONE)
+			block_of[ids[i]] = REMOVED;
+
+	merged.clear();
+	merged.reserve(size + count);
+	size_t c = 0;
+	for (uint32_t b : block_order)
+	{
+		const Block& block = blocks[b];
+		for (size_t i = 0; i < block.ids.size(); i++)
+		{
+			uint32_t id = block.ids[i];
+			if (block_of[id] == REMOVED)
+				continue;
+			for (; c < count && Before(changed[c].first, changed[c].second, block.keys[i], id); c++)
+				merged.push_back(changed[c]);
+			merged.push_back({ block.keys[i], id });
+		}
+	}
+	for (; c < count; c++)
+		merged.push_back(changed[c]);
+	Assign(merged);
+}
+
+void RankIndex::Assign(const std::vector<std::pair<double, uint32_t>>& entries)
+{
+	// half-full blocks, so that a block takes many inserts before it splits
+	const size_t FILL = BLOCK_SIZE / 2;
+	size_t count = (entries.size() + FILL - 1) / FILL;
+	blocks.resize(count);
+	free_blocks.clear();
+	block_order.resize(count);
+	for (size_t b = 0; b < count; b++)
+	{
+		Block& block = blocks[b];
+		block.ids.clear();
+		block.keys.clear();
+		size_t end = std::min(entries.size(), (b + 1) * FILL);
+		for (size_t i = b * FILL; i < end; i++)
+		{
+			block.ids.push_back(entries[i].second);
+			block.keys.push_back(entries[i].first);
+			block_of[entries[i].second] = b;
+			key_of[entries[i].second] = entries[i].first;
+		}
+		block_order[b] = b;
+	}
+	size = entries.size();
+	Rebuild_Tree();
+}
+
+void RankIndex::Insert(uint32_t id, double key)
+{
+	// Update() only inserts one at a time into an index of at least 32
+	// entries, so there is always a block to insert into
+
+	// the first block whose last entry doesn't come before the new one, or
+	// the last block if they all do
+	size_t low = 0, high = block_order.size();
+	while (low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+		const Block& block = blocks[block_order[mid]];
+		if (Before(block.keys.back(), block.ids.back(), key, id))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	size_t position = std::min(low, block_order.size() - 1);
+	uint32_t b = block_order[position];
+
+	Block& block = blocks[b];
+	size_t i = Lower_Bound(block.ids, block.keys, key, id);
+	block.ids.insert(block.ids.begin() + i, id);
+	block.keys.insert(block.keys.begin() + i, key);
+	block_of[id] = b;
+	key_of[id] = key;
+	++size;
+	if (block.ids.size() > BLOCK_SIZE)
+		Split(b);
+	else
+		Tree_Add(position, true);
+}
+
+void RankIndex::Remove(uint32_t id)
+{
+	uint32_t b = block_of[id];
+	Block& block = blocks[b];
+	size_t i = Offset_Of(id);
+	block.ids.erase(block.ids.begin() + i);
+	block.keys.erase(block.keys.begin() + i);
+	block_of[id] = NONE;
+	--size;
+	if (block.ids.empty())
+	{
+		block_order.erase(block_order.begin() + block_position[b]);
+		free_blocks.push_back(b);
+		Rebuild_Tree();
+	}
+	else
+		Tree_Add(block_position[b], false);
+}
+
+void RankIndex::Split(uint32_t b)
+{
+	// the upper half moves to a new block right after it
+	uint32_t next = New_Block();
+	Block& block = blocks[b];
+	Block& upper = blocks[next];
+	size_t half = block.ids.size() / 2;
+	upper.ids.assign(block.ids.begin() + half, block.ids.end());
+	upper.keys.assign(block.keys.begin() + half, block.keys.end());
+	block.ids.resize(half);
+	block.keys.resize(half);
+	for (uint32_t id : upper.ids)
+		block_of[id] = next;
+	block_order.insert(block_order.begin() + block_position[b] + 1, next);
+	Rebuild_Tree();
+}
+
+uint32_t RankIndex::New_Block()
+{
+	if (free_blocks.empty())
+	{
+		blocks.emplace_back();
+		return blocks.size() - 1;
+	}
+	uint32_t b = free_blocks.back();
+	free_blocks.pop_back();
+	return b;
+}
+
+void RankIndex::Rebuild_Tree()
+{
+	size_t count = block_order.size();
+	block_position.resize(blocks.size());
+	tree.assign(count + 1, 0);
+	for (size_t p = 0; p < count; p++)
+	{
+		block_position[block_order[p]] = p;
+		tree[p + 1] = blocks[block_order[p]].ids.size();
+	}
+	for (size_t i = 1; i <= count; i++)
+	{
+		size_t parent = i + (i & -i);
+		if (parent <= count)
+			tree[parent] += tree[i];
+	}
+}
+
+void RankIndex::Tree_Add(size_t position, bool increment)
+{
+	for (size_t i = position + 1; i < tree.size(); i += i & -i)
+		if (increment)
+			++tree[i];
+		else
+			--tree[i];
+}
+
+size_t RankIndex::Tree_Prefix(size_t position) const
+{
+	// entries in the blocks before this position
+	size_t sum = 0;
+	for (size_t i = position; i > 0; i -= i & -i)
+		sum += tree[i];
+	return sum;
+}
+
+std::pair<size_t, size_t> RankIndex::Tree_Find(size_t rank) const
+{
+	// the position of the block holding this rank, and its offset in it
+	size_t position = 0, step = 1;
+	while (step * 2 < tree.size())
+		step *= 2;
+	for (; step > 0; step /= 2)
+		if (position + step < tree.size() && tree[position + step] <= rank)
+		{
+			position += step;
+			rank -= tree[position];
+		}
+	return { position, rank };
+}
+
+size_t RankIndex::Offset_Of(uint32_t id) const
+{
+	const Block& block = blocks[block_of[id]];
+	return Lower_Bound(block.ids, block.keys, key_of[id], id);
+}
+
+uint32_t RankIndex::At(size_t rank) const
+{
+	std::pair<size_t, size_t> found = Tree_Find(rank);
+	return blocks[block_order[found.first]].ids[found.second];
+}
+
+double RankIndex::Key_At(size_t rank) const
+{
+	std::pair<size_t, size_t> found = Tree_Find(rank);
+	return blocks[block_order[found.first]].keys[found.second];
+}
+
+void RankIndex::Copy_Order(uint32_t* out) const
+{
+	for (uint32_t b : block_order)
+		out = std::copy(blocks[b].ids.begin(), blocks[b].ids.end(), out);
+}
+
+size_t RankIndex::Rank_Of(uint32_t id) const
+{
+	if (id >= block_of.size() || block_of[id] == NONE)
+		return npos;
+	return Tree_Prefix(block_position[block_of[id]]) + Offset_Of(id);
+}
+
+template <typename Predicate>
+size_t RankIndex::First_Rank(Predicate after) const
+{
+	// the rank of the first entry whose key is `after` the boundary, which
+	// every entry following it is too
+	size_t low = 0, high = block_order.size();
+	while (low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+		if (after(blocks[block_order[mid]].keys.back()))
+			high = mid;
+		else
+			low = mid + 1;
+	}
+	if (low == block_order.size())
+		return size;
+	const std::vector<double>& keys = blocks[block_order[low]].keys;
+	size_t offset = std::partition_point(keys.begin(), keys.end(), [&](double key) { return !after(key); }) - keys.begin();
+	return Tree_Prefix(low) + offset;
+}
+
+std::pair<size_t, size_t> RankIndex::Range(double low, double high) const
+{
+	// keys descend, so the range starts at the first key <= high and ends
+	// before the first key < low
+	size_t first = First_Rank([=](double key) { return key <= high; });
+	size_t last = First_Rank([=](double key) { return key < low; });
+	return { first, std::max(first, last) };
+}
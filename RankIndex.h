@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+ * Order-statistics index over players, best first.
+ *
+ * Players are kept sorted by a key, highest first, ties broken by the lower
+ * player ID. The order is held in blocks of at most BLOCK_SIZE entries, the
+ * blocks themselves in order, with a Fenwick tree over their sizes, so that
+ * At(), Key_At(), Rank_Of() and Range() are O(log n). Update() re-keys a
+ * batch of k players by taking each out of its block and inserting it into
+ * the block its new key falls in, in O(k (BLOCK_SIZE + log n)); a block that
+ * fills up is split, and one that empties is dropped. A batch that is a
+ * large part of the index is instead merged into the order of the rest in
+ * O(n + k log k), which is cheaper then.
+ *
+ * The key is either the rating or the conservative rating - 2*RD, which
+ * ranks a player by the rating they are very likely to be at least.
+ */
+class RankIndex
+{
+public:
+	enum Key { RATING, CONSERVATIVE };
+
+	static constexpr size_t npos = SIZE_MAX;
+	static const uint32_t BLOCK_SIZE = 512;
+
+	void Clear();
+
+	// replaces the index with the given players
+	void Build(const uint32_t* ids, const double* keys, size_t count);
+
+	// re-keys the given players, adding those not yet indexed; the IDs must
+	// be distinct
+	void Update(const uint32_t* ids, const double* keys, size_t count);
+
+	size_t Size() const
+	{ return size; }
+
+	// player ID at a 0-based rank
+	uint32_t At(size_t rank) const;
+	double Key_At(size_t rank) const;
+
+	// the player IDs in rank order, Size() of them
+	void Copy_Order(uint32_t* out) const;
+
+	// 0-based rank of a player, npos if not indexed
+	size_t Rank_Of(uint32_t id) const;
+
+	// ranks [first, last) of the players whose key is in [low, high]
+	std::pair<size_t, size_t> Range(double low, double high) const;
+
+private:
+	struct Block
+	{
+		std::vector<uint32_t> ids;
+		std::vector<double> keys;
+	};
+
+	std::vector<Block> blocks;				// by block number
+	std::vector<uint32_t> free_blocks;
+	std::vector<uint32_t> block_order;		// block numbers, best first
+	std::vector<uint32_t> block_position;	// by block number, in block_order
+	std::vector<size_t> tree;				// of the block sizes, by position + 1
+	std::vector<uint32_t> block_of;			// by player ID, UINT32_MAX if not indexed
+	std::vector<double> key_of;				// by player ID
+	size_t size = 0;
+
+	// scratch for bulk updates, kept to avoid reallocating every period
+	std::vector<std::pair<double, uint32_t>> changed;
+	std::vector<std::pair<double, uint32_t>> merged;
+
+	void Assign(const std::vector<std::pair<double, uint32_t>>& entries);
+	void Insert(uint32_t id, double key);
+	void Remove(uint32_t id);
+	void Split(uint32_t block);
+	uint32_t New_Block();
+	void Rebuild_Tree();
+	void Tree_Add(size_t position, bool increment);
+	size_t Tree_Prefix(size_t position) const;
+	std::pair<size_t, size_t> Tree_Find(size_t rank) const;
+	size_t Offset_Of(uint32_t id) const;
+	template <typename Predicate>
+	size_t First_Rank(Predicate after) const;
+};
@@ -0,0 +1,85 @@
+#include "RatingStore.h"
+#include "Stats.h"
+#include <algorithm>
+#include <string>
+#include <utility>
+
+uint32_t RatingStore::Add(std::string name, double rating, double rd, double volatility, bool member)
+{
+	if (index_stale)
+		Build_Index();
+
+	auto it = index.find(name);
+	if (it != index.end())
+		return it->second;
+
+	uint32_t id = static_cast<uint32_t>(names.size());
+	index.emplace(name, id);
+	names.push_back(std::move(name));
+	this->rating.push_back(rating);
+	this->rd.push_back(rd);
+	this->vol.push_back(volatility);
+	this->member.push_back(member);
+	num_members += member;
+	return id;
+}
+
+uint32_t RatingStore::Find(const std::string& name) const
+{
+	Stats::Count(Stats::NAME_LOOKUPS);
+	if (index_stale)
+		Build_Index();
+
+	auto it = index.find(name);
+	return it == index.end() ? npos : it->second;
+}
+
+void RatingStore::Reserve(size_t count)
+{
+	rating.reserve(count);
+	rd.reserve(count);
+	vol.reserve(count);
+	member.reserve(count);
+	names.reserve(count);
+	index.reserve(count);
+}
+
+void RatingStore::Clear()
+{
+	rating.clear();
+	rd.clear();
+	vol.clear();
+	member.clear();
+	names.clear();
+	num_members = 0;
+	index.clear();
+	index_stale = false;
+}
+
+void RatingStore::Assign(size_t count, const double* rating, const double* rd, const double* vol, const uint8_t* member, const char* const* names)
+{
+	this->rating.assign(rating, rating + count);
+	this->rd.assign(rd, rd + count);
+	this->vol.assign(vol, vol + count);
+	this->member.assign(member, member + count);
+	this->names.assign(names, names + count);
+	num_members = std::count_if(member, member + count, [](uint8_t m) { return m != 0; });
+	index.clear();
+	index_stale = true;
+}
+
+void RatingStore::Build_Index() const
+{
+	index.clear();
+	index.reserve(names.size());
+	for (uint32_t id = 0; id < names.size(); id++)
+		index.insert(std::pair<std::string, uint32_t>{ names[id], id });
+	index_stale = false;
+}
+
+void RatingStore::Swap_Columns(std::vector<double>& rating, std::vector<double>& rd, std::vector<double>& vol)
+{
+	this->rating.swap(rating);
+	this->rd.swap(rd);
+	this->vol.swap(vol);
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Structure-of-arrays storage for the ratings of every player in a system.
+ *
+ * Players are addressed by a dense uint32_t ID (0 .. Size()-1) handed out in
+ * insertion order; the rating, RD and volatility of player `id` live at
+ * index `id` of three contiguous columns, so a rating period can walk them
+ * linearly. Names are kept in a separate column plus a name->ID index that
+ * is only consulted at the API boundary.
+ *
+ * The index is rebuilt lazily after a bulk Assign(), so loading a large
+ * system doesn't pay for hashing every name until the first lookup by name.
+ *
+ * Opponents that appear in match results without being registered players
+ * are stored as well, flagged as non-members, so that every match can refer
+ * to its opponent by ID.
+ */
+class RatingStore
+{
+public:
+	static constexpr uint32_t npos = UINT32_MAX;
+
+	uint32_t Add(std::string name, double rating, double rd, double volatility, bool member = true);
+	uint32_t Find(const std::string& name) const;
+
+	void Assign(size_t count, const double* rating, const double* rd, const double* vol, const uint8_t* member, const char* const* names);
+
+	void Reserve(size_t count);
+	void Clear();
+
+	size_t Size() const
+	{ return names.size(); }
+
+	size_t Num_Members() const
+	{ return num_members; }
+
+	const std::string& Get_Name(uint32_t id) const
+	{ return names[id]; }
+
+	double Get_Rating(uint32_t id) const
+	{ return rating[id]; }
+
+	double Get_RD(uint32_t id) const
+	{ return rd[id]; }
+
+	double Get_Vol(uint32_t id) const
+	{ return vol[id]; }
+
+	bool Is_Member(uint32_t id) const
+	{ return member[id] != 0; }
+
+	void Set_Rating(uint32_t id, double rating)
+	{ this->rating[id] = rating; }
+
+	void Set_RD(uint32_t id, double rd)
+	{ this->rd[id] = rd; }
+
+	void Set_Vol(uint32_t id, double volatility)
+	{ this->vol[id] = volatility; }
+
+	void Set_Member(uint32_t id, bool member)
+	{ num_members += int(member) - int(this->member[id] != 0); this->member[id] = member; }
+
+	void Swap_Columns(std::vector<double>& rating, std::vector<double>& rd, std::vector<double>& vol);
+
+	const double* Ratings() const
+	{ return rating.data(); }
+
+	const double* RDs() const
+	{ return rd.data(); }
+
+	const double* Vols() const
+	{ return vol.data(); }
+
+	double* Ratings()
+	{ return rating.data(); }
+
+	double* RDs()
+	{ return rd.data(); }
+
+	double* Vols()
+	{ return vol.data(); }
+
+private:
+	std::vector<double> rating;
+	std::vector<double> rd;
+	std::vector<double> vol;
+	std::vector<uint8_t> member;
+	std::vector<std::string> names;
+	size_t num_members = 0;
+	mutable std::unordered_map<std::string, uint32_t> index;
+	mutable bool index_stale = false;
+
+	void Build_Index() const;
+};
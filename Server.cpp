@@ -0,0 +1,611 @@
+#include "Server.h"
+#include "Engine.h"
+#include "Glicko2.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+	// write end of the self-pipe the signal handler wakes the loop through;
+	// a pipe rather than a signalfd, so the signal may land on any thread
+	int signal_pipe = -1;
+
+	void On_Signal(int)
+	{
+		int saved = errno;
+		char byte = 0;
+		if (::write(signal_pipe, &byte, 1) < 0) {}
+		errno = saved;
+	}
+
+	template <typename T>
+	void Put(std::vector<char>& out, T value)
+	{
+		const char* p = reinterpret_cast<const char*>(&value);
+		out.insert(out.end(), p, p + sizeof(T));
+	}
+
+	void Put_String(std::vector<char>& out, const std::string& s)
+	{
+		uint16_t length = std::min<size_t>(s.size(), UINT16_MAX);
+		Put(out, length);
+		out.insert(out.end(), s.data(), s.data() + length);
+	}
+
+	// reserves the response header; End_Response() fills in the length
+	size_t Begin_Response(std::vector<char>& out, uint8_t opcode, uint8_t status)
+	{
+		size_t start = out.size();
+		Put(out, uint32_t{0});
+		Put(out, opcode);
+		Put(out, status);
+		return start;
+	}
+
+	void End_Response(std::vector<char>& out, size_t start)
+	{
+		uint32_t length = out.size() - start - sizeof(uint32_t);
+		std::memcpy(out.data() + start, &length, sizeof(length));
+	}
+
+	// bounds-checked reads from a request body
+	struct Body_Reader
+	{
+		const char* p;
+		const char* end;
+
+		template <typename T>
+		bool Get(T& value)
+		{
+			if (end - p < static_cast<ptrdiff_t>(sizeof(T)))
+				return false;
+			std::memcpy(&value, p, sizeof(T));
+			p += sizeof(T);
+			return true;
+		}
+
+		bool Get_String(std::string& s)
+		{
+			uint16_t length;
+			if (!Get(length) || end - p < length)
+				return false;
+			s.assign(p, length);
+			p += length;
+			return true;
+		}
+
+		bool Done() const
+		{ return p == end; }
+	};
+}
+
+Server::Server(Glicko2& system) :
+	system{ system }
+{}
+
+Server::~Server()
+{
+	if (close_thread.joinable())
+		close_thread.join();
+	delete next_view.exchange(nullptr);
+
+	for (auto& kv : connections)
+		::close(kv.first);
+	for (int fd : { listen_fd, wake_fd, epoll_fd, signal_fd })
+		if (fd >= 0)
+			::close(fd);
+	if (signal_pipe >= 0)
+		::close(signal_pipe);
+	signal_pipe = -1;
+}
+
+int Server::Run(const char* socket_path)
+{
+	sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (std::strlen(socket_path) >= sizeof(addr.sun_path))
+		return 1;
+	std::strcpy(addr.sun_path, socket_path);
+
+	// replace a socket left behind by an earlier daemon, but nothing else
+	struct stat st;
+	if (::stat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+		::unlink(socket_path);
+
+	listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0
+		|| ::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+		|| ::listen(listen_fd, SOMAXCONN) != 0)
+		return 1;
+
+	int pipe_fds[2];
+	if (::pipe2(pipe_fds, O_NONBLOCK | O_CLOEXEC) != 0)
+		return 1;
+	signal_fd = pipe_fds[0];
+	signal_pipe = pipe_fds[1];
+	struct sigaction action;
+	std::memset(&action, 0, sizeof(action));
+	action.sa_handler = On_Signal;
+	sigemptyset(&action.sa_mask);
+	::sigaction(SIGINT, &action, nullptr);
+	::sigaction(SIGTERM, &action, nullptr);
+
+	wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+	if (wake_fd < 0 || epoll_fd < 0)
+		return 1;
+	for (int fd : { listen_fd, signal_fd, wake_fd })
+	{
+		epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+			return 1;
+	}
+
+	// the name index must be built before a close thread can run alongside
+	// lookups, as building it lazily would modify the store
+	system.Get_Store().Find("");
+	view.reset(Make_View());
+
+	std::fprintf(stderr, "Serving %zu players on %s\n", view->by_rating.size(), socket_path);
+
+	bool running = true;
+	epoll_event events[64];
+	while (running)
+	{
+		int n = ::epoll_wait(epoll_fd, events, 64, -1);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			break;
+
+		for (int i = 0; i < n; i++)
+		{
+			int fd = events[i].data.fd;
+			if (fd == listen_fd)
+				Accept();
+			else if (fd == signal_fd)
+				running = false;
+			else if (fd == wake_fd)
+			{
+				uint64_t count;
+				if (::read(wake_fd, &count, sizeof(count)) > 0)
+					Finish_Close();
+			}
+			else
+			{
+				auto it = connections.find(fd);
+				if (it == connections.end())
+					continue;
+				Connection& conn = *it->second;
+				bool ok = !(events[i].events & (EPOLLERR | EPOLLHUP)) || (events[i].events & EPOLLIN);
+				if (ok && (events[i].events & EPOLLIN))
+					ok = Read(conn);
+				if (ok)
+					ok = Process(conn);
+				if (ok)
+					dirty.push_back(fd);
+				else
+					Drop(fd);
+			}
+		}
+
+		// group commit: one sync of the log covers every submit answered in
+		// this round, and no answer goes out before it
+		Flush_All();
+	}
+
+	// let a running close finish, so the system is left consistent
+	if (close_thread.joinable())
+		Finish_Close();
+	system.Commit_Log();
+	::unlink(socket_path);
+	return 0;
+}
+
+void Server::View::Add(const Row& row)
+{
+	if (size % PAGE_SIZE == 0)
+	{
+		pages.emplace_back(new Page);
+		pages.back()->reserve(PAGE_SIZE);
+	}
+	pages.back()->push_back(row);
+	++size;
+}
+
+double Server::View::Get_Current_RD(uint32_t id) const
+{
+	// as Glicko2::Get_Current_RD(), against the view's period
+	const double SCALE = Engine<double>::SCALE;
+	const Row& row = Get(id);
+	double rd = row.rd;
+	for (uint32_t p = row.rated_period; p < period; p++)
+	{
+		double phi_p = std::sqrt(std::pow(rd / SCALE, 2) + std::pow(row.vol,2));
+		rd = SCALE*phi_p;
+	}
+	return rd;
+}
+
+Server::Row Server::Make_Row(uint32_t id) const
+{
+	// opponents that aren't players never have their RD inflated
+	const RatingStore& store = system.Get_Store();
+	uint32_t rated_period = store.Is_Member(id) ? system.Get_Rated_Period(id) : UINT32_MAX;
+	return Row{ store.Get_Rating(id), store.Get_RD(id), store.Get_Vol(id), rated_period };
+}
+
+Server::View* Server::Make_View() const
+{
+	View* v = new View;
+	v->period = system.Get_Period();
+	for (uint32_t id = 0; id < system.Get_Store().Size(); id++)
+		v->Add(Make_Row(id));
+
+	// the system keeps the leaderboard sorted; this is just a copy
+	const RankIndex& ranking = system.Get_Ranking();
+	v->by_rating.resize(ranking.Size());
+	ranking.Copy_Order(v->by_rating.data());
+	return v;
+}
+
+Server::View* Server::Next_View() const
+{
+	// the published view's pages, with those of the players just rated
+	// copied and updated; the loop only reads the published view meanwhile
+	View* v = new View;
+	v->period = system.Get_Period();
+	v->size = view->size;
+	v->pages = view->pages;
+	for (uint32_t id : close_players)
+	{
+		std::shared_ptr<Page>& page = v->pages[id / PAGE_SIZE];
+		if (page == view->pages[id / PAGE_SIZE])
+			page = std::make_shared<Page>(*page);
+		v->Set(id) = Make_Row(id);
+	}
+
+	const RankIndex& ranking = system.Get_Ranking();
+	v->by_rating.resize(ranking.Size());
+	ranking.Copy_Order(v->by_rating.data());
+	return v;
+}
+
+void Server::Accept()
+{
+	while (true)
+	{
+		int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+
+		epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+		{
+			::close(fd);
+			continue;
+		}
+		std::unique_ptr<Connection> conn { new Connection };
+		conn->fd = fd;
+		connections[fd] = std::move(conn);
+	}
+}
+
+void Server::Drop(int fd)
+{
+	::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+	::close(fd);
+	connections.erase(fd);
+}
+
+bool Server::Read(Connection& conn)
+{
+	char buffer[65536];
+	while (true)
+	{
+		ssize_t n = ::read(conn.fd, buffer, sizeof(buffer));
+		if (n > 0)
+		{
+			conn.in.insert(conn.in.end(), buffer, buffer + n);
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+}
+
+bool Server::Process(Connection& conn)
+{
+	// answer every complete request in the buffer, in order; stop behind a
+	// pending close or a submit that has to wait for one, or while the
+	// client isn't reading its responses
+	size_t pos = 0;
+	while (!conn.waiting_close && conn.out.size() < 4 * MAX_FRAME && conn.in.size() - pos >= sizeof(uint32_t))
+	{
+		uint32_t length;
+		std::memcpy(&length, conn.in.data() + pos, sizeof(length));
+		if (length == 0 || length > MAX_FRAME)
+			return false;
+		if (conn.in.size() - pos - sizeof(length) < length)
+			break;
+
+		const char* frame = conn.in.data() + pos + sizeof(length);
+		if (closing && frame[0] == SUBMIT_MATCH)
+			break;
+		Handle(conn, frame[0], frame + 1, length - 1);
+		pos += sizeof(length) + length;
+	}
+	conn.in.erase(conn.in.begin(), conn.in.begin() + pos);
+	return true;
+}
+
+void Server::Handle(Connection& conn, uint8_t opcode, const char* body, uint32_t length)
+{
+	Body_Reader reader { body, body + length };
+	std::vector<char>& out = conn.out;
+
+	switch (opcode)
+	{
+		case SUBMIT_MATCH:
+			{
+				std::string player, opponent;
+				int32_t score;
+				if (!reader.Get_String(player) || !reader.Get_String(opponent) || !reader.Get(score) || !reader.Done() || player == opponent || score < 0 || score > system.Get_Max_Score())
+				{
+					End_Response(out, Begin_Response(out, opcode, BAD_REQUEST));
+					return;
+				}
+				Submit(player, opponent, score);
+				End_Response(out, Begin_Response(out, opcode, OK));
+			}
+			return;
+		case GET_PLAYER:
+			{
+				std::string name;
+				if (!reader.Get_String(name) || !reader.Done())
+				{
+					End_Response(out, Begin_Response(out, opcode, BAD_REQUEST));
+					return;
+				}
+				const RatingStore& store = system.Get_Store();
+				uint32_t id = store.Find(name);
+				if (id == RatingStore::npos)
+				{
+					End_Response(out, Begin_Response(out, opcode, NOT_FOUND));
+					return;
+				}
+
+				// the live system while it's idle, the published view while
+				// a close is rewriting it
+				double rating, rd, vol;
+				if (!closing)
+				{
+					rating = store.Get_Rating(id);
+					rd = system.Get_Current_RD(id);
+					vol = store.Get_Vol(id);
+				}
+				else
+				{
+					rating = view->Get(id).rating;
+					rd = view->Get_Current_RD(id);
+					vol = view->Get(id).vol;
+				}
+
+				size_t start = Begin_Response(out, opcode, OK);
+				Put(out, id);
+				Put(out, rating);
+				Put(out, rd);
+				Put(out, vol);
+				End_Response(out, start);
+			}
+			return;
+		case TOP_N:
+			{
+				uint32_t n;
+				if (!reader.Get(n) || !reader.Done())
+				{
+					End_Response(out, Begin_Response(out, opcode, BAD_REQUEST));
+					return;
+				}
+
+				// names are never modified once a player is registered, so
+				// they can be read from the store even during a close
+				const RatingStore& store = system.Get_Store();
+				uint32_t count = std::min<size_t>(n, view->by_rating.size());
+				size_t start = Begin_Response(out, opcode, OK);
+				Put(out, count);
+				for (uint32_t k = 0; k < count; k++)
+				{
+					uint32_t id = view->by_rating[k];
+					Put(out, id);
+					Put(out, view->Get(id).rating);
+					Put(out, view->Get_Current_RD(id));
+					Put_String(out, store.Get_Name(id));
+				}
+				End_Response(out, start);
+			}
+			return;
+		case CLOSE_PERIOD:
+			if (!reader.Done())
+				End_Response(out, Begin_Response(out, opcode, BAD_REQUEST));
+			else if (closing)
+				End_Response(out, Begin_Response(out, opcode, BUSY));
+			else
+				Start_Close(conn);
+			return;
+		default:
+			End_Response(out, Begin_Response(out, opcode, BAD_REQUEST));
+			return;
+	}
+}
+
+void Server::Flush_All()
+{
+	// while a close runs the log belongs to the closing thread, and nothing
+	// answered meanwhile has been logged
+	if (!closing && !system.Commit_Log())
+		std::fprintf(stderr, "could not commit the match log\n");
+
+	std::sort(dirty.begin(), dirty.end());
+	dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+	for (int fd : dirty)
+	{
+		auto it = connections.find(fd);
+		if (it != connections.end() && !Flush(*it->second))
+			Drop(fd);
+	}
+	dirty.clear();
+}
+
+bool Server::Flush(Connection& conn)
+{
+	size_t done = 0;
+	while (done < conn.out.size())
+	{
+		ssize_t n = ::send(conn.fd, conn.out.data() + done, conn.out.size() - done, MSG_NOSIGNAL);
+		if (n > 0)
+			done += n;
+		else if (n < 0 && errno == EINTR)
+			continue;
+		else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		else
+			return false;
+	}
+	conn.out.erase(conn.out.begin(), conn.out.begin() + done);
+
+	// only ask for writability while there's something left to send
+	bool want_write = !conn.out.empty();
+	if (want_write != conn.want_write)
+	{
+		epoll_event ev;
+		ev.events = want_write ? EPOLLIN | EPOLLOUT : EPOLLIN;
+		ev.data.fd = conn.fd;
+		::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev);
+		conn.want_write = want_write;
+	}
+	return true;
+}
+
+void Server::Start_Close(Connection& conn)
+{
+	// the log passes to the closing thread, and the submits answered in
+	// this round go out while it runs, so they are committed first
+	if (!system.Commit_Log())
+	{
+		std::fprintf(stderr, "could not commit the match log\n");
+		End_Response(conn.out, Begin_Response(conn.out, CLOSE_PERIOD, FAILED));
+		return;
+	}
+	// matches a Run() kept can't be closed on (see Glicko2::Close_Period())
+	if (system.Has_Rated_Matches())
+	{
+		End_Response(conn.out, Begin_Response(conn.out, CLOSE_PERIOD, FAILED));
+		return;
+	}
+
+	// bring in the players registered since the view was published, so
+	// every name the index knows has an entry while the close runs; no
+	// other view shares its pages until the close publishes one
+	for (uint32_t id = view->size; id < system.Get_Store().Size(); id++)
+		view->Add(Make_Row(id));
+	for (uint32_t id : registered)
+		view->Set(id) = Make_Row(id);
+	registered.clear();
+
+	conn.waiting_close = true;
+	closing = true;
+	close_players.assign(system.Get_Active().begin(), system.Get_Active().end());
+	close_rated = close_players.size();
+	close_failed = false;
+
+	close_thread = std::thread([this]
+	{
+		system.Close_Period();
+		if (system.Has_Log() && system.Checkpoint() != 0)
+		{
+			std::fprintf(stderr, "could not write a checkpoint\n");
+			close_failed = true;
+		}
+		next_view.store(Next_View(), std::memory_order_release);
+
+		uint64_t one = 1;
+		if (::write(wake_fd, &one, sizeof(one)) < 0) {}
+	});
+}
+
+void Server::Finish_Close()
+{
+	if (close_thread.joinable())
+		close_thread.join();
+	View* published = next_view.exchange(nullptr, std::memory_order_acquire);
+	if (published)
+		view.reset(published);
+	closing = false;
+
+	// answer the close, then resume the requests pipelined behind it and
+	// the submits held back while it ran
+	std::vector<int> dropped;
+	for (auto& kv : connections)
+	{
+		Connection& conn = *kv.second;
+		if (conn.waiting_close && close_failed)
+		{
+			End_Response(conn.out, Begin_Response(conn.out, CLOSE_PERIOD, FAILED));
+			conn.waiting_close = false;
+		}
+		else if (conn.waiting_close)
+		{
+			size_t start = Begin_Response(conn.out, CLOSE_PERIOD, OK);
+			Put(conn.out, view->period);
+			Put(conn.out, close_rated);
+			End_Response(conn.out, start);
+			conn.waiting_close = false;
+		}
+		if (Process(conn))
+			dirty.push_back(kv.first);
+		else
+			dropped.push_back(kv.first);
+	}
+	for (int fd : dropped)
+		Drop(fd);
+}
+
+void Server::Submit(const std::string& player, const std::string& opponent, int32_t score)
+{
+	system.Add_Match(Register(player), Register(opponent), score);
+}
+
+uint32_t Server::Register(const std::string& name)
+{
+	// newcomers start from the default rating; an opponent only seen in
+	// loaded results keeps the stats recorded for it
+	const RatingStore& store = system.Get_Store();
+	uint32_t id = store.Find(name);
+	if (id == RatingStore::npos)
+		system.Add_Player(Player{ name });
+	else if (!store.Is_Member(id))
+	{
+		system.Add_Player(Player{ name, store.Get_Rating(id), store.Get_RD(id), store.Get_Vol(id) });
+		registered.push_back(id);
+	}
+	return store.Find(name);
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class Glicko2;
+
+/*
+ * Long-running rating daemon serving a Glicko2 system over a Unix domain
+ * socket.
+ *
+ * One epoll loop serves every client. Clients may pipeline requests; the
+ * responses on a connection come back in request order. All integers are
+ * little-endian and every message is framed as
+ *
+ *     request:   u32 length, u8 opcode, body[length-1]
+ *     response:  u32 length, u8 opcode, u8 status, body[length-2]
+ *
+ * where strings are a u16 byte count followed by the bytes:
+ *
+ *     SUBMIT_MATCH  string player, string opponent, i32 score
+ *                   -> (empty); unknown players are registered with the
+ *                   default rating, and a score outside 0 to
+ *                   Glicko2::Get_Max_Score() is answered BAD_REQUEST
+ *     GET_PLAYER    string name -> u32 id, f64 rating, f64 rd, f64 vol
+ *     TOP_N         u32 n -> u32 count, count x (u32 id, f64 rating,
+ *                   f64 rd, string name)
+ *     CLOSE_PERIOD  (empty) -> u32 new period, u32 players rated
+ *
+ * A submitted match is recorded for the player, as with Glicko2::Add_Match();
+ * submit it again with the players swapped to rate the opponent on it too.
+ *
+ * CLOSE_PERIOD runs Glicko2::Close_Period() on a background thread and is
+ * answered when it completes; a connection's later requests wait behind it,
+ * and a close requested while one is running is answered BUSY. Meanwhile
+ * the loop keeps answering lookups from the view of the ratings published
+ * by the previous close (extended with any players registered since), so
+ * they never wait on the computation. The closing thread builds the next
+ * view and hands it to the loop through an atomic pointer. A view keeps
+ * each player's stored RD and inflates it on read, as the system does, so
+ * a close only changes the rows of the players it rated: the rows are
+ * held in pages shared between a view and the next, and the closing thread
+ * copies just the pages with a rated player in them. A submit that
+ * arrives during a close waits for it, and is recorded in the next period.
+ * TOP_N is always answered from the last published view, so players
+ * registered since then join it at the next close.
+ *
+ * If the system keeps a match log, the loop commits it once per round of
+ * events before sending any answer, and again before a close takes the log
+ * over, so an acknowledged submit is durable; every close is followed by a
+ * checkpoint. A close is answered FAILED if the log can't be committed
+ * before it or the system still holds matches a Run() rated (see
+ * Glicko2::Close_Period()), in which case the period stays open, or if the
+ * checkpoint after it can't be written, in which case the period has closed
+ * in memory but may not survive a restart.
+ */
+class Server
+{
+public:
+	enum Opcode : uint8_t { SUBMIT_MATCH = 1, GET_PLAYER = 2, TOP_N = 3, CLOSE_PERIOD = 4 };
+	enum Status : uint8_t { OK = 0, NOT_FOUND = 1, BAD_REQUEST = 2, BUSY = 3, FAILED = 4 };
+
+	static const uint32_t MAX_FRAME = 1 << 20;
+
+	explicit Server(Glicko2& system);
+	~Server();
+
+	Server(const Server&) = delete;
+	Server& operator=(const Server&) = delete;
+
+	// Serves until SIGINT or SIGTERM. Returns 0 on a clean shutdown, 1 if the
+	// socket couldn't be set up.
+	int Run(const char* socket_path);
+
+private:
+	static const uint32_t PAGE_SIZE = 1024;
+
+	struct Row
+	{
+		double rating;
+		double rd;				// as stored
+		double vol;
+		uint32_t rated_period;	// that the RD is current as of
+	};
+	typedef std::vector<Row> Page;
+
+	struct View
+	{
+		uint32_t period;
+		size_t size = 0;
+		std::vector<std::shared_ptr<Page>> pages;
+		std::vector<uint32_t> by_rating;
+
+		const Row& Get(uint32_t id) const
+		{ return (*pages[id / PAGE_SIZE])[id % PAGE_SIZE]; }
+
+		Row& Set(uint32_t id)
+		{ return (*pages[id / PAGE_SIZE])[id % PAGE_SIZE]; }
+
+		void Add(const Row& row);
+		double Get_Current_RD(uint32_t id) const;
+	};
+
+	struct Connection
+	{
+		int fd;
+		std::vector<char> in;
+		std::vector<char> out;
+		bool waiting_close = false;
+		bool want_write = false;
+	};
+
+	Glicko2& system;
+	int epoll_fd = -1;
+	int listen_fd = -1;
+	int signal_fd = -1;
+	int wake_fd = -1;
+
+	std::unique_ptr<View> view;
+	std::atomic<View*> next_view { nullptr };
+	std::atomic<bool> closing { false };
+	uint32_t close_rated = 0;
+	std::vector<uint32_t> close_players;	// rated by the running close
+	std::vector<uint32_t> registered;		// opponents made players since the view was published
+	bool close_failed = false;		// set by the closing thread, read after it's joined
+	std::thread close_thread;
+	std::vector<int> dirty;		// connections with answers to send
+	std::unordered_map<int, std::unique_ptr<Connection>> connections;
+
+	Row Make_Row(uint32_t id) const;
+	View* Make_View() const;
+	View* Next_View() const;
+	void Accept();
+	void Drop(int fd);
+	bool Read(Connection& conn);
+	bool Process(Connection& conn);
+	void Handle(Connection& conn, uint8_t opcode, const char* body, uint32_t length);
+	bool Flush(Connection& conn);
+	void Flush_All();
+	void Start_Close(Connection& conn);
+	void Finish_Close();
+	void Submit(const std::string& player, const std::string& opponent, int32_t score);
+	uint32_t Register(const std::string& name);
+};
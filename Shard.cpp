@@ -0,0 +1,162 @@
+#include "Shard.h"
+#include "Snapshot.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	const char MAGIC[8] = { 'G', 'L', 'I', 'C', 'K', 'O', '2', 'H' };
+
+	struct Shard_Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t header_size;
+		uint32_t shard;
+		uint32_t num_shards;
+		uint64_t count;
+		uint64_t source;
+		uint64_t checksum;
+	};
+
+	template <typename T>
+	void Append(std::vector<char>& out, const std::vector<T>& column)
+	{
+		const char* bytes = reinterpret_cast<const char*>(column.data());
+		out.insert(out.end(), bytes, bytes + column.size()*sizeof(T));
+	}
+
+	template <typename T>
+	void Extract(const char*& in, std::vector<T>& column, size_t count)
+	{
+		column.resize(count);
+		std::memcpy(column.data(), in, count*sizeof(T));
+		in += count*sizeof(T);
+	}
+}
+
+void Shard::Reset(uint32_t shard, uint32_t num_shards, uint64_t source)
+{
+	this->shard = shard;
+	this->num_shards = num_shards;
+	this->source = source;
+	ids.clear();
+	iterations.clear();
+	rating.clear();
+	rd.clear();
+	vol.clear();
+}
+
+void Shard::Reserve(size_t count)
+{
+	ids.reserve(count);
+	iterations.reserve(count);
+	rating.reserve(count);
+	rd.reserve(count);
+	vol.reserve(count);
+}
+
+void Shard::Add(uint32_t id, double rating, double rd, double volatility, int iterations)
+{
+	ids.push_back(id);
+	this->iterations.push_back(iterations);
+	this->rating.push_back(rating);
+	this->rd.push_back(rd);
+	vol.push_back(volatility);
+}
+
+int Shard::Write(const char* filename) const
+{
+	std::vector<char> buffer (sizeof(Shard_Header));
+	Append(buffer, ids);
+	Append(buffer, iterations);
+	Append(buffer, rating);
+	Append(buffer, rd);
+	Append(buffer, vol);
+
+	Shard_Header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.header_size = sizeof(header);
+	header.shard = shard;
+	header.num_shards = num_shards;
+	header.count = ids.size();
+	header.source = source;
+	header.checksum = Snapshot::Checksum(buffer.data() + sizeof(header), buffer.size() - sizeof(header));
+	std::memcpy(buffer.data(), &header, sizeof(header));
+
+	// written next to the target and renamed over it, like a snapshot, so
+	// the coordinator never reads a partial result
+	std::string tmp_filename { filename };
+	tmp_filename += ".tmp";
+	int fd = ::open(tmp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return CANNOT_OPEN;
+
+	size_t done = 0;
+	while (done < buffer.size())
+	{
+		ssize_t n = ::write(fd, buffer.data() + done, buffer.size() - done);
+		if (n <= 0)
+			break;
+		done += n;
+	}
+	bool ok = done == buffer.size() && ::fsync(fd) == 0;
+	ok = (::close(fd) == 0) && ok;
+	if (!ok || std::rename(tmp_filename.c_str(), filename) != 0)
+	{
+		std::remove(tmp_filename.c_str());
+		return WRITE_FAILED;
+	}
+	return OK;
+}
+
+int Shard::Read(const char* filename)
+{
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0)
+		return CANNOT_OPEN;
+
+	struct stat st;
+	std::vector<char> buffer;
+	bool ok = fstat(fd, &st) == 0;
+	if (ok)
+		buffer.resize(st.st_size);
+	size_t done = 0;
+	while (ok && done < buffer.size())
+	{
+		ssize_t n = ::read(fd, buffer.data() + done, buffer.size() - done);
+		ok = n > 0;
+		done += ok ? n : 0;
+	}
+	::close(fd);
+	if (!ok)
+		return CANNOT_OPEN;
+
+	Shard_Header header;
+	if (buffer.size() < sizeof(header))
+		return BAD_FORMAT;
+	std::memcpy(&header, buffer.data(), sizeof(header));
+	const size_t ROW = sizeof(uint32_t) + sizeof(int32_t) + 3*sizeof(double);
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.header_size != sizeof(header)
+		|| header.num_shards == 0 || header.shard >= header.num_shards
+		|| header.count > (buffer.size() - sizeof(header)) / ROW || buffer.size() != sizeof(header) + header.count*ROW)
+		return BAD_FORMAT;
+	if (Snapshot::Checksum(buffer.data() + sizeof(header), buffer.size() - sizeof(header)) != header.checksum)
+		return BAD_CHECKSUM;
+
+	Reset(header.shard, header.num_shards, header.source);
+	const char* in = buffer.data() + sizeof(header);
+	Extract(in, ids, header.count);
+	Extract(in, iterations, header.count);
+	Extract(in, rating, header.count);
+	Extract(in, rd, header.count);
+	Extract(in, vol, header.count);
+	return OK;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * The results of rating one shard of a Glicko-2 system, and the file they
+ * are exchanged in between a shard and the coordinator that merges them.
+ *
+ * Players are hash-partitioned by ID over the shards (Owner()). A shard
+ * rates the players it owns against the whole system, read-only, so the
+ * shards can run as separate processes from one broadcast snapshot (see
+ * Glicko2::Run_Shard() and Merge_Shards()). The result is the new rating,
+ * RD and volatility of each owned player, which is all the coordinator
+ * needs to finish the period.
+ *
+ * The file is a fixed header followed by the columns:
+ *
+ *     ids[n]                        uint32 player IDs, ascending
+ *     iterations[n]                 int32 volatility solver iterations
+ *     rating[n], rd[n], vol[n]      doubles, exactly as computed
+ *
+ * in the native byte order, with a checksum over the columns like a
+ * Snapshot's. The header also carries the checksum of the snapshot the
+ * shard was computed from (the source), so results from a stale snapshot
+ * can be told apart.
+ */
+class Shard
+{
+public:
+	static const uint32_t VERSION = 1;
+
+	// return codes of Read() and Write(), the same as Snapshot's
+	enum { OK = 0, CANNOT_OPEN = 1, BAD_FORMAT = 2, BAD_CHECKSUM = 3, WRITE_FAILED = 4 };
+
+	// the shard of `num_shards` that owns player `id`
+	static uint32_t Owner(uint32_t id, uint32_t num_shards)
+	{ return (uint64_t(id * 2654435769u) * num_shards) >> 32; }
+
+	void Reset(uint32_t shard, uint32_t num_shards, uint64_t source = 0);
+	void Reserve(size_t count);
+
+	// players must be added in ascending ID order
+	void Add(uint32_t id, double rating, double rd, double volatility, int iterations);
+
+	int Write(const char* filename) const;
+	int Read(const char* filename);
+
+	uint32_t Get_Shard() const
+	{ return shard; }
+
+	uint32_t Get_Num_Shards() const
+	{ return num_shards; }
+
+	uint64_t Get_Source() const
+	{ return source; }
+
+	void Set_Source(uint64_t source)
+	{ this->source = source; }
+
+	size_t Size() const
+	{ return ids.size(); }
+
+	uint32_t Get_ID(size_t i) const
+	{ return ids[i]; }
+
+	double Get_Rating(size_t i) const
+	{ return rating[i]; }
+
+	double Get_RD(size_t i) const
+	{ return rd[i]; }
+
+	double Get_Vol(size_t i) const
+	{ return vol[i]; }
+
+	int Get_Iterations(size_t i) const
+	{ return iterations[i]; }
+
+private:
+	uint32_t shard = 0;
+	uint32_t num_shards = 1;
+	uint64_t source = 0;
+	std::vector<uint32_t> ids;
+	std::vector<int32_t> iterations;
+	std::vector<double> rating;
+	std::vector<double> rd;
+	std::vector<double> vol;
+};
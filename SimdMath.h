@@ -0,0 +1,185 @@
+#pragma once
+// GCC 12 warns that the _mm512_undefined_pd() pass-through operands inside
+// the AVX-512 intrinsics are used uninitialized once they are inlined at -O2
+// (GCC bug 105593); the warning points into the header, so it's silenced there
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#include <cstdint>
+#include <cstring>
+
+/*
+ * exp() for a vector of doubles, after Cephes: x = n*ln2 + r with
+ * |r| <= ln2/2, exp(r) from a (2,3) Pade form, then scaled by 2^n. Inputs
+ * are clamped to the range where the result is a normal double. Accurate to
+ * about 1 ULP; shared by the SIMD kernels, which are compiled for their
+ * instruction set per function and picked at runtime.
+ *
+ * The float versions follow Cephes' expf: the same reduction, then a
+ * degree 5 polynomial for exp(r), accurate to about 2 ULPs.
+ *
+ * Exp_Approximate() trades accuracy for the division of the Pade form: the
+ * same reduction, then a degree 6 polynomial for exp(r) fitted at the
+ * Chebyshev nodes of [-ln2/2, ln2/2], within 3e-9 relative error. There is
+ * a scalar version, so that a vector kernel's tail gets the same function.
+ */
+__attribute__((target("avx2,fma")))
+inline __m256d Exp_AVX2(__m256d x)
+{
+	x = _mm256_min_pd(x, _mm256_set1_pd(709.0));
+	x = _mm256_max_pd(x, _mm256_set1_pd(-708.0));
+
+	__m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634074)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(6.93145751953125E-1), x);
+	r = _mm256_fnmadd_pd(n, _mm256_set1_pd(1.42860682030941723212E-6), r);
+
+	__m256d rr = _mm256_mul_pd(r, r);
+	__m256d p = _mm256_fmadd_pd(_mm256_set1_pd(1.26177193074810590878E-4), rr, _mm256_set1_pd(3.02994407707441961300E-2));
+	p = _mm256_fmadd_pd(p, rr, _mm256_set1_pd(9.99999999999999999910E-1));
+	p = _mm256_mul_pd(p, r);
+	__m256d q = _mm256_fmadd_pd(_mm256_set1_pd(3.00198505138664455042E-6), rr, _mm256_set1_pd(2.52448340349684104192E-3));
+	q = _mm256_fmadd_pd(q, rr, _mm256_set1_pd(2.27265548208155028766E-1));
+	q = _mm256_fmadd_pd(q, rr, _mm256_set1_pd(2.00000000000000000009E0));
+	__m256d e = _mm256_div_pd(p, _mm256_sub_pd(q, p));
+	e = _mm256_fmadd_pd(e, _mm256_set1_pd(2.0), _mm256_set1_pd(1.0));
+
+	__m128i ni = _mm256_cvtpd_epi32(n);
+	__m256i bits = _mm256_slli_epi64(_mm256_add_epi64(_mm256_cvtepi32_epi64(ni), _mm256_set1_epi64x(1023)), 52);
+	return _mm256_mul_pd(e, _mm256_castsi256_pd(bits));
+}
+
+__attribute__((target("avx512f")))
+inline __m512d Exp_AVX512(__m512d x)
+{
+	x = _mm512_min_pd(x, _mm512_set1_pd(709.0));
+	x = _mm512_max_pd(x, _mm512_set1_pd(-708.0));
+
+	__m512d n = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(1.4426950408889634074)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512d r = _mm512_fnmadd_pd(n, _mm512_set1_pd(6.93145751953125E-1), x);
+	r = _mm512_fnmadd_pd(n, _mm512_set1_pd(1.42860682030941723212E-6), r);
+
+	__m512d rr = _mm512_mul_pd(r, r);
+	__m512d p = _mm512_fmadd_pd(_mm512_set1_pd(1.26177193074810590878E-4), rr, _mm512_set1_pd(3.02994407707441961300E-2));
+	p = _mm512_fmadd_pd(p, rr, _mm512_set1_pd(9.99999999999999999910E-1));
+	p = _mm512_mul_pd(p, r);
+	__m512d q = _mm512_fmadd_pd(_mm512_set1_pd(3.00198505138664455042E-6), rr, _mm512_set1_pd(2.52448340349684104192E-3));
+	q = _mm512_fmadd_pd(q, rr, _mm512_set1_pd(2.27265548208155028766E-1));
+	q = _mm512_fmadd_pd(q, rr, _mm512_set1_pd(2.00000000000000000009E0));
+	__m512d e = _mm512_div_pd(p, _mm512_sub_pd(q, p));
+	e = _mm512_fmadd_pd(e, _mm512_set1_pd(2.0), _mm512_set1_pd(1.0));
+
+	return _mm512_scalef_pd(e, n);
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 Exp_AVX2(__m256 x)
+{
+	x = _mm256_min_ps(x, _mm256_set1_ps(88.0f));
+	x = _mm256_max_ps(x, _mm256_set1_ps(-87.0f));
+
+	__m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+	r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
+
+	__m256 p = _mm256_fmadd_ps(_mm256_set1_ps(1.9875691500E-4f), r, _mm256_set1_ps(1.3981999507E-3f));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073E-3f));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894E-2f));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459E-1f));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201E-1f));
+	__m256 e = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+
+	__m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+	return _mm256_mul_ps(e, _mm256_castsi256_ps(bits));
+}
+
+__attribute__((target("avx512f")))
+inline __m512 Exp_AVX512(__m512 x)
+{
+	x = _mm512_min_ps(x, _mm512_set1_ps(88.0f));
+	x = _mm512_max_ps(x, _mm512_set1_ps(-87.0f));
+
+	__m512 n = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(1.44269504088896341f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(0.693359375f), x);
+	r = _mm512_fnmadd_ps(n, _mm512_set1_ps(-2.12194440e-4f), r);
+
+	__m512 p = _mm512_fmadd_ps(_mm512_set1_ps(1.9875691500E-4f), r, _mm512_set1_ps(1.3981999507E-3f));
+	p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(8.3334519073E-3f));
+	p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(4.1665795894E-2f));
+	p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(1.6666665459E-1f));
+	p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(5.0000001201E-1f));
+	__m512 e = _mm512_fmadd_ps(p, _mm512_mul_ps(r, r), _mm512_add_ps(r, _mm512_set1_ps(1.0f)));
+
+	return _mm512_scalef_ps(e, n);
+}
+
+// exp(r) = sum of EXP_APPROXIMATE[k] * r^k
+const double EXP_APPROXIMATE[7] = {
+	1.0, 1.0000000377162135, 0.5000000047117784, 0.16666415514653618,
+	0.04166635289669687, 0.008375126398132253, 0.0013941108438804987
+};
+
+inline double Exp_Approximate(double x)
+{
+	const double* C = EXP_APPROXIMATE;
+	x = x < 709.0 ? x : 709.0;
+	x = x > -708.0 ? x : -708.0;
+
+	// rounded to the nearest integer by adding and taking away 1.5 * 2^52
+	const double round = 6755399441055744.0;
+	double n = (x * 1.4426950408889634074 + round) - round;
+	double r = x - n * 6.93145751953125E-1;
+	r = r - n * 1.42860682030941723212E-6;
+
+	double p = ((((((C[6]*r + C[5])*r + C[4])*r + C[3])*r + C[2])*r + C[1])*r + C[0]);
+
+	uint64_t bits = uint64_t(int64_t(n) + 1023) << 52;
+	double scale;
+	std::memcpy(&scale, &bits, sizeof(scale));
+	return p * scale;
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256d Exp_Approximate_AVX2(__m256d x)
+{
+	const double* C = EXP_APPROXIMATE;
+	x = _mm256_min_pd(x, _mm256_set1_pd(709.0));
+	x = _mm256_max_pd(x, _mm256_set1_pd(-708.0));
+
+	__m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634074)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(6.93145751953125E-1), x);
+	r = _mm256_fnmadd_pd(n, _mm256_set1_pd(1.42860682030941723212E-6), r);
+
+	__m256d p = _mm256_fmadd_pd(_mm256_set1_pd(C[6]), r, _mm256_set1_pd(C[5]));
+	p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(C[4]));
+	p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(C[3]));
+	p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(C[2]));
+	p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(C[1]));
+	p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(C[0]));
+
+	__m128i ni = _mm256_cvtpd_epi32(n);
+	__m256i bits = _mm256_slli_epi64(_mm256_add_epi64(_mm256_cvtepi32_epi64(ni), _mm256_set1_epi64x(1023)), 52);
+	return _mm256_mul_pd(p, _mm256_castsi256_pd(bits));
+}
+
+__attribute__((target("avx512f")))
+inline __m512d Exp_Approximate_AVX512(__m512d x)
+{
+	const double* C = EXP_APPROXIMATE;
+	x = _mm512_min_pd(x, _mm512_set1_pd(709.0));
+	x = _mm512_max_pd(x, _mm512_set1_pd(-708.0));
+
+	__m512d n = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(1.4426950408889634074)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512d r = _mm512_fnmadd_pd(n, _mm512_set1_pd(6.93145751953125E-1), x);
+	r = _mm512_fnmadd_pd(n, _mm512_set1_pd(1.42860682030941723212E-6), r);
+
+	__m512d p = _mm512_fmadd_pd(_mm512_set1_pd(C[6]), r, _mm512_set1_pd(C[5]));
+	p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(C[4]));
+	p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(C[3]));
+	p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(C[2]));
+	p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(C[1]));
+	p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(C[0]));
+
+	return _mm512_scalef_pd(p, n);
+}
@@ -0,0 +1,342 @@
+#include "Snapshot.h"
+#include "Glicko2.h"
+#include "Stats.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	const char MAGIC[8] = { 'G', 'L', 'I', 'C', 'K', 'O', '2', 'S' };
+
+	uint64_t Align(uint64_t offset)
+	{ return (offset + 7) & ~uint64_t{7}; }
+
+	// whether `count` items of `item_size` bytes fit at `offset`, past the
+	// header and aligned, without the size overflowing
+	bool Fits(uint64_t offset, uint64_t count, uint64_t item_size, uint64_t length)
+	{
+		return offset >= sizeof(Snapshot_Header) && offset <= length && offset % std::min<uint64_t>(item_size, 8) == 0
+			&& count <= (length - offset) / item_size;
+	}
+
+	// makes a rename into the directory holding `filename` durable
+	bool Sync_Directory(const char* filename)
+	{
+		std::string directory { filename };
+		size_t slash = directory.rfind('/');
+		directory = slash == std::string::npos ? "." : slash == 0 ? "/" : directory.substr(0, slash);
+		int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+		if (fd < 0)
+			return false;
+		bool ok = ::fsync(fd) == 0;
+		return (::close(fd) == 0) && ok;
+	}
+
+	// buffers writes to a file descriptor and checksums everything it writes
+	class Section_Writer
+	{
+	public:
+		explicit Section_Writer(int fd) :
+			fd{ fd },
+			offset{ sizeof(Snapshot_Header) }
+		{ buffer.reserve(1 << 20); }
+
+		void Write(const void* bytes, size_t count)
+		{
+			const char* p = static_cast<const char*>(bytes);
+			while (count > 0)
+			{
+				size_t chunk = std::min(count, buffer.capacity() - buffer.size());
+				buffer.insert(buffer.end(), p, p + chunk);
+				p += chunk; count -= chunk; offset += chunk;
+				if (buffer.size() == buffer.capacity())
+					Flush();
+			}
+		}
+
+		void Pad()
+		{
+			static const char zeros[8] = {};
+			Write(zeros, Align(offset) - offset);
+		}
+
+		bool Flush()
+		{
+			checksum = Snapshot::Checksum(buffer.data(), buffer.size(), checksum);
+			size_t done = 0;
+			while (done < buffer.size())
+			{
+				ssize_t n = ::write(fd, buffer.data() + done, buffer.size() - done);
+				if (n <= 0)
+				{ failed = true; break; }
+				done += n;
+			}
+			buffer.clear();
+			return !failed;
+		}
+
+		int fd;
+		uint64_t offset;
+		uint64_t checksum = 14695981039346656037ULL;
+		bool failed = false;
+		std::vector<char> buffer;
+	};
+}
+
+Snapshot::~Snapshot()
+{
+	Close();
+}
+
+void Snapshot::Close()
+{
+	if (data)
+		munmap(const_cast<unsigned char*>(data), size);
+	data = nullptr;
+	header = nullptr;
+	size = 0;
+}
+
+uint64_t Snapshot::Checksum(const void* bytes, size_t count, uint64_t seed)
+{
+	// FNV-1a over 64-bit words, byte-wise for a trailing partial word
+	const unsigned char* p = static_cast<const unsigned char*>(bytes);
+	uint64_t h = seed;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		uint64_t word;
+		std::memcpy(&word, p + i, 8);
+		h = (h ^ word) * 1099511628211ULL;
+	}
+	for (; i < count; i++)
+		h = (h ^ p[i]) * 1099511628211ULL;
+	return h;
+}
+
+int Snapshot::Open(const char* filename, bool verify)
+{
+	Stats::Timer timer { Stats::SNAPSHOT_LOAD };
+	Close();
+
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0)
+		return CANNOT_OPEN;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		::close(fd);
+		return CANNOT_OPEN;
+	}
+	if (static_cast<size_t>(st.st_size) < sizeof(Snapshot_Header))
+	{
+		::close(fd);
+		return BAD_FORMAT;
+	}
+
+	size_t length = st.st_size;
+	void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED)
+		return CANNOT_OPEN;
+
+	data = static_cast<const unsigned char*>(mapped);
+	size = length;
+	header = reinterpret_cast<const Snapshot_Header*>(data);
+
+	uint64_t n = header->num_players, m = header->num_matches;
+	bool valid = std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0
+		&& header->version == VERSION
+		&& header->header_size == sizeof(Snapshot_Header)
+		&& header->file_size == length
+		&& header->scoring <= Glicko2::HALF_POINTS
+		&& header->matches_rated <= 1
+		&& header->period <= UINT32_MAX
+		&& n < UINT32_MAX && m <= UINT32_MAX
+		&& Fits(header->rating_offset, n, sizeof(double), length)
+		&& Fits(header->rd_offset, n, sizeof(double), length)
+		&& Fits(header->vol_offset, n, sizeof(double), length)
+		&& Fits(header->rated_period_offset, n, sizeof(uint32_t), length)
+		&& Fits(header->member_offset, n, 1, length)
+		&& Fits(header->name_offsets_offset, n+1, sizeof(uint64_t), length)
+		&& Fits(header->strings_offset, header->strings_size, 1, length)
+		&& Fits(header->match_offsets_offset, n+1, sizeof(uint32_t), length)
+		&& Fits(header->opponents_offset, m, sizeof(uint32_t), length)
+		&& Fits(header->scores_offset, m, sizeof(int32_t), length);
+	if (!valid || !Check_Indexes())
+	{
+		Close();
+		return BAD_FORMAT;
+	}
+
+	if (verify && Checksum(data + sizeof(Snapshot_Header), length - sizeof(Snapshot_Header)) != header->checksum)
+	{
+		Close();
+		return BAD_CHECKSUM;
+	}
+
+	madvise(mapped, length, MADV_WILLNEED);
+	return OK;
+}
+
+bool Snapshot::Check_Indexes() const
+{
+	// every name ends in its own NUL inside the string table
+	uint64_t n = header->num_players, m = header->num_matches;
+	const uint64_t* name_offsets = Section<uint64_t>(header->name_offsets_offset);
+	const char* strings = Section<char>(header->strings_offset);
+	if (name_offsets[0] != 0 || name_offsets[n] > header->strings_size)
+		return false;
+	for (uint64_t id = 0; id < n; id++)
+		if (name_offsets[id+1] <= name_offsets[id] || name_offsets[id+1] > name_offsets[n] || strings[name_offsets[id+1] - 1] != '\0')
+			return false;
+
+	// no stored RD is current as of a period still to come
+	const uint32_t* rated_periods = Rated_Periods();
+	for (uint64_t id = 0; id < n; id++)
+		if (rated_periods[id] > header->period)
+			return false;
+
+	// the match ranges cover the match columns in order, and every opponent
+	// is a player
+	const uint32_t* match_offsets = Match_Offsets();
+	if (match_offsets[0] != 0 || match_offsets[n] != m)
+		return false;
+	for (uint64_t id = 0; id < n; id++)
+		if (match_offsets[id+1] < match_offsets[id])
+			return false;
+	const uint32_t* opponents = Opponents();
+	for (uint64_t i = 0; i < m; i++)
+		if (opponents[i] >= n)
+			return false;
+	return true;
+}
+
+int Snapshot::Write(const char* filename, const Glicko2& system, uint64_t log_sequence)
+{
+	Stats::Timer timer { Stats::SNAPSHOT_WRITE };
+	const RatingStore& store = system.Get_Store();
+	const MatchTable& matches = system.Get_Matches();
+	uint64_t n = store.Size(), m = matches.Size();
+
+	// write next to the target and rename over it, so readers never see a
+	// partially written snapshot
+	std::string tmp_filename { filename };
+	tmp_filename += ".tmp";
+	int fd = ::open(tmp_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return CANNOT_OPEN;
+
+	Snapshot_Header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.header_size = sizeof(Snapshot_Header);
+	header.num_players = n;
+	header.num_matches = m;
+	header.tau = system.Get_Tau();
+	header.scoring = system.Get_Scoring();
+	header.matches_rated = system.Has_Rated_Matches();
+	header.period = system.Get_Period();
+	header.log_sequence = log_sequence;
+
+	Section_Writer out { fd };
+	if (::lseek(fd, sizeof(Snapshot_Header), SEEK_SET) < 0)
+		out.failed = true;
+
+	header.rating_offset = out.offset;
+	out.Write(store.Ratings(), n*sizeof(double));
+	// RDs are written as stored, with the period each is current as of, so
+	// the inflation still pending for idle players stays deferred
+	header.rd_offset = out.offset;
+	out.Write(store.RDs(), n*sizeof(double));
+	header.vol_offset = out.offset;
+	out.Write(store.Vols(), n*sizeof(double));
+	header.rated_period_offset = out.offset;
+	for (uint32_t id = 0; id < n; id++)
+	{
+		uint32_t rated = system.Get_Rated_Period(id);
+		out.Write(&rated, sizeof(rated));
+	}
+	out.Pad();
+
+	header.member_offset = out.offset;
+	for (uint32_t id = 0; id < n; id++)
+	{
+		uint8_t flags = (store.Is_Member(id) ? MEMBER : 0) | (system.Is_Active(id) ? ACTIVE : 0);
+		out.Write(&flags, 1);
+	}
+	out.Pad();
+
+	header.name_offsets_offset = out.offset;
+	uint64_t name_offset = 0;
+	for (uint32_t id = 0; id < n; id++)
+	{
+		out.Write(&name_offset, sizeof(name_offset));
+		name_offset += store.Get_Name(id).size() + 1;
+	}
+	out.Write(&name_offset, sizeof(name_offset));
+
+	header.strings_offset = out.offset;
+	header.strings_size = name_offset;
+	for (uint32_t id = 0; id < n; id++)
+		out.Write(store.Get_Name(id).c_str(), store.Get_Name(id).size() + 1);
+	out.Pad();
+
+	// the matches are indexed as runs of repeated games; the file keeps one
+	// entry per game
+	uint64_t runs = matches.Begin(n);
+	header.match_offsets_offset = out.offset;
+	uint32_t begin = 0;
+	for (uint32_t id = 0; id < n; id++)
+	{
+		out.Write(&begin, sizeof(begin));
+		for (uint32_t i = matches.Begin(id); i < matches.End(id); i++)
+			begin += matches.Get_Games(i);
+	}
+	out.Write(&begin, sizeof(begin));
+	out.Pad();
+
+	header.opponents_offset = out.offset;
+	for (uint64_t i = 0; i < runs; i++)
+	{
+		uint32_t opponent = matches.Get_Opponent(i);
+		for (uint32_t k = 0; k < matches.Get_Games(i); k++)
+			out.Write(&opponent, sizeof(opponent));
+	}
+	out.Pad();
+	header.scores_offset = out.offset;
+	for (uint64_t i = 0; i < runs; i++)
+	{
+		int32_t score = matches.Get_Score(i);
+		for (uint32_t k = 0; k < matches.Get_Games(i); k++)
+			out.Write(&score, sizeof(score));
+	}
+	out.Pad();
+
+	out.Flush();
+	header.file_size = out.offset;
+	header.checksum = out.checksum;
+
+	bool ok = !out.failed
+		&& ::pwrite(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header))
+		&& ::fsync(fd) == 0;
+	ok = (::close(fd) == 0) && ok;
+	if (!ok || std::rename(tmp_filename.c_str(), filename) != 0)
+	{
+		std::remove(tmp_filename.c_str());
+		return WRITE_FAILED;
+	}
+	// the rename itself must reach the disk before a checkpoint's log is
+	// emptied, or a crash could bring back the old snapshot without it
+	return Sync_Directory(filename) ? OK : WRITE_FAILED;
+}
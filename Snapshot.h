@@ -0,0 +1,167 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+class Glicko2;
+
+/*
+ * Versioned binary snapshot of a Glicko-2 system, laid out so that it can be
+ * mmap'd and read in place.
+ *
+ * A snapshot file is a fixed header followed by 8-byte aligned sections:
+ *
+ *     rating[n], rd[n], vol[n]      double columns indexed by player ID
+ *     rated_period[n]               uint32: the period each stored RD is
+ *                                   current as of
+ *     flags[n]                      uint8: bit 0 for rated players (not just
+ *                                   opponents), bit 1 for players with
+ *                                   matches still to be rated
+ *     name_offsets[n+1]             uint64 offsets into the string table
+ *     strings                       NUL-terminated names, back to back
+ *     match_offsets[n+1]            uint32 CSR offsets into the match columns
+ *     opponents[m], scores[m]       uint32 opponent IDs and int32 scores
+ *
+ * RDs are stored as the system holds them, each current as of its rated
+ * period, and the header keeps the period clock, so a loaded system goes
+ * on deferring the inflation its idle players still owe.
+ *
+ * Everything is stored in the native (little-endian) byte order. The header
+ * records the offset of each section and a checksum over all bytes after
+ * the header, which Open() verifies unless asked not to. The structure is
+ * checked on every Open() regardless: each section must lie within the
+ * file, names must be NUL-terminated in the string table, the match offsets
+ * must rise from 0 to the match count, every opponent must be a player, and
+ * no rated period may lie past the period clock. That reads the offset,
+ * rated period and opponent columns once, but not the values. A snapshot
+ * taken as a checkpoint of a MatchLog also records the sequence number of
+ * the first log record it doesn't cover.
+ *
+ * The mapping is read in place only through the accessors below. Loading
+ * it into a Glicko2 is not zero-copy: Glicko2::Load() copies the value
+ * columns in bulk, builds a std::string for each name and rebuilds the
+ * match runs, since the system needs its columns writable and its names
+ * as strings. That costs about 140 ns a player (0.28 s for 2M players with
+ * 4M matches), still with no parsing and one file, against the CSV
+ * loader's file per player.
+ */
+struct Snapshot_Header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint64_t num_players;
+	uint64_t num_matches;
+	double tau;
+	uint64_t scoring;		// Glicko2::Scoring
+	uint64_t matches_rated;	// 1 if a Run() rated the matches (see Glicko2::Close_Period())
+	uint64_t period;		// Glicko2::Get_Period()
+	uint64_t rating_offset;
+	uint64_t rd_offset;
+	uint64_t vol_offset;
+	uint64_t rated_period_offset;
+	uint64_t member_offset;
+	uint64_t name_offsets_offset;
+	uint64_t strings_offset;
+	uint64_t strings_size;
+	uint64_t match_offsets_offset;
+	uint64_t opponents_offset;
+	uint64_t scores_offset;
+	uint64_t log_sequence;
+	uint64_t file_size;
+	uint64_t checksum;
+};
+
+class Snapshot
+{
+public:
+	static const uint32_t VERSION = 5;
+
+	// bits of the per-player flags
+	enum { MEMBER = 1, ACTIVE = 2 };
+
+	// return codes of Open() and Write()
+	enum { OK = 0, CANNOT_OPEN = 1, BAD_FORMAT = 2, BAD_CHECKSUM = 3, WRITE_FAILED = 4 };
+
+	Snapshot() = default;
+	~Snapshot();
+
+	Snapshot(const Snapshot&) = delete;
+	Snapshot& operator=(const Snapshot&) = delete;
+
+	int Open(const char* filename, bool verify = true);
+	void Close();
+
+	// writes to a temporary file, syncs it, renames it over `filename` and
+	// syncs the directory, so the new snapshot is durable once this returns
+	static int Write(const char* filename, const Glicko2& system, uint64_t log_sequence = 0);
+
+	bool Is_Open() const
+	{ return data != nullptr; }
+
+	size_t Size() const
+	{ return header->num_players; }
+
+	size_t Num_Matches() const
+	{ return header->num_matches; }
+
+	double Get_Tau() const
+	{ return header->tau; }
+
+	int Get_Scoring() const
+	{ return static_cast<int>(header->scoring); }
+
+	bool Matches_Rated() const
+	{ return header->matches_rated != 0; }
+
+	uint32_t Get_Period() const
+	{ return static_cast<uint32_t>(header->period); }
+
+	uint64_t Get_Log_Sequence() const
+	{ return header->log_sequence; }
+
+	uint64_t Get_Checksum() const
+	{ return header->checksum; }
+
+	const double* Ratings() const
+	{ return Section<double>(header->rating_offset); }
+
+	const double* RDs() const
+	{ return Section<double>(header->rd_offset); }
+
+	const double* Vols() const
+	{ return Section<double>(header->vol_offset); }
+
+	const uint32_t* Rated_Periods() const
+	{ return Section<uint32_t>(header->rated_period_offset); }
+
+	bool Is_Member(uint32_t id) const
+	{ return (Section<uint8_t>(header->member_offset)[id] & MEMBER) != 0; }
+
+	bool Is_Active(uint32_t id) const
+	{ return (Section<uint8_t>(header->member_offset)[id] & ACTIVE) != 0; }
+
+	const char* Get_Name(uint32_t id) const
+	{ return Section<char>(header->strings_offset) + Section<uint64_t>(header->name_offsets_offset)[id]; }
+
+	const uint32_t* Match_Offsets() const
+	{ return Section<uint32_t>(header->match_offsets_offset); }
+
+	const uint32_t* Opponents() const
+	{ return Section<uint32_t>(header->opponents_offset); }
+
+	const int32_t* Scores() const
+	{ return Section<int32_t>(header->scores_offset); }
+
+	static uint64_t Checksum(const void* data, size_t size, uint64_t seed = 14695981039346656037ULL);
+
+private:
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+	const Snapshot_Header* header = nullptr;
+
+	bool Check_Indexes() const;
+
+	template<typename T>
+	const T* Section(uint64_t offset) const
+	{ return reinterpret_cast<const T*>(data + offset); }
+};
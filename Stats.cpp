@@ -0,0 +1,181 @@
+#include "Stats.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+namespace
+{
+	const char* const PHASE_NAMES[Stats::NUM_PHASES] = {
+		"csv_load", "snapshot_load", "snapshot_write", "index_matches",
+		"rate_opponents", "rate_volatility", "rate_update", "ranking", "log_commit"
+	};
+
+	const char* const COUNTER_NAMES[Stats::NUM_COUNTERS] = {
+		"periods", "players_rated", "matches_read", "players_added", "matches_added",
+		"name_lookups", "allocations", "allocated_bytes"
+	};
+
+	void Append(std::string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+	void Append(std::string& out, const char* format, ...)
+	{
+		char line[256];
+		va_list args;
+		va_start(args, format);
+		int n = std::vsnprintf(line, sizeof(line), format, args);
+		va_end(args);
+		if (n > 0)
+			out.append(line, std::min<size_t>(n, sizeof(line) - 1));
+	}
+}
+
+#ifdef GLICKO2_STATS
+std::atomic<uint64_t> Stats::counters[NUM_COUNTERS];
+std::atomic<uint64_t> Stats::phase_ns[NUM_PHASES];
+std::atomic<uint64_t> Stats::phase_calls[NUM_PHASES];
+std::atomic<uint64_t> Stats::iterations[MAX_ITERATIONS + 1];
+std::atomic<uint64_t> Stats::iteration_sum;
+
+// out of line, so GCC doesn't see malloc/free inlined against the builtin
+// operator new and warn of a mismatch
+__attribute__((noinline))
+void* operator new (size_t size)
+{
+	Stats::Count(Stats::ALLOCATIONS);
+	Stats::Count(Stats::ALLOCATED_BYTES, size);
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc{};
+}
+
+__attribute__((noinline))
+void operator delete (void* p) noexcept
+{ std::free(p); }
+
+__attribute__((noinline))
+void operator delete (void* p, size_t) noexcept
+{ std::free(p); }
+
+void Stats::Record_Iterations(const int* iterations, size_t n)
+{
+	// tallied locally first, so a block of players costs one atomic add per
+	// bucket it touches
+	uint64_t buckets[MAX_ITERATIONS + 1] = {};
+	uint64_t sum = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		++buckets[iterations[i] < MAX_ITERATIONS ? iterations[i] : MAX_ITERATIONS];
+		sum += iterations[i];
+	}
+	for (int b = 0; b <= MAX_ITERATIONS; b++)
+		if (buckets[b] != 0)
+			Stats::iterations[b].fetch_add(buckets[b], std::memory_order_relaxed);
+	iteration_sum.fetch_add(sum, std::memory_order_relaxed);
+}
+
+uint64_t Stats::Get_Count(Counter counter)
+{ return counters[counter].load(std::memory_order_relaxed); }
+
+double Stats::Get_Seconds(Phase phase)
+{ return phase_ns[phase].load(std::memory_order_relaxed) * 1e-9; }
+
+uint64_t Stats::Get_Calls(Phase phase)
+{ return phase_calls[phase].load(std::memory_order_relaxed); }
+
+uint64_t Stats::Get_Iterations(int bucket)
+{ return iterations[bucket].load(std::memory_order_relaxed); }
+
+uint64_t Stats::Get_Iteration_Sum()
+{ return iteration_sum.load(std::memory_order_relaxed); }
+
+void Stats::Reset()
+{
+	for (auto& counter : counters)
+		counter.store(0, std::memory_order_relaxed);
+	for (int p = 0; p < NUM_PHASES; p++)
+	{
+		phase_ns[p].store(0, std::memory_order_relaxed);
+		phase_calls[p].store(0, std::memory_order_relaxed);
+	}
+	for (auto& bucket : iterations)
+		bucket.store(0, std::memory_order_relaxed);
+	iteration_sum.store(0, std::memory_order_relaxed);
+}
+#else
+uint64_t Stats::Get_Count(Counter)
+{ return 0; }
+
+double Stats::Get_Seconds(Phase)
+{ return 0; }
+
+uint64_t Stats::Get_Calls(Phase)
+{ return 0; }
+
+uint64_t Stats::Get_Iterations(int)
+{ return 0; }
+
+uint64_t Stats::Get_Iteration_Sum()
+{ return 0; }
+
+void Stats::Reset()
+{}
+#endif
+
+const char* Stats::Get_Name(Phase phase)
+{ return PHASE_NAMES[phase]; }
+
+const char* Stats::Get_Name(Counter counter)
+{ return COUNTER_NAMES[counter]; }
+
+std::string Stats::To_JSON()
+{
+	std::string out;
+	Append(out, "{\n  \"enabled\": %s,\n  \"phases\": {\n", Enabled() ? "true" : "false");
+	for (int p = 0; p < NUM_PHASES; p++)
+		Append(out, "    \"%s\": { \"seconds\": %.9f, \"calls\": %llu }%s\n", PHASE_NAMES[p], Get_Seconds(Phase(p)),
+			static_cast<unsigned long long>(Get_Calls(Phase(p))), p+1 < NUM_PHASES ? "," : "");
+	out += "  },\n  \"counters\": {\n";
+	for (int c = 0; c < NUM_COUNTERS; c++)
+		Append(out, "    \"%s\": %llu%s\n", COUNTER_NAMES[c], static_cast<unsigned long long>(Get_Count(Counter(c))), c+1 < NUM_COUNTERS ? "," : "");
+	out += "  },\n  \"volatility_iterations\": [";
+	for (int b = 0; b <= MAX_ITERATIONS; b++)
+		Append(out, "%s%llu", b ? ", " : "", static_cast<unsigned long long>(Get_Iterations(b)));
+	Append(out, "],\n  \"volatility_iteration_sum\": %llu\n}\n", static_cast<unsigned long long>(Get_Iteration_Sum()));
+	return out;
+}
+
+std::string Stats::To_Prometheus()
+{
+	std::string out;
+	out += "# HELP glicko2_phase_seconds_total Time spent per phase, summed over threads.\n";
+	out += "# TYPE glicko2_phase_seconds_total counter\n";
+	for (int p = 0; p < NUM_PHASES; p++)
+		Append(out, "glicko2_phase_seconds_total{phase=\"%s\"} %.9f\n", PHASE_NAMES[p], Get_Seconds(Phase(p)));
+	out += "# HELP glicko2_phase_calls_total Times each phase was entered.\n";
+	out += "# TYPE glicko2_phase_calls_total counter\n";
+	for (int p = 0; p < NUM_PHASES; p++)
+		Append(out, "glicko2_phase_calls_total{phase=\"%s\"} %llu\n", PHASE_NAMES[p], static_cast<unsigned long long>(Get_Calls(Phase(p))));
+
+	for (int c = 0; c < NUM_COUNTERS; c++)
+	{
+		Append(out, "# TYPE glicko2_%s_total counter\n", COUNTER_NAMES[c]);
+		Append(out, "glicko2_%s_total %llu\n", COUNTER_NAMES[c], static_cast<unsigned long long>(Get_Count(Counter(c))));
+	}
+
+	out += "# HELP glicko2_volatility_iterations Volatility solver iterations per rated player.\n";
+	out += "# TYPE glicko2_volatility_iterations histogram\n";
+	uint64_t total = 0;
+	for (int b = 0; b < MAX_ITERATIONS; b++)
+	{
+		total += Get_Iterations(b);
+		Append(out, "glicko2_volatility_iterations_bucket{le=\"%d\"} %llu\n", b, static_cast<unsigned long long>(total));
+	}
+	total += Get_Iterations(MAX_ITERATIONS);
+	Append(out, "glicko2_volatility_iterations_bucket{le=\"+Inf\"} %llu\n", static_cast<unsigned long long>(total));
+	Append(out, "glicko2_volatility_iterations_sum %llu\n", static_cast<unsigned long long>(Get_Iteration_Sum()));
+	Append(out, "glicko2_volatility_iterations_count %llu\n", static_cast<unsigned long long>(total));
+	return out;
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#ifdef GLICKO2_STATS
+#include <atomic>
+#include <chrono>
+#endif
+
+/*
+ * Process-wide instrumentation of the engine: time spent per phase, counts
+ * of the work done, and a histogram of the volatility solver's iteration
+ * counts per player.
+ *
+ * It is only compiled in with GLICKO2_STATS defined (`make STATS=1`).
+ * Otherwise every hook is an empty inline function and Timer an empty
+ * object, so instrumented code compiles to what it was without them, and
+ * the getters return 0. Phase times are summed over the threads that ran
+ * the phase, so the rating phases of a parallel Run() can add up to more
+ * than its wall time. Allocations are counted by replacing the global
+ * operator new.
+ *
+ * To_JSON() and To_Prometheus() render everything recorded since the last
+ * Reset().
+ */
+class Stats
+{
+public:
+	enum Phase
+	{
+		CSV_LOAD, SNAPSHOT_LOAD, SNAPSHOT_WRITE, INDEX_MATCHES,
+		RATE_OPPONENTS, RATE_VOLATILITY, RATE_UPDATE, RANKING, LOG_COMMIT,
+		NUM_PHASES
+	};
+
+	enum Counter
+	{
+		PERIODS, PLAYERS_RATED, MATCHES_READ, PLAYERS_ADDED, MATCHES_ADDED,
+		NAME_LOOKUPS, ALLOCATIONS, ALLOCATED_BYTES,
+		NUM_COUNTERS
+	};
+
+	// the histogram has a bucket per iteration count below this, and one
+	// for the rest
+	static const int MAX_ITERATIONS = 32;
+
+#ifdef GLICKO2_STATS
+	static constexpr bool Enabled()
+	{ return true; }
+
+	static void Count(Counter counter, uint64_t n = 1)
+	{ counters[counter].fetch_add(n, std::memory_order_relaxed); }
+
+	static void Add_Time(Phase phase, uint64_t ns)
+	{
+		phase_ns[phase].fetch_add(ns, std::memory_order_relaxed);
+		phase_calls[phase].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static void Record_Iterations(const int* iterations, size_t n);
+
+	// times its own lifetime into a phase, or up to Stop()
+	class Timer
+	{
+	public:
+		explicit Timer(Phase phase) :
+			phase{ phase },
+			start{ std::chrono::steady_clock::now() }
+		{}
+
+		~Timer()
+		{ Stop(); }
+
+		Timer(const Timer&) = delete;
+		Timer& operator=(const Timer&) = delete;
+
+		void Stop()
+		{
+			if (running)
+				Add_Time(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+			running = false;
+		}
+
+	private:
+		Phase phase;
+		bool running = true;
+		std::chrono::steady_clock::time_point start;
+	};
+#else
+	static constexpr bool Enabled()
+	{ return false; }
+
+	static void Count(Counter, uint64_t = 1)
+	{}
+
+	static void Add_Time(Phase, uint64_t)
+	{}
+
+	static void Record_Iterations(const int*, size_t)
+	{}
+
+	class Timer
+	{
+	public:
+		explicit Timer(Phase)
+		{}
+
+		void Stop()
+		{}
+	};
+#endif
+
+	static uint64_t Get_Count(Counter counter);
+	static double Get_Seconds(Phase phase);
+	static uint64_t Get_Calls(Phase phase);
+	static uint64_t Get_Iterations(int bucket);
+	static uint64_t Get_Iteration_Sum();
+
+	static const char* Get_Name(Phase phase);
+	static const char* Get_Name(Counter counter);
+
+	static void Reset();
+
+	static std::string To_JSON();
+	static std::string To_Prometheus();
+
+private:
+#ifdef GLICKO2_STATS
+	static std::atomic<uint64_t> counters[NUM_COUNTERS];
+	static std::atomic<uint64_t> phase_ns[NUM_PHASES];
+	static std::atomic<uint64_t> phase_calls[NUM_PHASES];
+	static std::atomic<uint64_t> iterations[MAX_ITERATIONS + 1];
+	static std::atomic<uint64_t> iteration_sum;
+#endif
+};
@@ -0,0 +1,74 @@
+#include "SyntheticLeague.h"
+#include "Glicko2.h"
+#include <algorithm>
+#include <cmath>
+
+SyntheticLeague::SyntheticLeague(const SyntheticLeague_Config& config) :
+	config{ config },
+	state{ config.seed }
+{
+	uint32_t n = std::max<uint32_t>(config.players, 2);
+	names.reserve(n);
+	skill.reserve(n);
+	activity.reserve(n);
+
+	double total = 0;
+	for (uint32_t k = 0; k < n; k++)
+	{
+		names.push_back("P" + std::to_string(k));
+		skill.push_back(config.skill_mean + config.skill_sd * Normal());
+		total += std::pow(k + 1.0, -config.activity_exponent);
+		activity.push_back(total);
+	}
+}
+
+void SyntheticLeague::Populate(Glicko2& system) const
+{
+	for (const std::string& name : names)
+		system.Add_Player(Player{ name });
+}
+
+void SyntheticLeague::Play_Period(Glicko2& system)
+{
+	for (uint32_t game = 0; game < config.games_per_period; game++)
+	{
+		uint32_t a = Pick(), b = Pick();
+		while (b == a)
+			b = Pick();
+
+		double expected = 1 / (1 + std::pow(10, (skill[b] - skill[a]) / 400));
+		int win = system.Get_Max_Score();
+		int score = Uniform() < expected ? win : 0;
+		system.Add_Match(a, b, score);
+		system.Add_Match(b, a, win - score);
+	}
+}
+
+uint64_t SyntheticLeague::Next()
+{
+	// splitmix64
+	uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+double SyntheticLeague::Uniform()
+{
+	// 53 random bits in [0, 1)
+	return (Next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double SyntheticLeague::Normal()
+{
+	// Box-Muller; 1 - u keeps the logarithm finite
+	double u = 1 - Uniform(), v = Uniform();
+	return std::sqrt(-2 * std::log(u)) * std::cos(2 * M_PI * v);
+}
+
+uint32_t SyntheticLeague::Pick()
+{
+	double x = Uniform() * activity.back();
+	size_t k = std::upper_bound(activity.begin(), activity.end(), x) - activity.begin();
+	return std::min(k, activity.size() - 1);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Glicko2;
+
+struct SyntheticLeague_Config
+{
+	uint32_t players = 10000;
+	uint32_t games_per_period = 50000;
+
+	// true skills are drawn from a normal distribution on the rating scale
+	double skill_mean = 1500;
+	double skill_sd = 300;
+
+	// player k (0-based, in order of activity) is picked for a game with
+	// weight (k+1)^-activity_exponent; 0 makes everyone equally active
+	double activity_exponent = 1.0;
+
+	uint64_t seed = 1;
+};
+
+/*
+ * Deterministic generator of leagues for benchmarking the rating engine.
+ *
+ * Every player gets a hidden true skill; each game pairs two distinct
+ * players drawn by activity and is won according to the Elo expectation of
+ * their true skills. Both sides of a game are recorded. The random numbers
+ * come from a fixed splitmix64 stream rather than the <random>
+ * distributions, so a seed produces the same league with every compiler
+ * and standard library.
+ */
+class SyntheticLeague
+{
+public:
+	explicit SyntheticLeague(const SyntheticLeague_Config& config);
+
+	// registers every player, with the default rating, in a system that
+	// must be empty, so that player IDs in the system match the league's
+	void Populate(Glicko2& system) const;
+
+	// records one period's games in a populated system
+	void Play_Period(Glicko2& system);
+
+	size_t Size() const
+	{ return names.size(); }
+
+	const SyntheticLeague_Config& Get_Config() const
+	{ return config; }
+
+	const std::string& Get_Name(uint32_t id) const
+	{ return names[id]; }
+
+	double Get_Skill(uint32_t id) const
+	{ return skill[id]; }
+
+private:
+	SyntheticLeague_Config config;
+	uint64_t state;
+	std::vector<std::string> names;
+	std::vector<double> skill;
+	std::vector<double> activity;	// cumulative pick weights
+
+	uint64_t Next();
+	double Uniform();
+	double Normal();
+	uint32_t Pick();
+};
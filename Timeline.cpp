@@ -0,0 +1,767 @@
+#include "Timeline.h"
+#include "Engine.h"
+#include "Glicko2.h"
+#include "Snapshot.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	const char MAGIC[8] = { 'G', 'L', 'I', 'C', 'K', 'O', '2', 'T' };
+	const uint32_t RECORD_MAGIC = 0x44524550;	// "PERD"
+	enum { DELTA = 0, KEYFRAME = 1 };
+
+	struct File_Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t header_size;
+		uint32_t keyframe_interval;
+		uint32_t reserved;
+	};
+
+	struct Record_Header
+	{
+		uint32_t magic;
+		uint32_t kind;
+		uint32_t period;
+		uint32_t count;
+		uint64_t payload_size;
+		uint64_t checksum;	// over the fields above, then the payload
+	};
+
+	// the payload starts with the number of blocks and the size of each
+	// section, then the new names and the block index
+	struct Section_Sizes
+	{
+		uint32_t blocks;
+		uint32_t names;
+		uint32_t ids;
+		uint32_t columns[4];
+	};
+
+	// where the streams restart for a block of players: byte offsets into
+	// the IDs and recorded periods, bit offsets into the value columns
+	struct Block
+	{
+		uint32_t first_id;
+		uint32_t ids;
+		uint32_t columns[3];
+		uint32_t recorded;
+	};
+
+	uint64_t Record_Checksum(const Record_Header& header, const char* payload)
+	{
+		uint64_t seed = Snapshot::Checksum(&header, offsetof(Record_Header, checksum));
+		return Snapshot::Checksum(payload, header.payload_size, seed);
+	}
+
+	uint64_t Bits(double value)
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	double Value(uint64_t bits)
+	{
+		double value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	void Put_Varint(std::vector<char>& out, uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back(static_cast<char>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<char>(value));
+	}
+
+	bool Get_Varint(const char*& p, const char* end, uint32_t& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 35 && p < end; shift += 7)
+		{
+			uint8_t byte = *p++;
+			value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				return true;
+		}
+		return false;
+	}
+
+	// bits are written most significant first
+	class Bit_Writer
+	{
+	public:
+		explicit Bit_Writer(std::vector<char>& out) :
+			out{ out }
+		{}
+
+		void Put(uint64_t value, int count)
+		{
+			while (count > 0)
+			{
+				int take = std::min(count, 8 - fill);
+				uint8_t bits = (value >> (count - take)) & ((1u << take) - 1);
+				byte = static_cast<uint8_t>(byte << take) | bits;
+				fill += take;
+				count -= take;
+				if (fill == 8)
+				{
+					out.push_back(static_cast<char>(byte));
+					byte = 0;
+					fill = 0;
+				}
+			}
+		}
+
+		void Put_Value(double value, double reference)
+		{
+			uint64_t x = Bits(value) ^ Bits(reference);
+			if (x == 0)
+			{
+				Put(0, 1);
+				return;
+			}
+			int lead = std::min(__builtin_clzll(x), 31), trail = __builtin_ctzll(x);
+			int length = 64 - lead - trail;
+			Put(1, 1);
+			Put(lead, 5);
+			Put(length - 1, 6);
+			Put(x >> trail, length);
+		}
+
+		// bits written so far
+		size_t Position() const
+		{ return out.size() * 8 + fill; }
+
+		void Flush()
+		{
+			if (fill > 0)
+				out.push_back(static_cast<char>(byte << (8 - fill)));
+			byte = 0;
+			fill = 0;
+		}
+
+	private:
+		std::vector<char>& out;
+		uint8_t byte = 0;
+		int fill = 0;
+	};
+
+	class Bit_Reader
+	{
+	public:
+		Bit_Reader(const char* data, size_t size, size_t start = 0) :
+			data{ reinterpret_cast<const uint8_t*>(data) },
+			bits{ size * 8 },
+			pos{ start }
+		{}
+
+		bool Good() const
+		{ return good; }
+
+		uint64_t Get(int count)
+		{
+			if (pos + count > bits)
+			{
+				good = false;
+				return 0;
+			}
+			uint64_t value = 0;
+			while (count > 0)
+			{
+				int avail = 8 - (pos & 7), take = std::min(count, avail);
+				value = (value << take) | ((data[pos >> 3] >> (avail - take)) & ((1u << take) - 1));
+				pos += take;
+				count -= take;
+			}
+			return value;
+		}
+
+		double Get_Value(double reference)
+		{
+			if (Get(1) == 0)
+				return reference;
+			int lead = Get(5), length = Get(6) + 1, trail = 64 - lead - length;
+			if (trail < 0)
+			{
+				good = false;
+				return 0;
+			}
+			return Value(Bits(reference) ^ (Get(length) << trail));
+		}
+
+		void Skip_Value()
+		{
+			if (Get(1) != 0)
+			{
+				Get(5);
+				Get(Get(6) + 1);
+			}
+		}
+
+	private:
+		const uint8_t* data;
+		size_t bits;
+		size_t pos;
+		bool good = true;
+	};
+
+	double& Column(Timeline::Entry& entry, int column)
+	{ return column == 0 ? entry.rating : column == 1 ? entry.rd : entry.vol; }
+
+	// a player's entry in a state, if recorded there
+	const Timeline::Entry* Lookup(const std::vector<Timeline::Entry>& entries, uint32_t id)
+	{ return id < entries.size() && entries[id].recorded != Timeline::NO_PERIOD ? &entries[id] : nullptr; }
+
+	double Reference(const Timeline::Entry* entry, int column)
+	{ return !entry ? 0 : column == 0 ? entry->rating : column == 1 ? entry->rd : entry->vol; }
+
+	// the RD as of `period`, inflated as Glicko2::Get_Current_RD() does
+	void Inflate(Timeline::Entry& entry, uint32_t period)
+	{
+		const double SCALE = Engine<double>::SCALE;
+		for (uint32_t p = entry.recorded; p < period; p++)
+		{
+			double phi_p = std::sqrt(std::pow(entry.rd / SCALE, 2) + std::pow(entry.vol,2));
+			entry.rd = SCALE*phi_p;
+		}
+	}
+}
+
+Timeline::~Timeline()
+{
+	Close();
+}
+
+int Timeline::Open(const char* filename, uint32_t keyframe_interval)
+{
+	Close();
+	fd = ::open(filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return CANNOT_OPEN;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		Close();
+		return CANNOT_OPEN;
+	}
+
+	data.resize(st.st_size);
+	size_t done = 0;
+	while (done < data.size())
+	{
+		ssize_t n = ::pread(fd, data.data() + done, data.size() - done, done);
+		if (n <= 0)
+		{
+			Close();
+			return CANNOT_OPEN;
+		}
+		done += n;
+	}
+
+	// a new timeline, or one that crashed before its header was complete
+	if (data.size() < sizeof(File_Header))
+	{
+		interval = std::max<uint32_t>(keyframe_interval, 1);
+		if (!Write_Header())
+		{
+			Close();
+			return WRITE_FAILED;
+		}
+		return OK;
+	}
+
+	File_Header header;
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.header_size != sizeof(header) || header.keyframe_interval == 0)
+	{
+		Close();
+		return BAD_FORMAT;
+	}
+	interval = header.keyframe_interval;
+
+	// index whole records up to the first one that's torn
+	size_t offset = sizeof(header);
+	if (offset + sizeof(Record_Header) <= data.size())
+	{
+		Record_Header first;
+		std::memcpy(&first, data.data() + offset, sizeof(first));
+		first_period = first.period;
+	}
+	Record record;
+	while (Index(offset, records.size(), record))
+	{
+		records.push_back(record);
+		Record_Header record_header;
+		std::memcpy(&record_header, data.data() + offset, sizeof(record_header));
+		offset += sizeof(record_header) + record_header.payload_size;
+	}
+	if (offset < data.size())
+	{
+		data.resize(offset);
+		if (::ftruncate(fd, offset) != 0 || ::fdatasync(fd) != 0)
+		{
+			Close();
+			return WRITE_FAILED;
+		}
+	}
+	if (::lseek(fd, offset, SEEK_SET) < 0)
+	{
+		Close();
+		return CANNOT_OPEN;
+	}
+
+	// the names, then the state Append() carries on from
+	for (const Record& record : records)
+	{
+		if (!Read_Names(record))
+		{
+			Close();
+			return BAD_FORMAT;
+		}
+	}
+	names_recorded = names.size();
+	if (!records.empty())
+	{
+		uint32_t keyframe = records.back().keyframe;
+		bool good = Decode(keyframe, key, key);
+		last = key;
+		for (uint32_t index = keyframe + 1; good && index < records.size(); index++)
+			good = Decode(index, key, last);
+		if (!good)
+		{
+			Close();
+			return BAD_FORMAT;
+		}
+	}
+	return OK;
+}
+
+void Timeline::Close()
+{
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+	first_period = 0;
+	data.clear();
+	records.clear();
+	key.clear();
+	last.clear();
+	names.clear();
+	name_index.clear();
+	names_recorded = 0;
+}
+
+int Timeline::Append(const Glicko2& system)
+{
+	return Append(system, system.Get_Period());
+}
+
+int Timeline::Append(const Glicko2& system, uint32_t period)
+{
+	if (fd < 0)
+		return CANNOT_OPEN;
+
+	if (records.empty())
+		first_period = period;
+	else if (period <= Last_Period())
+		return OUT_OF_ORDER;
+
+	// a keyframe has everyone recorded so far
+	auto write = [&](std::vector<uint32_t>& ids)
+	{
+		uint32_t index = records.size();
+		if (index % interval == 0)
+		{
+			ids.clear();
+			for (uint32_t id = 0; id < last.size(); id++)
+				if (last[id].recorded != NO_PERIOD)
+					ids.push_back(id);
+		}
+		if (!Write_Record(index, ids))
+			return false;
+		if (index % interval == 0)
+			key = last;
+		return true;
+	};
+
+	// the periods the system went through without being recorded
+	std::vector<uint32_t> ids;
+	while (!records.empty() && Last_Period() + 1 < period)
+	{
+		if (!write(ids))
+			return WRITE_FAILED;
+		ids.clear();
+	}
+
+	// the rated players whose stored values changed, bit for bit, matched
+	// to the timeline's by name; new names take the next IDs
+	const RatingStore& store = system.Get_Store();
+	uint32_t now = system.Get_Period();
+	size_t known = names.size();
+	std::vector<Entry> next { last };
+	for (uint32_t id = 0; id < store.Size(); id++)
+	{
+		if (!store.Is_Member(id))
+			continue;
+		auto inserted = name_index.emplace(store.Get_Name(id), names.size());
+		if (inserted.second)
+		{
+			names.push_back(store.Get_Name(id));
+			next.resize(names.size());
+		}
+		uint32_t tid = inserted.first->second;
+		Entry& entry = next[tid];
+		if (entry.recorded == NO_PERIOD || Bits(entry.rating) != Bits(store.Get_Rating(id)) || Bits(entry.rd) != Bits(store.Get_RD(id)) || Bits(entry.vol) != Bits(store.Get_Vol(id)))
+		{
+			uint32_t age = std::min(now - system.Get_Rated_Period(id), period);
+			entry = Entry{ store.Get_Rating(id), store.Get_RD(id), store.Get_Vol(id), period - age };
+			ids.push_back(tid);
+		}
+	}
+	std::sort(ids.begin(), ids.end());
+
+	std::swap(last, next);
+	if (!write(ids))
+	{
+		std::swap(last, next);
+		for (size_t i = known; i < names.size(); i++)
+			name_index.erase(names[i]);
+		names.resize(known);
+		return WRITE_FAILED;
+	}
+	return OK;
+}
+
+uint32_t Timeline::Find(const std::string& name) const
+{
+	auto it = name_index.find(name);
+	return it == name_index.end() ? npos : it->second;
+}
+
+bool Timeline::Write_Record(uint32_t index, const std::vector<uint32_t>& ids)
+{
+	uint32_t period = first_period + index;
+	bool keyframe = index % interval == 0;
+
+	// the streams restart at each block, so each can be decoded on its own
+	std::vector<Block> blocks ((ids.size() + BLOCK_SIZE - 1) / BLOCK_SIZE);
+	std::vector<char> id_bytes, columns[4];
+	Bit_Writer out[3] = { Bit_Writer{ columns[0] }, Bit_Writer{ columns[1] }, Bit_Writer{ columns[2] } };
+	double previous[3];
+	for (size_t i = 0; i < ids.size(); i++)
+	{
+		uint32_t id = ids[i];
+		const Entry& entry = last[id];
+		if (i % BLOCK_SIZE == 0)
+		{
+			Block& block = blocks[i / BLOCK_SIZE];
+			block.first_id = id;
+			block.ids = id_bytes.size();
+			for (int c = 0; c < 3; c++)
+				block.columns[c] = out[c].Position();
+			block.recorded = columns[3].size();
+			previous[0] = previous[1] = previous[2] = 0;
+			Put_Varint(id_bytes, id);
+		}
+		else
+			Put_Varint(id_bytes, id - ids[i-1] - 1);
+
+		const Entry* reference = Lookup(key, id);
+		for (int c = 0; c < 3; c++)
+		{
+			double value = c == 0 ? entry.rating : c == 1 ? entry.rd : entry.vol;
+			out[c].Put_Value(value, keyframe ? previous[c] : Reference(reference, c));
+			previous[c] = value;
+		}
+		Put_Varint(columns[3], period - entry.recorded);
+	}
+	for (int c = 0; c < 3; c++)
+		out[c].Flush();
+
+	// the names recorded since the last record
+	std::vector<char> name_bytes;
+	for (size_t i = names_recorded; i < names.size(); i++)
+		name_bytes.insert(name_bytes.end(), names[i].c_str(), names[i].c_str() + names[i].size() + 1);
+
+	Section_Sizes sizes;
+	sizes.blocks = blocks.size();
+	sizes.names = name_bytes.size();
+	sizes.ids = id_bytes.size();
+	for (int c = 0; c < 4; c++)
+		sizes.columns[c] = columns[c].size();
+
+	std::vector<char> buffer (sizeof(Record_Header));
+	buffer.insert(buffer.end(), reinterpret_cast<const char*>(&sizes), reinterpret_cast<const char*>(&sizes + 1));
+	buffer.insert(buffer.end(), name_bytes.begin(), name_bytes.end());
+	buffer.insert(buffer.end(), reinterpret_cast<const char*>(blocks.data()), reinterpret_cast<const char*>(blocks.data() + blocks.size()));
+	buffer.insert(buffer.end(), id_bytes.begin(), id_bytes.end());
+	for (int c = 0; c < 4; c++)
+		buffer.insert(buffer.end(), columns[c].begin(), columns[c].end());
+
+	Record_Header header;
+	header.magic = RECORD_MAGIC;
+	header.kind = keyframe ? KEYFRAME : DELTA;
+	header.period = period;
+	header.count = ids.size();
+	header.payload_size = buffer.size() - sizeof(header);
+	header.checksum = Record_Checksum(header, buffer.data() + sizeof(header));
+	std::memcpy(buffer.data(), &header, sizeof(header));
+
+	off_t end = data.size();
+	size_t done = 0;
+	while (done < buffer.size())
+	{
+		ssize_t n = ::write(fd, buffer.data() + done, buffer.size() - done);
+		if (n <= 0)
+			break;
+		done += n;
+	}
+	if (done < buffer.size() || ::fdatasync(fd) != 0)
+	{
+		if (::ftruncate(fd, end) == 0)
+			::lseek(fd, end, SEEK_SET);
+		return false;
+	}
+
+	data.insert(data.end(), buffer.begin(), buffer.end());
+	Record record;
+	if (!Index(end, index, record))
+		return false;
+	records.push_back(record);
+	names_recorded = names.size();
+	return true;
+}
+
+bool Timeline::Write_Header()
+{
+	File_Header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.header_size = sizeof(header);
+	header.keyframe_interval = interval;
+
+	data.assign(reinterpret_cast<const char*>(&header), reinterpret_cast<const char*>(&header) + sizeof(header));
+	return ::pwrite(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header))
+		&& ::ftruncate(fd, sizeof(header)) == 0
+		&& ::fdatasync(fd) == 0
+		&& ::lseek(fd, sizeof(header), SEEK_SET) >= 0;
+}
+
+bool Timeline::Index(size_t offset, uint32_t index, Record& record) const
+{
+	Record_Header header;
+	if (offset + sizeof(header) > data.size())
+		return false;
+	std::memcpy(&header, data.data() + offset, sizeof(header));
+	const char* payload = data.data() + offset + sizeof(header);
+	if (header.magic != RECORD_MAGIC || header.period != first_period + index || header.kind != (index % interval == 0 ? KEYFRAME : DELTA)
+		|| header.payload_size < sizeof(Section_Sizes) || header.payload_size > data.size() - offset - sizeof(header)
+		|| Record_Checksum(header, payload) != header.checksum)
+		return false;
+
+	Section_Sizes sizes;
+	std::memcpy(&sizes, payload, sizeof(sizes));
+	if (sizes.blocks != (header.count + BLOCK_SIZE - 1) / BLOCK_SIZE)
+		return false;
+
+	size_t position = offset + sizeof(header) + sizeof(sizes);
+	record.keyframe = index - index % interval;
+	record.count = header.count;
+	record.names = position;
+	record.names_size = sizes.names;
+	position += sizes.names;
+	record.blocks = position;
+	position += size_t(sizes.blocks) * sizeof(Block);
+	record.ids = position;
+	position += sizes.ids;
+	for (int c = 0; c < 4; c++)
+	{
+		record.columns[c] = position;
+		record.column_sizes[c] = sizes.columns[c];
+		position += sizes.columns[c];
+	}
+	return position == offset + sizeof(header) + header.payload_size;
+}
+
+bool Timeline::Read_Names(const Record& record)
+{
+	const char* p = data.data() + record.names;
+	const char* end = p + record.names_size;
+	while (p < end)
+	{
+		const char* nul = static_cast<const char*>(std::memchr(p, '\0', end - p));
+		if (!nul || !name_index.emplace(std::string{ p, nul }, names.size()).second)
+			return false;
+		names.emplace_back(p, nul);
+		p = nul + 1;
+	}
+	return true;
+}
+
+bool Timeline::Decode(uint32_t index, const std::vector<Entry>& reference, std::vector<Entry>& entries) const
+{
+	const Record& record = records[index];
+	bool keyframe = index % interval == 0;
+	uint32_t period = first_period + index;
+	if (keyframe)
+		entries.clear();
+
+	const char* ids = data.data() + record.ids;
+	const char* ids_end = data.data() + record.columns[0];
+	const char* recorded = data.data() + record.columns[3];
+	const char* recorded_end = recorded + record.column_sizes[3];
+	Bit_Reader in[3] = {
+		Bit_Reader{ data.data() + record.columns[0], record.column_sizes[0] },
+		Bit_Reader{ data.data() + record.columns[1], record.column_sizes[1] },
+		Bit_Reader{ data.data() + record.columns[2], record.column_sizes[2] }
+	};
+	uint32_t id = 0, gap, age;
+	double previous[3];
+	for (uint32_t i = 0; i < record.count; i++)
+	{
+		if (!Get_Varint(ids, ids_end, gap) || !Get_Varint(recorded, recorded_end, age) || age > period)
+			return false;
+		if (i % BLOCK_SIZE == 0)
+		{
+			id = gap;
+			previous[0] = previous[1] = previous[2] = 0;
+		}
+		else
+			id += gap + 1;
+		if (id >= names.size())
+			return false;
+
+		// the reference may be the entry about to be overwritten
+		const Entry* base = Lookup(reference, id);
+		Entry entry;
+		for (int c = 0; c < 3; c++)
+			previous[c] = Column(entry, c) = in[c].Get_Value(keyframe ? previous[c] : Reference(base, c));
+		entry.recorded = period - age;
+
+		if (id >= entries.size())
+			entries.resize(id + 1);
+		entries[id] = entry;
+	}
+	return in[0].Good() && in[1].Good() && in[2].Good();
+}
+
+bool Timeline::Find(uint32_t index, uint32_t id, const Entry* reference, Entry& entry) const
+{
+	const Record& record = records[index];
+	bool keyframe = index % interval == 0;
+	if (record.count == 0)
+		return false;
+
+	// the last block starting at or before the ID
+	uint32_t low = 0, high = (record.count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	Block block;
+	while (high - low > 1)
+	{
+		uint32_t middle = (low + high) / 2;
+		std::memcpy(&block, data.data() + record.blocks + middle * sizeof(Block), sizeof(Block));
+		if (block.first_id <= id)
+			low = middle;
+		else
+			high = middle;
+	}
+	std::memcpy(&block, data.data() + record.blocks + low * sizeof(Block), sizeof(Block));
+	if (block.first_id > id)
+		return false;
+
+	const char* ids = data.data() + record.ids + block.ids;
+	const char* ids_end = data.data() + record.columns[0];
+	const char* recorded = data.data() + record.columns[3] + block.recorded;
+	const char* recorded_end = data.data() + record.columns[3] + record.column_sizes[3];
+	Bit_Reader in[3] = {
+		Bit_Reader{ data.data() + record.columns[0], record.column_sizes[0], block.columns[0] },
+		Bit_Reader{ data.data() + record.columns[1], record.column_sizes[1], block.columns[1] },
+		Bit_Reader{ data.data() + record.columns[2], record.column_sizes[2], block.columns[2] }
+	};
+	uint32_t current = 0, gap, age;
+	double previous[3] = { 0, 0, 0 };
+	uint32_t end = std::min(record.count, (low + 1) * BLOCK_SIZE);
+	for (uint32_t i = low * BLOCK_SIZE; i < end; i++)
+	{
+		if (!Get_Varint(ids, ids_end, gap) || !Get_Varint(recorded, recorded_end, age))
+			return false;
+		current = i == low * BLOCK_SIZE ? gap : current + gap + 1;
+		if (current > id)
+			return false;
+
+		if (current == id)
+		{
+			for (int c = 0; c < 3; c++)
+				Column(entry, c) = in[c].Get_Value(keyframe ? previous[c] : Reference(reference, c));
+			entry.recorded = first_period + index - age;
+			return in[0].Good() && in[1].Good() && in[2].Good();
+		}
+
+		// a keyframe's values chain from one player to the next
+		for (int c = 0; c < 3; c++)
+		{
+			if (keyframe)
+				previous[c] = in[c].Get_Value(previous[c]);
+			else
+				in[c].Skip_Value();
+		}
+	}
+	return false;
+}
+
+bool Timeline::Get(uint32_t id, uint32_t period, Entry& entry) const
+{
+	if (records.empty() || period < first_period)
+		return false;
+	period = std::min(period, Last_Period());
+	uint32_t index = period - first_period;
+	uint32_t keyframe = records[index].keyframe;
+
+	// the newest record since the keyframe that has the player
+	Entry reference;
+	bool in_keyframe = Find(keyframe, id, nullptr, reference);
+	bool found = false;
+	for (uint32_t i = index; i > keyframe && !found; i--)
+		found = Find(i, id, in_keyframe ? &reference : nullptr, entry);
+	if (!found)
+	{
+		if (!in_keyframe)
+			return false;
+		entry = reference;
+	}
+	Inflate(entry, period);
+	return true;
+}
+
+void Timeline::Get_All(uint32_t period, std::vector<Entry>& entries) const
+{
+	entries.clear();
+	if (records.empty() || period < first_period)
+		return;
+	period = std::min(period, Last_Period());
+	uint32_t index = period - first_period;
+	uint32_t keyframe = records[index].keyframe;
+
+	std::vector<Entry> reference;
+	Decode(keyframe, reference, reference);
+	entries = reference;
+	for (uint32_t i = keyframe + 1; i <= index; i++)
+		Decode(i, reference, entries);
+	for (Entry& entry : entries)
+		if (entry.recorded != NO_PERIOD)
+			Inflate(entry, period);
+}
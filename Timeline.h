@@ -0,0 +1,155 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Glicko2;
+
+/*
+ * Rating history of a Glicko-2 system, one record per rating period, kept
+ * in a single append-only file.
+ *
+ * Append() records the system as of the start of its current period, so it
+ * is called after each Run() or Close_Period() (and once before the first,
+ * for the starting ratings). Periods are the system's own; any it skipped
+ * are recorded as unchanged. A record only lists the rated players whose
+ * stored rating, RD or volatility changed since the previous one, except
+ * that every KEYFRAME_INTERVAL records (by default) it lists every player.
+ *
+ * Players have timeline IDs of their own, handed out in the order their
+ * names are first recorded: a system's IDs depend on the order its players
+ * were loaded in, so they can't be relied on from one session to the next,
+ * and Append() matches the system's players to the timeline's by name.
+ * Each record starts with the names of the players it records for the
+ * first time, NUL-terminated, which take the next IDs in turn.
+ *
+ * A record lists its players by ID, as gaps between ascending IDs in
+ * LEB128 varints, followed by one column per value. Each value is stored
+ * XORed with a reference (the same player's value in the last keyframe, or
+ * in a keyframe the previous player's value) and only the meaningful bits
+ * of the XOR are written:
+ *
+ *     0                          same as the reference
+ *     1, lead:5, len-1:6, bits   len bits of XOR, after lead zero bits
+ *
+ * The last column is the period each value is current as of, as a varint
+ * distance back from the record's. Every BLOCK_SIZE players a record's
+ * streams restart and a block index says where, so a lookup decodes at
+ * most a block per record: Get() looks the player up in the keyframe at
+ * or before T and in the records since, newest first, while Get_All()
+ * replays those records in full. Both return the RD as of T, inflated for
+ * the periods the player sat out just as Glicko2::Get_Current_RD() does.
+ *
+ * Records carry a checksum like MatchLog's batches, and a torn last record
+ * is cut off when the file is reopened.
+ */
+class Timeline
+{
+public:
+	static constexpr uint32_t npos = UINT32_MAX;
+	static const uint32_t VERSION = 2;
+	static const uint32_t KEYFRAME_INTERVAL = 32;
+	static const uint32_t BLOCK_SIZE = 64;
+	static const uint32_t NO_PERIOD = UINT32_MAX;
+
+	// return codes, the same as Snapshot's, plus Append() of a period that
+	// is already recorded
+	enum { OK = 0, CANNOT_OPEN = 1, BAD_FORMAT = 2, BAD_CHECKSUM = 3, WRITE_FAILED = 4, OUT_OF_ORDER = 5 };
+
+	// a player's values as of a period, and the period they date from
+	struct Entry
+	{
+		double rating;
+		double rd;
+		double vol;
+		uint32_t recorded = NO_PERIOD;
+	};
+
+	Timeline() = default;
+	~Timeline();
+
+	Timeline(const Timeline&) = delete;
+	Timeline& operator=(const Timeline&) = delete;
+
+	// opens the timeline, creating it if needed; the interval only applies
+	// to a new file
+	int Open(const char* filename, uint32_t keyframe_interval = KEYFRAME_INTERVAL);
+	void Close();
+
+	bool Is_Open() const
+	{ return fd >= 0; }
+
+	int Append(const Glicko2& system);
+
+	// records the system's current period as `period`, for a system whose
+	// clock doesn't carry on from the timeline's (CSV files don't keep it)
+	int Append(const Glicko2& system, uint32_t period);
+
+	size_t Num_Periods() const
+	{ return records.size(); }
+
+	// the periods recorded, NO_PERIOD while empty
+	uint32_t First_Period() const
+	{ return records.empty() ? NO_PERIOD : first_period; }
+
+	uint32_t Last_Period() const
+	{ return records.empty() ? NO_PERIOD : first_period + records.size() - 1; }
+
+	uint64_t Get_File_Size() const
+	{ return data.size(); }
+
+	// players ever recorded, and their timeline IDs
+	size_t Num_Players() const
+	{ return names.size(); }
+
+	uint32_t Find(const std::string& name) const;
+
+	const std::string& Get_Name(uint32_t id) const
+	{ return names[id]; }
+
+	// false if the player hadn't been recorded by `period`; periods after
+	// the last read as the last
+	bool Get(uint32_t id, uint32_t period, Entry& entry) const;
+
+	// every player recorded by `period`, indexed by timeline ID; the rest
+	// have `recorded` set to NO_PERIOD
+	void Get_All(uint32_t period, std::vector<Entry>& entries) const;
+
+private:
+	// where a record's sections are in the data
+	struct Record
+	{
+		uint32_t keyframe;		// index of the keyframe it builds on
+		uint32_t count;
+		size_t names;
+		size_t names_size;
+		size_t blocks;
+		size_t ids;
+		size_t columns[4];		// rating, rd, vol, recorded
+		size_t column_sizes[4];
+	};
+
+	int fd = -1;
+	uint32_t interval = KEYFRAME_INTERVAL;
+	uint32_t first_period = 0;
+	std::vector<char> data;			// the whole file
+	std::vector<Record> records;	// by period, from the first
+
+	// by timeline ID, and how many of them are in the file
+	std::vector<std::string> names;
+	std::unordered_map<std::string, uint32_t> name_index;
+	size_t names_recorded = 0;
+
+	// the state as of the last keyframe and the last period, by player ID
+	std::vector<Entry> key;
+	std::vector<Entry> last;
+
+	bool Index(size_t offset, uint32_t index, Record& record) const;
+	bool Decode(uint32_t index, const std::vector<Entry>& reference, std::vector<Entry>& entries) const;
+	bool Find(uint32_t index, uint32_t id, const Entry* reference, Entry& entry) const;
+	bool Read_Names(const Record& record);
+	bool Write_Record(uint32_t index, const std::vector<uint32_t>& ids);
+	bool Write_Header();
+};
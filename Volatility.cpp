@@ -0,0 +1,258 @@
+#include "Volatility.h"
+#include "Kernel.h"
+#include "SimdMath.h"
+#include <cmath>
+
+namespace
+{
+	void Solve_Scalar(double phi, double nu, double delta, double volatility, double tau, double& sigma_p, int& iterations)
+	{
+		double a = std::log(std::pow(volatility, 2));
+		auto f = [&](double x) -> double
+		{
+			++iterations;
+			return ((std::exp(x)*(std::pow(delta,2)-std::pow(phi,2)-nu-std::exp(x))) / (2*std::pow(std::pow(phi,2)+nu+std::exp(x),2)))-((x-a) / std::pow(tau,2));
+		};
+		double epsilon = Volatility::EPSILON;
+
+		double A = a;
+		double B;
+		if (std::pow(delta, 2) > std::pow(phi, 2) + nu)
+			B = std::log(std::pow(delta, 2)-std::pow(phi, 2)-nu);
+		else
+		{
+			int k = 1;
+			while (f(a-k*tau) < 0)
+				++k;
+			B = a - k*tau;
+		}
+
+		double fa = f(A); double fb = f(B);
+		while (std::abs(B-A) > epsilon)
+		{
+			double C = A + (A-B)*fa/(fb-fa);
+			double fc = f(C);
+			// landing on the root itself ends the search; left to the update
+			// below, B would stay put and only fa would shrink, forever
+			if (fc == 0)
+				A = C;
+			else if (fc*fb < 0)
+			{ A = B; fa = fb; }
+			else
+				fa /= 2;
+			B = C; fb = fc;
+		}
+
+		sigma_p = std::exp(A/2);
+	}
+
+	/*
+	 * Per-lane inputs for one SIMD block. The starting point a = ln(sigma^2)
+	 * and, where delta^2 > phi^2 + nu, the upper bracket are set up with the
+	 * scalar std::log so that they match the scalar solver exactly. Unused
+	 * lanes of the last block repeat the first player and are discarded, so
+	 * a player's result never depends on which block or lane it landed in.
+	 */
+	template<int W>
+	struct Lanes
+	{
+		double a[W], d2[W], p2[W], nu[W], B[W];
+		bool bracketed[W];
+
+		void Load(const double* phi, const double* nu, const double* delta, const double* sigma, size_t i, size_t n)
+		{
+			for (int l = 0; l < W; l++)
+			{
+				size_t k = i + l < n ? i + l : i;
+				a[l] = std::log(std::pow(sigma[k], 2));
+				d2[l] = std::pow(delta[k], 2);
+				p2[l] = std::pow(phi[k], 2);
+				this->nu[l] = nu[k];
+				bracketed[l] = d2[l] > p2[l] + nu[k];
+				B[l] = bracketed[l] ? std::log(d2[l]-p2[l]-nu[k]) : 0;
+			}
+		}
+	};
+
+	__attribute__((target("avx2,fma")))
+	inline __m256d F_AVX2(__m256d x, __m256d a, __m256d d2, __m256d p2, __m256d nu, __m256d tau2)
+	{
+		__m256d e = Exp_AVX2(x);
+		__m256d num = _mm256_mul_pd(e, _mm256_sub_pd(_mm256_sub_pd(_mm256_sub_pd(d2, p2), nu), e));
+		__m256d s = _mm256_add_pd(_mm256_add_pd(p2, nu), e);
+		__m256d den = _mm256_mul_pd(_mm256_set1_pd(2.0), _mm256_mul_pd(s, s));
+		return _mm256_sub_pd(_mm256_div_pd(num, den), _mm256_div_pd(_mm256_sub_pd(x, a), tau2));
+	}
+
+	__attribute__((target("avx2,fma")))
+	void Solve_AVX2(const double* phi, const double* nu, const double* delta, const double* sigma, size_t n, double tau, double* sigma_p, int* iterations)
+	{
+		const __m256d vtau = _mm256_set1_pd(tau);
+		const __m256d tau2 = _mm256_set1_pd(std::pow(tau, 2));
+		const __m256d zero = _mm256_setzero_pd();
+		const __m256d one = _mm256_set1_pd(1.0);
+		const __m256d half = _mm256_set1_pd(0.5);
+		const __m256d eps = _mm256_set1_pd(Volatility::EPSILON);
+		const __m256d abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+
+		Lanes<4> in;
+		for (size_t i = 0; i < n; i += 4)
+		{
+			in.Load(phi, nu, delta, sigma, i, n);
+			__m256d a = _mm256_loadu_pd(in.a);
+			__m256d d2 = _mm256_loadu_pd(in.d2);
+			__m256d p2 = _mm256_loadu_pd(in.p2);
+			__m256d vnu = _mm256_loadu_pd(in.nu);
+			__m256d B = _mm256_loadu_pd(in.B);
+			__m256d count = zero;
+
+			// bracket search: step k down by tau until f(a - k*tau) >= 0
+			__m256d searching = _mm256_castsi256_pd(_mm256_set_epi64x(in.bracketed[3] ? 0 : -1, in.bracketed[2] ? 0 : -1, in.bracketed[1] ? 0 : -1, in.bracketed[0] ? 0 : -1));
+			__m256d k = one;
+			while (_mm256_movemask_pd(searching))
+			{
+				__m256d fx = F_AVX2(_mm256_fnmadd_pd(k, vtau, a), a, d2, p2, vnu, tau2);
+				count = _mm256_add_pd(count, _mm256_and_pd(searching, one));
+				__m256d more = _mm256_and_pd(searching, _mm256_cmp_pd(fx, zero, _CMP_LT_OQ));
+				B = _mm256_blendv_pd(B, _mm256_fnmadd_pd(k, vtau, a), _mm256_andnot_pd(more, searching));
+				k = _mm256_add_pd(k, _mm256_and_pd(more, one));
+				searching = more;
+			}
+
+			__m256d A = a;
+			__m256d fa = F_AVX2(A, a, d2, p2, vnu, tau2);
+			__m256d fb = F_AVX2(B, a, d2, p2, vnu, tau2);
+			count = _mm256_add_pd(count, _mm256_set1_pd(2.0));
+
+			__m256d active = _mm256_cmp_pd(_mm256_and_pd(_mm256_sub_pd(B, A), abs_mask), eps, _CMP_GT_OQ);
+			while (_mm256_movemask_pd(active))
+			{
+				__m256d C = _mm256_add_pd(A, _mm256_div_pd(_mm256_mul_pd(_mm256_sub_pd(A, B), fa), _mm256_sub_pd(fb, fa)));
+				__m256d fc = F_AVX2(C, a, d2, p2, vnu, tau2);
+				count = _mm256_add_pd(count, _mm256_and_pd(active, one));
+
+				__m256d swap = _mm256_cmp_pd(_mm256_mul_pd(fc, fb), zero, _CMP_LT_OQ);
+				__m256d A_next = _mm256_blendv_pd(A, B, swap);
+				__m256d fa_next = _mm256_blendv_pd(_mm256_mul_pd(fa, half), fb, swap);
+				A = _mm256_blendv_pd(A, A_next, active);
+				fa = _mm256_blendv_pd(fa, fa_next, active);
+				B = _mm256_blendv_pd(B, C, active);
+				fb = _mm256_blendv_pd(fb, fc, active);
+				// as in the scalar solver, a lane on the root itself is done
+				A = _mm256_blendv_pd(A, C, _mm256_and_pd(active, _mm256_cmp_pd(fc, zero, _CMP_EQ_OQ)));
+
+				active = _mm256_and_pd(active, _mm256_cmp_pd(_mm256_and_pd(_mm256_sub_pd(B, A), abs_mask), eps, _CMP_GT_OQ));
+			}
+
+			double out[4], iters[4];
+			_mm256_storeu_pd(out, Exp_AVX2(_mm256_mul_pd(A, half)));
+			_mm256_storeu_pd(iters, count);
+			for (size_t l = 0; l < 4 && i + l < n; l++)
+			{
+				sigma_p[i+l] = out[l];
+				iterations[i+l] = static_cast<int>(iters[l]);
+			}
+		}
+	}
+
+	__attribute__((target("avx512f")))
+	inline __m512d F_AVX512(__m512d x, __m512d a, __m512d d2, __m512d p2, __m512d nu, __m512d tau2)
+	{
+		__m512d e = Exp_AVX512(x);
+		__m512d num = _mm512_mul_pd(e, _mm512_sub_pd(_mm512_sub_pd(_mm512_sub_pd(d2, p2), nu), e));
+		__m512d s = _mm512_add_pd(_mm512_add_pd(p2, nu), e);
+		__m512d den = _mm512_mul_pd(_mm512_set1_pd(2.0), _mm512_mul_pd(s, s));
+		return _mm512_sub_pd(_mm512_div_pd(num, den), _mm512_div_pd(_mm512_sub_pd(x, a), tau2));
+	}
+
+	__attribute__((target("avx512f")))
+	void Solve_AVX512(const double* phi, const double* nu, const double* delta, const double* sigma, size_t n, double tau, double* sigma_p, int* iterations)
+	{
+		const __m512d vtau = _mm512_set1_pd(tau);
+		const __m512d tau2 = _mm512_set1_pd(std::pow(tau, 2));
+		const __m512d zero = _mm512_setzero_pd();
+		const __m512d one = _mm512_set1_pd(1.0);
+		const __m512d half = _mm512_set1_pd(0.5);
+		const __m512d eps = _mm512_set1_pd(Volatility::EPSILON);
+
+		Lanes<8> in;
+		for (size_t i = 0; i < n; i += 8)
+		{
+			in.Load(phi, nu, delta, sigma, i, n);
+			__m512d a = _mm512_loadu_pd(in.a);
+			__m512d d2 = _mm512_loadu_pd(in.d2);
+			__m512d p2 = _mm512_loadu_pd(in.p2);
+			__m512d vnu = _mm512_loadu_pd(in.nu);
+			__m512d B = _mm512_loadu_pd(in.B);
+			__m512d count = zero;
+
+			// bracket search: step k down by tau until f(a - k*tau) >= 0
+			__mmask8 searching = 0;
+			for (int l = 0; l < 8; l++)
+				if (!in.bracketed[l])
+					searching |= 1u << l;
+			__m512d k = one;
+			while (searching)
+			{
+				__m512d x = _mm512_fnmadd_pd(k, vtau, a);
+				__m512d fx = F_AVX512(x, a, d2, p2, vnu, tau2);
+				count = _mm512_mask_add_pd(count, searching, count, one);
+				__mmask8 more = _mm512_mask_cmp_pd_mask(searching, fx, zero, _CMP_LT_OQ);
+				B = _mm512_mask_mov_pd(B, searching & ~more, x);
+				k = _mm512_mask_add_pd(k, more, k, one);
+				searching = more;
+			}
+
+			__m512d A = a;
+			__m512d fa = F_AVX512(A, a, d2, p2, vnu, tau2);
+			__m512d fb = F_AVX512(B, a, d2, p2, vnu, tau2);
+			count = _mm512_add_pd(count, _mm512_set1_pd(2.0));
+
+			__mmask8 active = _mm512_cmp_pd_mask(_mm512_abs_pd(_mm512_sub_pd(B, A)), eps, _CMP_GT_OQ);
+			while (active)
+			{
+				__m512d C = _mm512_add_pd(A, _mm512_div_pd(_mm512_mul_pd(_mm512_sub_pd(A, B), fa), _mm512_sub_pd(fb, fa)));
+				__m512d fc = F_AVX512(C, a, d2, p2, vnu, tau2);
+				count = _mm512_mask_add_pd(count, active, count, one);
+
+				__mmask8 swap = _mm512_mask_cmp_pd_mask(active, _mm512_mul_pd(fc, fb), zero, _CMP_LT_OQ);
+				A = _mm512_mask_mov_pd(A, swap, B);
+				fa = _mm512_mask_mov_pd(_mm512_mask_mul_pd(fa, active & ~swap, fa, half), swap, fb);
+				B = _mm512_mask_mov_pd(B, active, C);
+				fb = _mm512_mask_mov_pd(fb, active, fc);
+				A = _mm512_mask_mov_pd(A, _mm512_mask_cmp_pd_mask(active, fc, zero, _CMP_EQ_OQ), C);
+
+				active = _mm512_mask_cmp_pd_mask(active, _mm512_abs_pd(_mm512_sub_pd(B, A)), eps, _CMP_GT_OQ);
+			}
+
+			double out[8], iters[8];
+			_mm512_storeu_pd(out, Exp_AVX512(_mm512_mul_pd(A, half)));
+			_mm512_storeu_pd(iters, count);
+			for (size_t l = 0; l < 8 && i + l < n; l++)
+			{
+				sigma_p[i+l] = out[l];
+				iterations[i+l] = static_cast<int>(iters[l]);
+			}
+		}
+	}
+}
+
+void Volatility::Solve(const double* phi, const double* nu, const double* delta, const double* sigma, size_t n, double tau, double* sigma_p, int* iterations)
+{
+	switch (Kernel::Get_ISA())
+	{
+		case Kernel::AVX512:
+			Solve_AVX512(phi, nu, delta, sigma, n, tau, sigma_p, iterations);
+			break;
+		case Kernel::AVX2:
+			Solve_AVX2(phi, nu, delta, sigma, n, tau, sigma_p, iterations);
+			break;
+		default:
+			for (size_t i = 0; i < n; i++)
+			{
+				iterations[i] = 0;
+				Solve_Scalar(phi[i], nu[i], delta[i], sigma[i], tau, sigma_p[i], iterations[i]);
+			}
+			break;
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+
+/*
+ * Batched solver for step 5 of a Glicko-2 rating period: the new volatility
+ * sigma' of each player, found with the Illinois variant of regula falsi on
+ *
+ *     f(x) = e^x (delta^2 - phi^2 - nu - e^x) / (2 (phi^2 + nu + e^x)^2)
+ *            - (x - a) / tau^2,          a = ln(sigma^2)
+ *
+ * Solve() takes a block of players as SoA arrays and advances the bracket
+ * search and the iteration for all of them in lockstep, one player per SIMD
+ * lane; lanes whose bracket has shrunk below EPSILON, or that have landed
+ * on the root exactly, are masked off while the rest keep going.
+ * iterations[i] receives the number of f() evaluations player i needed,
+ * which makes slow convergers easy to spot.
+ *
+ * The instruction set follows Kernel::Get_ISA(). The scalar path evaluates
+ * the same expressions as the original one-player-at-a-time solver and is
+ * bit-identical to it.
+ */
+class Volatility
+{
+public:
+	static constexpr double EPSILON = 0.000001;
+
+	static void Solve(const double* phi, const double* nu, const double* delta, const double* sigma, size_t n,
+		double tau, double* sigma_p, int* iterations);
+};
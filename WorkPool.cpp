@@ -0,0 +1,104 @@
+#include "WorkPool.h"
+#include <algorithm>
+
+WorkPool::WorkPool(unsigned threads) :
+	num_threads{ threads == 0 ? Hardware_Threads() : threads },
+	partitions{ new Partition[num_threads] }
+{
+	for (unsigned i = 1; i < num_threads; i++)
+		workers.emplace_back(&WorkPool::Worker_Loop, this, i);
+}
+
+WorkPool::~WorkPool()
+{
+	{
+		std::lock_guard<std::mutex> lock { mutex };
+		stopping = true;
+	}
+	start_cv.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+unsigned WorkPool::Hardware_Threads()
+{
+	unsigned n = std::thread::hardware_concurrency();
+	return n == 0 ? 1 : n;
+}
+
+void WorkPool::Run(size_t count, size_t grain, const std::function<void(size_t, size_t)>& task)
+{
+	Run(count, grain, [&task](unsigned, size_t begin, size_t end) { task(begin, end); });
+}
+
+void WorkPool::Run(size_t count, size_t grain, const std::function<void(unsigned, size_t, size_t)>& task)
+{
+	if (count == 0)
+		return;
+
+	if (num_threads == 1 || count <= grain)
+	{
+		task(0, 0, count);
+		return;
+	}
+
+	for (unsigned i = 0; i < num_threads; i++)
+	{
+		partitions[i].next.store(count * i / num_threads, std::memory_order_relaxed);
+		partitions[i].end = count * (i+1) / num_threads;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock { mutex };
+		this->grain = std::max<size_t>(grain, 1);
+		this->task = &task;
+		busy = num_threads - 1;
+		++generation;
+	}
+	start_cv.notify_all();
+
+	Work(0);
+
+	std::unique_lock<std::mutex> lock { mutex };
+	done_cv.wait(lock, [this] { return busy == 0; });
+	this->task = nullptr;
+}
+
+void WorkPool::Worker_Loop(unsigned index)
+{
+	unsigned long seen = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock { mutex };
+			start_cv.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+		}
+
+		Work(index);
+
+		{
+			std::lock_guard<std::mutex> lock { mutex };
+			--busy;
+		}
+		done_cv.notify_one();
+	}
+}
+
+void WorkPool::Work(unsigned index)
+{
+	// drain our own partition first, then steal from the others in turn
+	for (unsigned k = 0; k < num_threads; k++)
+	{
+		Partition& part = partitions[(index + k) % num_threads];
+		while (true)
+		{
+			size_t begin = part.next.fetch_add(grain, std::memory_order_relaxed);
+			if (begin >= part.end)
+				break;
+			(*task)(index, begin, std::min(begin + grain, part.end));
+		}
+	}
+}
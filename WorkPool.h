@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed-size pool of worker threads for data-parallel loops.
+ *
+ * Run() splits [0, count) into one contiguous partition per thread and hands
+ * it out in blocks of `grain` items. A thread that finishes its own
+ * partition steals blocks from the others, so uneven per-item costs (players
+ * with many matches next to idle ones) still keep every core busy. The
+ * calling thread takes part as worker 0 and Run() returns once every block
+ * has been processed.
+ *
+ * A thread count of 0 means one thread per hardware thread.
+ */
+class WorkPool
+{
+public:
+	explicit WorkPool(unsigned threads = 1);
+	~WorkPool();
+
+	WorkPool(const WorkPool&) = delete;
+	WorkPool& operator=(const WorkPool&) = delete;
+
+	unsigned Get_Threads() const
+	{ return num_threads; }
+
+	void Run(size_t count, size_t grain, const std::function<void(size_t, size_t)>& task);
+
+	// as above, also passing the task the index of the worker running it
+	// (0 to Get_Threads()-1), for per-thread state
+	void Run(size_t count, size_t grain, const std::function<void(unsigned, size_t, size_t)>& task);
+
+	static unsigned Hardware_Threads();
+
+private:
+	// padded to a cache line so stealing threads don't false-share cursors
+	struct Partition
+	{
+		std::atomic<size_t> next;
+		size_t end;
+		char padding[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+	};
+
+	unsigned num_threads;
+	std::vector<std::thread> workers;
+	std::unique_ptr<Partition[]> partitions;
+
+	std::mutex mutex;
+	std::condition_variable start_cv;
+	std::condition_variable done_cv;
+	unsigned long generation = 0;
+	unsigned busy = 0;
+	bool stopping = false;
+
+	size_t grain = 1;
+	const std::function<void(unsigned, size_t, size_t)>* task = nullptr;
+
+	void Worker_Loop(unsigned index);
+	void Work(unsigned index);
+};
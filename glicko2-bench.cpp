@@ -0,0 +1,1591 @@
+#include "CsvLoader.h"
+#include "CsvReader.h"
+#include "Engine.h"
+#include "Exporter.h"
+#include "Glicko2.h"
+#include "IngestQueue.h"
+#include "Kernel.h"
+#include "LeagueSet.h"
+#include "RankIndex.h"
+#include "Shard.h"
+#include "Snapshot.h"
+#include "Stats.h"
+#include "SyntheticLeague.h"
+#include "Timeline.h"
+#include "Volatility.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Benchmarks of the rating engine on a synthetic league.
+ *
+ * Each benchmark is repeated and its median time reported, together with
+ * the peak resident set size of the process so far, as one JSON document
+ * on stdout (or in the --output file). The league is fully determined by
+ * its options, so results from different builds are comparable.
+ *
+ * Heap allocations are counted by replacing operator new, and reported per
+ * repetition; the load/run/save cycle checks that they stay proportional to
+ * the players and matches, rather than to copies of them. A build with
+ * STATS=1 counts them in Stats instead, which then replaces operator new,
+ * and adds the instrumentation collected over the whole run to the output.
+ *
+ * The output also validates the approximate math (Glicko2::APPROXIMATE):
+ * two copies of the league are rated over Kernel::APPROXIMATE_PERIODS
+ * incremental periods, one exactly and one approximately, and the largest
+ * differences in rating, RD and volatility between them are reported.
+ * It checks the SIMD kernels the same way: a period rated through each
+ * instruction set the CPU has is compared with the scalar kernel's, in
+ * ULPs for ratings and RDs (Kernel::Ulp_Tolerance()) and relatively for
+ * volatilities (Volatility::EPSILON), and the float precision with the
+ * double one (Kernel::Float_Tolerance()). The bench exits with status 2
+ * if any of these tolerances is exceeded.
+ *
+ * Last come checks of what the library promises beyond speed, each reported
+ * under "checks" as passed or not with what it found; the bench exits with
+ * status 3 if any of them fails. CsvReader must read back the
+ * full-precision doubles an export writes, report a bad row at its line and
+ * read a file again without allocating. The load/run/save cycle must
+ * allocate at most once per player, for the store's name index, plus the
+ * geometric growth of its columns, and nothing per match; and a Player
+ * built and entered through the rvalue overloads must hand the system the
+ * very name strings it was built with. An IngestQueue must count a record
+ * with an unknown player or a score out of range as invalid rather than
+ * rate it. A Close_Period() after a Run() must be refused until
+ * Clear_Matches(), and then rate only the games recorded since. A snapshot
+ * must bring back the period clock along with the values. Once warm, a
+ * Run(), a player rated on their own and a Close_Period() must not allocate
+ * at all, their scratch coming from arenas kept across periods. CsvLoader,
+ * with one reader or several, must build the very system a serial load
+ * would, and report the first bad results file in file order. A league
+ * where every pairing repeats must rate the same whether its games are
+ * recorded in runs, which the kernel weights by their game counts, or one
+ * by one: within Kernel::Ulp_Tolerance() for ratings and RDs, and
+ * Volatility::EPSILON for volatilities, as for the SIMD kernels. Leagues
+ * closing on their own clocks in a LeagueSet must rate every player exactly
+ * as one Glicko2 per league would, and a period rated by several shard
+ * processes and merged must come to exactly the store of a Run(). A
+ * RankIndex re-keyed in small and large batches must keep the order, ranks
+ * and key ranges of a sort. Predict() must agree with the scalar E() and
+ * the one-game update, and each export format must read back, checksum
+ * included, as exactly the ratings in the system. A Timeline must read
+ * back, after a reopen, the stored values and current RD of every player at
+ * every period it recorded.
+ */
+
+#ifdef GLICKO2_STATS
+size_t allocations_so_far ()
+{ return Stats::Get_Count(Stats::ALLOCATIONS); }
+#else
+std::atomic<size_t> allocations { 0 };
+
+size_t allocations_so_far ()
+{ return allocations; }
+
+// kept out of line, or GCC sees the malloc/free pair inlined into callers
+// of the builtin operator new and warns of a mismatch
+__attribute__((noinline))
+void* operator new (size_t size)
+{
+	++allocations;
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc{};
+}
+
+__attribute__((noinline))
+void operator delete (void* p) noexcept
+{ std::free(p); }
+
+__attribute__((noinline))
+void operator delete (void* p, size_t) noexcept
+{ std::free(p); }
+#endif
+
+// what a check found; the detail says what was compared
+struct Check
+{
+	const char* name;
+	bool passed;
+	std::string detail;
+};
+
+__attribute__((format(printf, 1, 2)))
+std::string format (const char* fmt, ...)
+{
+	char text[256];
+	va_list args;
+	va_start(args, fmt);
+	std::vsnprintf(text, sizeof(text), fmt, args);
+	va_end(args);
+	return text;
+}
+
+size_t allocations_during (const std::function<void()>& body)
+{
+	size_t before = allocations_so_far();
+	body();
+	return allocations_so_far() - before;
+}
+
+struct Result
+{
+	std::string name;
+	double seconds;		// median over the repetitions
+	size_t items;		// items handled per repetition
+	const char* unit;	// what an item is: player, match or call
+	const char* units;
+	size_t allocations;	// in the last repetition
+	long peak_rss_kb;
+};
+
+long peak_rss_kb ()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+// times body() `repeat` times, calling setup() untimed before each run
+Result measure (const char* name, int repeat, size_t items, const char* unit, const char* units, const std::function<void()>& setup, const std::function<void()>& body)
+{
+	std::vector<double> times;
+	times.reserve(repeat);
+	size_t allocated = 0;
+	for (int r = 0; r < repeat; r++)
+	{
+		setup();
+		size_t before = allocations_so_far();
+		auto start = std::chrono::steady_clock::now();
+		body();
+		times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		allocated = allocations_so_far() - before;
+	}
+	std::sort(times.begin(), times.end());
+	return Result{ name, times[times.size()/2], items, unit, units, allocated, peak_rss_kb() };
+}
+
+// how many doubles lie between a and b
+uint64_t ulps_apart (double a, double b)
+{
+	auto ordered = [](double x)
+	{
+		int64_t bits;
+		std::memcpy(&bits, &x, sizeof(bits));
+		return bits < 0 ? INT64_MIN - bits : bits;
+	};
+	int64_t x = ordered(a), y = ordered(b);
+	return x > y ? uint64_t(x) - uint64_t(y) : uint64_t(y) - uint64_t(x);
+}
+
+double relative_difference (double a, double b)
+{ return std::fabs(a - b) / std::max(std::fabs(a), std::fabs(b)); }
+
+// the league after one full period, rated with the given kernel
+std::unique_ptr<Glicko2> rate_period (const SyntheticLeague_Config& config, Kernel::ISA isa, Glicko2::Precision precision)
+{
+	Kernel::Select_ISA(isa);
+	SyntheticLeague league { config };
+	std::unique_ptr<Glicko2> system { new Glicko2 };
+	league.Populate(*system);
+	system->Set_Precision(precision);
+	league.Play_Period(*system);
+	system->Run();
+	return system;
+}
+
+// every player's ratings written out at full precision, with some rows
+// ending in CRLF, some blank lines and no final newline, then a row with a
+// bad RD: read back twice with one reader, the second time counting
+// allocations
+Check check_csv_reader (const Glicko2& system, const std::string& filename)
+{
+	FILE* file = std::fopen(filename.c_str(), "w");
+	if (!file)
+		return Check{ "csv_reader", false, "could not write " + filename };
+	size_t line = 0;
+	for (uint32_t id = 0; id < system.Num_Players(); id++)
+	{
+		Glicko2::Player_Ref player = system.Get_Player_Ref(id);
+		std::fprintf(file, "%s,%.17g,%.17g,%.17g%s\n", player.name.c_str(), player.rating, player.rd, player.vol, id % 7 == 0 ? "\r" : "");
+		++line;
+		if (id % 100 == 99)
+		{
+			std::fputs("\n", file);
+			++line;
+		}
+	}
+	size_t bad_line = line + 1;
+	std::fputs("bad,1500,x,0.06", file);
+	std::fclose(file);
+
+	CsvReader reader;
+	size_t mismatches = 0, reported_line = 0, allocated = 0;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		size_t before = allocations_so_far();
+		reader.Open(filename.c_str());
+		mismatches = 0;
+		uint32_t id = 0;
+		double rating, rd, vol;
+		while (reader.Next_Row())
+		{
+			if (id == system.Num_Players())
+			{
+				if (reader.Get_Double(2, rd))
+					++mismatches;
+				reported_line = reader.Get_Line();
+				continue;
+			}
+			Glicko2::Player_Ref player = system.Get_Player_Ref(id++);
+			if (reader.Num_Fields() != 4 || reader.Field(0) != player.name || !reader.Get_Double(1, rating) || !reader.Get_Double(2, rd) || !reader.Get_Double(3, vol)
+				|| rating != player.rating || rd != player.rd || vol != player.vol)
+				++mismatches;
+		}
+		mismatches += id != system.Num_Players();
+		reader.Close();
+		if (pass == 1)
+			allocated = allocations_so_far() - before;
+	}
+	std::remove(filename.c_str());
+
+	return Check{ "csv_reader", mismatches == 0 && reported_line == bad_line && allocated == 0,
+		format("%zu rows read back, %zu mismatched; bad row reported at line %zu, expected %zu; %zu allocations on the second read", size_t{system.Num_Players()}, mismatches, reported_line, bad_line, allocated) };
+}
+
+// a player with names too long to be stored inline, built with the rvalue
+// Add_Match() and entered with the rvalue Add_Player(): the system must
+// end up holding the strings that were built, not copies of them
+Check check_move_mutation ()
+{
+	const uint32_t OPPONENTS = 8;
+	std::vector<const char*> built;
+	Player player { "a player whose name is not short" };
+	built.push_back(player.Get_Name().data());
+	for (uint32_t i = 0; i < OPPONENTS; i++)
+	{
+		Player opponent { "an opponent whose name is not short " + std::to_string(i) };
+		built.push_back(opponent.Get_Name().data());
+		player.Add_Match(std::move(opponent), i % 2);
+	}
+
+	size_t in_history = 0;
+	for (uint32_t i = 0; i < OPPONENTS; i++)
+		in_history += player.Get_Match_History()[i].first.Get_Name().data() == built[i + 1];
+
+	Glicko2 system;
+	system.Add_Player(std::move(player));
+	size_t in_store = 0;
+	for (uint32_t id = 0; id < system.Get_Store().Size() && id < built.size(); id++)
+		in_store += system.Get_Store().Get_Name(id).data() == built[id];
+
+	return Check{ "move_mutation", in_history == OPPONENTS && in_store == built.size(),
+		format("%zu of %u names moved by Add_Match(Player&&), %zu of %zu by Add_Player(Player&&)", in_history, OPPONENTS, in_store, built.size()) };
+}
+
+// records an IngestQueue can't hand to the system, whether for an unknown
+// player or a score out of range, must be dropped and counted as invalid,
+// and rate no one; the one good record must still be rated
+Check check_ingest_invalid ()
+{
+	Glicko2 system;
+	for (const char* name : { "a", "b", "c" })
+		system.Add_Player(Player{ name });
+
+	IngestQueue queue { 8 };
+	queue.Push(0, 1, 1);
+	queue.Push(1, 2, system.Get_Max_Score() + 1);
+	queue.Push(2, 0, -1);
+	queue.Push(0, 9, 1);
+	queue.Seal();
+	queue.Drain(system);
+
+	const RatingStore& store = system.Get_Store();
+	bool rated = store.Get_Rating(0) != 1500 && store.Get_Rating(1) == 1500 && store.Get_Rating(2) == 1500;
+	return Check{ "ingest_invalid", queue.Get_Invalid() == 3 && queue.Get_Closed() == 1 && rated,
+		format("%llu of 4 records invalid, %llu periods closed, ratings %.1f %.1f %.1f", static_cast<unsigned long long>(queue.Get_Invalid()),
+			static_cast<unsigned long long>(queue.Get_Closed()), store.Get_Rating(0), store.Get_Rating(1), store.Get_Rating(2)) };
+}
+
+// a Run() keeps the matches it rated: a Close_Period() after it must
+// refuse and change nothing, in a copy loaded from a snapshot too, and
+// once Clear_Matches() has dropped them, must rate only the games recorded
+// since, exactly as a system holding just those would
+Check check_run_then_close (const std::string& snapshot_file)
+{
+	const uint32_t PLAYERS = 50;
+	Glicko2 system;
+	for (uint32_t id = 0; id < PLAYERS; id++)
+		system.Add_Player(Player{ "p" + std::to_string(id), 1500.0 + id * 7 % 300, 80.0 + id % 200, 0.06 });
+	for (uint32_t id = 0; id < PLAYERS; id++)
+	{
+		system.Add_Match(id, (id + 1) % PLAYERS, id % 2);
+		system.Add_Match((id + 1) % PLAYERS, id, 1 - id % 2);
+	}
+	system.Run();
+
+	system.Add_Match(0, 1, 1);
+	double rating = system.Get_Store().Get_Rating(0);
+	bool refused = !system.Close_Period() && system.Get_Period() == 1 && system.Get_Store().Get_Rating(0) == rating;
+	Snapshot snapshot;
+	Glicko2 loaded;
+	bool reloaded = Snapshot::Write(snapshot_file.c_str(), system) == Snapshot::OK && snapshot.Open(snapshot_file.c_str()) == Snapshot::OK;
+	if (reloaded)
+		loaded.Load(snapshot);
+	snapshot.Close();
+	std::remove(snapshot_file.c_str());
+	bool refused_loaded = reloaded && loaded.Has_Rated_Matches() && !loaded.Close_Period();
+
+	system.Clear_Matches();
+	Glicko2 fresh;
+	for (uint32_t id = 0; id < PLAYERS; id++)
+	{
+		Glicko2::Player_Ref player = system.Get_Player_Ref(id);
+		fresh.Add_Player(Player{ player.name, player.rating, player.rd, player.vol });
+	}
+	system.Add_Match(0, 1, 1);
+	fresh.Add_Match(0, 1, 1);
+	bool closed = system.Close_Period() && fresh.Close_Period();
+	size_t differences = 0;
+	for (uint32_t id = 0; id < PLAYERS; id++)
+	{
+		Glicko2::Player_Ref a = system.Get_Player_Ref(id), b = fresh.Get_Player_Ref(id);
+		differences += a.rating != b.rating || a.rd != b.rd || a.vol != b.vol;
+	}
+
+	return Check{ "run_then_close", refused && refused_loaded && closed && differences == 0,
+		format("close after Run() %s, after a snapshot %s; after Clear_Matches() %s, %zu of %u players unlike a system with only the new game",
+			refused ? "refused" : "accepted", refused_loaded ? "refused" : "accepted", closed ? "closed" : "refused", differences, PLAYERS) };
+}
+
+// a fresh copy of the league, rated until its columns and arenas have
+// grown to a period's needs: from then on a Run(), a Run() of one player
+// and a Close_Period() must not allocate
+Check check_warm_periods (const SyntheticLeague_Config& config, unsigned threads, Glicko2::Precision precision, Glicko2::Accuracy accuracy)
+{
+	const int WARM_PERIODS = 4;
+	SyntheticLeague league { config };
+	Glicko2 system;
+	league.Populate(system);
+	system.Set_Threads(threads);
+	system.Set_Precision(precision);
+	system.Set_Accuracy(accuracy);
+
+	// a Run() rates the same games again, so one warms it; periods each
+	// have games of their own, so closing takes a few
+	league.Play_Period(system);
+	system.Run();
+	size_t run = allocations_during([&]{ system.Run(); });
+	system.Run(league.Get_Name(0));
+	size_t single_run = allocations_during([&]{ system.Run(league.Get_Name(0)); });
+	size_t close_period = 0;
+	system.Clear_Matches();
+	for (int p = 0; p <= WARM_PERIODS; p++)
+	{
+		league.Play_Period(system);
+		close_period = allocations_during([&]{ system.Close_Period(); });
+	}
+
+	return Check{ "warm_periods", run == 0 && single_run == 0 && close_period == 0,
+		format("allocations when warm: %zu in Run(), %zu in Run(name), %zu in Close_Period() after %d periods", run, single_run, close_period, WARM_PERIODS) };
+}
+
+// players, stats and matches that differ between two systems
+size_t count_differences (const Glicko2& a, const Glicko2& b)
+{
+	const RatingStore& x = a.Get_Store();
+	const RatingStore& y = b.Get_Store();
+	if (x.Size() != y.Size())
+		return std::max(x.Size(), y.Size());
+
+	size_t differences = 0;
+	std::vector<std::pair<uint32_t, int>> matches_a, matches_b;
+	for (uint32_t id = 0; id < x.Size(); id++)
+	{
+		matches_a.clear();
+		matches_b.clear();
+		if (x.Is_Member(id))
+			a.For_Each_Match(id, [&](const Glicko2::Player_Ref& opp, int score) { matches_a.push_back({ opp.id, score }); });
+		if (y.Is_Member(id))
+			b.For_Each_Match(id, [&](const Glicko2::Player_Ref& opp, int score) { matches_b.push_back({ opp.id, score }); });
+		differences += x.Get_Name(id) != y.Get_Name(id) || x.Get_Rating(id) != y.Get_Rating(id) || x.Get_RD(id) != y.Get_RD(id)
+			|| x.Get_Vol(id) != y.Get_Vol(id) || x.Is_Member(id) != y.Is_Member(id) || matches_a != matches_b;
+	}
+	return differences;
+}
+
+// a snapshot of a system whose idle players still owe RD inflation must
+// load as the same system, period clock included: same stored values and
+// rated periods, and the same ratings after one more period on both
+Check check_snapshot_periods (const std::string& snapshot_file)
+{
+	const uint32_t PLAYERS = 200, PERIODS = 4;
+	Glicko2 system;
+	for (uint32_t id = 0; id < PLAYERS; id++)
+		system.Add_Player(Player{ "p" + std::to_string(id), 1500.0 + id * 13 % 400, 60.0 + id % 250, 0.06 });
+	// in period p only the players with id % 4 >= p play, so by the end
+	// most owe a period or more of RD inflation
+	for (uint32_t p = 0; p < PERIODS; p++)
+	{
+		for (uint32_t id = 0; id < PLAYERS; id++)
+			if (id % 4 >= p)
+				system.Add_Match(id, (id + 4) % PLAYERS, (id + p) % 2);
+		system.Close_Period();
+	}
+
+	Snapshot snapshot;
+	Glicko2 loaded;
+	bool reloaded = Snapshot::Write(snapshot_file.c_str(), system) == Snapshot::OK && snapshot.Open(snapshot_file.c_str()) == Snapshot::OK;
+	if (reloaded)
+		loaded.Load(snapshot);
+	snapshot.Close();
+	std::remove(snapshot_file.c_str());
+
+	uint32_t period = system.Get_Period(), loaded_period = loaded.Get_Period();
+	size_t differences = reloaded ? count_differences(system, loaded) : PLAYERS;
+	size_t periods_apart = 0;
+	for (uint32_t id = 0; reloaded && id < PLAYERS; id++)
+		periods_apart += system.Get_Rated_Period(id) != loaded.Get_Rated_Period(id) || system.Get_Current_RD(id) != loaded.Get_Current_RD(id);
+
+	for (Glicko2* copy : { &system, &loaded })
+	{
+		for (uint32_t id = 0; id < PLAYERS; id += 2)
+			copy->Add_Match(id, id + 1, id % 3 == 0);
+		copy->Close_Period();
+	}
+	size_t differences_after = reloaded ? count_differences(system, loaded) : PLAYERS;
+
+	return Check{ "snapshot_periods", reloaded && loaded_period == period && differences == 0 && periods_apart == 0 && differences_after == 0,
+		format("period %u loaded as %u; %zu of %u players unlike the original, %zu with another rated period or current RD, %zu after one more period",
+			period, loaded_period, differences, PLAYERS, periods_apart, differences_after) };
+}
+
+// the first players of the league written out as the client keeps them, a
+// system CSV and a results file per player, then loaded by CsvLoader with
+// one reader and with several; both must build the system a serial load
+// does, a Player per row entered in order. Then two results files get a
+// bad row: the loader must report the earlier one in file order, at its
+// line, and add nothing
+Check check_parallel_load (const Glicko2& system, const std::string& directory)
+{
+	const uint32_t LOADED = 2000;
+	const unsigned READERS = 4;
+	uint32_t count = std::min<size_t>(system.Num_Players(), LOADED);
+	if (mkdir(directory.c_str(), 0700) != 0)
+		return Check{ "parallel_load", false, "could not create " + directory };
+
+	std::string system_file = directory + "/system.csv";
+	std::vector<std::string> results_files;
+	FILE* out = std::fopen(system_file.c_str(), "w");
+	Glicko2 serial;
+	for (uint32_t id = 0; id < count && out; id++)
+	{
+		Glicko2::Player_Ref player = system.Get_Player_Ref(id);
+		results_files.push_back(std::to_string(id) + "-results.csv");
+		std::fprintf(out, "%s,%.17g,%.17g,%.17g,%s\n", player.name.c_str(), player.rating, player.rd, player.vol, results_files.back().c_str());
+
+		Player entered { player.name, player.rating, player.rd, player.vol };
+		FILE* results = std::fopen((directory + "/" + results_files.back()).c_str(), "w");
+		system.For_Each_Match(id, [&](const Glicko2::Player_Ref& opp, int score)
+		{
+			if (results)
+				std::fprintf(results, "%s,%.17g,%.17g,%.17g,%d\n", opp.name.c_str(), opp.rating, opp.rd, opp.vol, score);
+			entered.Add_Match(Player{ opp.name, opp.rating, opp.rd, opp.vol }, score);
+		});
+		if (results)
+			std::fclose(results);
+		serial.Add_Player(std::move(entered));
+	}
+	if (out)
+		std::fclose(out);
+
+	CsvLoader one { 1, directory + "/" }, several { READERS, directory + "/" };
+	Glicko2 loaded_one, loaded_several;
+	int status_one = one.Load(system_file.c_str(), loaded_one);
+	int status_several = several.Load(system_file.c_str(), loaded_several);
+	size_t differences_one = count_differences(serial, loaded_one), differences_several = count_differences(serial, loaded_several);
+
+	// a bad row at the end of a file early in the system CSV and one late
+	uint32_t first = count / 4, second = count - 1;
+	for (uint32_t id : { second, first })
+		if (FILE* results = std::fopen((directory + "/" + results_files[id]).c_str(), "a"))
+		{
+			std::fputs("bad,row\n", results);
+			std::fclose(results);
+		}
+	Glicko2 failed;
+	int status_bad = several.Load(system_file.c_str(), failed);
+	size_t bad_line = system.Num_Matches(first) + 1;
+	bool reported = status_bad == CsvLoader::BAD_RESULTS_ROW && several.Get_Error_File() == results_files[first] && several.Get_Error_Line() == bad_line && failed.Get_Store().Size() == 0;
+
+	for (const std::string& file : results_files)
+		std::remove((directory + "/" + file).c_str());
+	std::remove(system_file.c_str());
+	rmdir(directory.c_str());
+
+	return Check{ "parallel_load", status_one == CsvLoader::OK && status_several == CsvLoader::OK && differences_one == 0 && differences_several == 0 && reported,
+		format("%u players: %zu differences with 1 reader, %zu with %u; bad rows reported at %s:%zu, expected %s:%zu", count, differences_one, differences_several, READERS,
+			several.Get_Error_File().c_str(), several.Get_Error_Line(), results_files[first].c_str(), bad_line) };
+}
+
+// the system broadcast as a snapshot to SHARDS processes, each rating the
+// players it owns, as the client's --shards does; merging their results
+// must come to the very store a Run() of the snapshot does
+Check check_shards (const Glicko2& system, const std::string& directory)
+{
+	const unsigned SHARDS = 3;
+	if (mkdir(directory.c_str(), 0700) != 0)
+		return Check{ "shards", false, "could not create " + directory };
+
+	std::string snapshot_file = directory + "/system.snapshot";
+	Snapshot snapshot;
+	bool ok = Snapshot::Write(snapshot_file.c_str(), system) == Snapshot::OK && snapshot.Open(snapshot_file.c_str()) == Snapshot::OK;
+
+	std::vector<std::string> shard_files;
+	std::vector<pid_t> workers;
+	for (unsigned k = 0; ok && k < SHARDS; k++)
+	{
+		shard_files.push_back(directory + "/" + std::to_string(k) + ".shard");
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			Glicko2 worker;
+			worker.Load(snapshot);
+			Shard result;
+			worker.Run_Shard(k, SHARDS, result);
+			result.Set_Source(snapshot.Get_Checksum());
+			_exit(result.Write(shard_files.back().c_str()) == Shard::OK ? 0 : 1);
+		}
+		if (pid < 0)
+			ok = false;
+		else
+			workers.push_back(pid);
+	}
+	unsigned failed = 0;
+	for (pid_t pid : workers)
+	{
+		int status;
+		failed += waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+	}
+
+	std::vector<Shard> shards (SHARDS);
+	for (unsigned k = 0; ok && failed == 0 && k < SHARDS; k++)
+		ok = shards[k].Read(shard_files[k].c_str()) == Shard::OK;
+	Glicko2 run, merged;
+	bool merged_ok = false;
+	size_t differences = 0;
+	if (ok && failed == 0)
+	{
+		run.Load(snapshot);
+		run.Run();
+		merged.Load(snapshot);
+		merged_ok = merged.Merge_Shards(shards);
+		differences = count_differences(run, merged) + (run.Get_Period() != merged.Get_Period());
+	}
+
+	snapshot.Close();
+	for (const std::string& file : shard_files)
+		std::remove(file.c_str());
+	std::remove(snapshot_file.c_str());
+	rmdir(directory.c_str());
+
+	return Check{ "shards", ok && failed == 0 && merged_ok && differences == 0,
+		format("%zu players in %u shard processes, %u failed; merge %s, %zu differences from Run()", system.Get_Store().Size(), SHARDS, failed,
+			merged_ok ? "accepted" : "refused", differences) };
+}
+
+// a league where every player meets six opponents GAMES times each, rated
+// twice: once with each pairing's wins and losses recorded in a row, so
+// they become runs rated once per opponent with the games as weights, and
+// once with the games interleaved round by round, so that no two of a
+// player's games in a row are against the same opponent and each is rated
+// on its own
+Check check_run_aggregation (uint64_t seed)
+{
+	const uint32_t PLAYERS = 2000, GAMES = 8;
+	struct Pairing
+	{
+		uint32_t player;
+		uint32_t opponent;
+		uint32_t wins;
+	};
+	std::vector<Pairing> pairings;
+	uint64_t state = seed;
+	for (uint32_t player = 0; player < PLAYERS; player++)
+		for (uint32_t step = 1; step <= 3; step++)
+		{
+			state = state * 6364136223846793005ull + 1442695040888963407ull;
+			pairings.push_back(Pairing{ player, (player + step) % PLAYERS, uint32_t(state >> 33) % (GAMES + 1) });
+		}
+
+	Glicko2 runs, games;
+	for (uint32_t id = 0; id < PLAYERS; id++)
+	{
+		Player player { "p" + std::to_string(id), 1500.0 + id % 400, 50.0 + id % 300, 0.06 };
+		runs.Add_Player(player);
+		games.Add_Player(std::move(player));
+	}
+	for (const Pairing& pairing : pairings)
+	{
+		for (uint32_t game = 0; game < GAMES; game++)
+			runs.Add_Match(pairing.player, pairing.opponent, game < pairing.wins);
+		for (uint32_t game = 0; game < GAMES; game++)
+			runs.Add_Match(pairing.opponent, pairing.player, game >= pairing.wins);
+	}
+	for (uint32_t game = 0; game < GAMES; game++)
+		for (const Pairing& pairing : pairings)
+		{
+			int score = game < pairing.wins;
+			games.Add_Match(pairing.player, pairing.opponent, score);
+			games.Add_Match(pairing.opponent, pairing.player, 1 - score);
+		}
+	size_t num_games = runs.Get_Matches().Size(), run_records = runs.Get_Matches().Num_Runs(), game_records = games.Get_Matches().Num_Runs();
+	runs.Run();
+	games.Run();
+
+	uint64_t rating_ulps = 0, rd_ulps = 0;
+	double vol_difference = 0, worst = 0;
+	for (uint32_t id = 0; id < PLAYERS; id++)
+	{
+		Glicko2::Player_Ref a = runs.Get_Player_Ref(id), b = games.Get_Player_Ref(id);
+		uint64_t player_rating_ulps = ulps_apart(a.rating, b.rating), player_rd_ulps = ulps_apart(a.rd, b.rd);
+		double player_vol_difference = relative_difference(a.vol, b.vol);
+		rating_ulps = std::max(rating_ulps, player_rating_ulps);
+		rd_ulps = std::max(rd_ulps, player_rd_ulps);
+		vol_difference = std::max(vol_difference, player_vol_difference);
+		// every game on its own is an opponent to the per-game rating
+		worst = std::max({ worst, std::max(player_rating_ulps, player_rd_ulps) / Kernel::Ulp_Tolerance(runs.Num_Matches(id)), player_vol_difference / Volatility::EPSILON });
+	}
+
+	return Check{ "run_aggregation", run_records < num_games && game_records == num_games && worst <= 1,
+		format("%zu games in %zu runs vs %zu records; up to %llu ULPs apart in rating, %llu in RD, %.3g in volatility, %.3g of the tolerance",
+			num_games, run_records, game_records, static_cast<unsigned long long>(rating_ulps), static_cast<unsigned long long>(rd_ulps), vol_difference, worst) };
+}
+
+// leagues of different sizes and taus, each closing on its own clock, in
+// one LeagueSet and as one Glicko2 per league: every player must end up
+// with the same rating, RD and volatility, bit for bit; and a LeagueSet
+// must turn down unknown leagues and scores that aren't 0 or 1
+Check check_leagues (uint64_t seed, unsigned threads)
+{
+	const uint32_t LEAGUES = 60, PERIODS = 6;
+	LeagueSet leagues { threads };
+	std::vector<std::unique_ptr<Glicko2>> instances;
+	std::vector<uint32_t> first;
+	for (uint32_t l = 0; l < LEAGUES; l++)
+	{
+		double tau = 0.3 + 0.9 * l / LEAGUES;
+		uint32_t size = 2 + l % 23;
+		leagues.Add_League(tau);
+		instances.emplace_back(new Glicko2{ tau });
+		first.push_back(leagues.Num_Players());
+		for (uint32_t i = 0; i < size; i++)
+		{
+			double rating = 1400.0 + (l * 37 + i * 11) % 200, rd = 60.0 + (l + i * 7) % 250;
+			std::string name = "p" + std::to_string(i);
+			leagues.Add_Player(l, name, rating, rd, 0.06);
+			instances.back()->Add_Player(Player{ name, rating, rd, 0.06 });
+		}
+	}
+
+	// a league sits out every third period, so its games carry over to its
+	// next close and its idle players' RDs grow meanwhile
+	uint64_t state = seed;
+	for (uint32_t period = 0; period < PERIODS; period++)
+	{
+		for (uint32_t l = 0; l < LEAGUES; l++)
+		{
+			uint32_t size = leagues.Num_Players(l);
+			for (uint32_t game = 0; game < size; game++)
+			{
+				state = state * 6364136223846793005ull + 1442695040888963407ull;
+				uint32_t a = (state >> 33) % size, b = (a + 1 + (state >> 13) % (size - 1)) % size;
+				int score = (state >> 7) & 1;
+				leagues.Add_Match(first[l] + a, first[l] + b, score);
+				leagues.Add_Match(first[l] + b, first[l] + a, 1 - score);
+				instances[l]->Add_Match(a, b, score);
+				instances[l]->Add_Match(b, a, 1 - score);
+			}
+			if ((period + l) % 3 != 0)
+			{
+				leagues.Schedule_Close(l);
+				instances[l]->Close_Period();
+			}
+		}
+		leagues.Close_Due();
+	}
+
+	size_t differences = 0, periods_apart = 0;
+	for (uint32_t l = 0; l < LEAGUES; l++)
+	{
+		const Glicko2& instance = *instances[l];
+		periods_apart += leagues.Get_Period(l) != instance.Get_Period();
+		for (uint32_t i = 0; i < leagues.Num_Players(l); i++)
+		{
+			uint32_t id = first[l] + i;
+			differences += leagues.Get_Rating(id) != instance.Get_Store().Get_Rating(i) || leagues.Get_Current_RD(id) != instance.Get_Current_RD(i)
+				|| leagues.Get_Vol(id) != instance.Get_Store().Get_Vol(i);
+		}
+	}
+
+	bool turned_down = leagues.Add_Player(LEAGUES, "p0") == LeagueSet::npos && !leagues.Schedule_Close(LEAGUES) && !leagues.Set_Tau(LEAGUES, 0.5)
+		&& !leagues.Add_Match(first[1], first[1] + 1, 2) && !leagues.Add_Match(first[1], first[1] + 1, -1);
+	return Check{ "leagues", differences == 0 && periods_apart == 0 && turned_down,
+		format("%zu players in %u leagues over %u periods: %zu differ from one Glicko2 per league, %zu leagues on another period; bad arguments %s",
+			leagues.Num_Players(), LEAGUES, PERIODS, differences, periods_apart, turned_down ? "turned down" : "accepted") };
+}
+
+// a RankIndex re-keyed in batches small enough to move players one at a
+// time, splitting blocks and emptying them, and in ones large enough to be
+// merged in bulk, with new players among them and many tied keys: after
+// each batch its order, ranks and key ranges must be those of a sort
+Check check_rank_index (uint64_t seed)
+{
+	const uint32_t PLAYERS = 5000, SMALL = 150, LARGE = 1200;
+	RankIndex index;
+	std::vector<double> key_of (PLAYERS + LARGE);
+	std::vector<uint32_t> ids;
+	std::vector<double> keys;
+	uint64_t state = seed;
+	auto random = [&]
+	{
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		return uint32_t(state >> 33);
+	};
+	auto rekey = [&](uint32_t id, double key)
+	{
+		ids.push_back(id);
+		keys.push_back(key);
+		key_of[id] = key;
+	};
+
+	for (uint32_t id = 0; id < PLAYERS; id++)
+		rekey(id, 1000 + random() % 1000);
+	index.Build(ids.data(), keys.data(), ids.size());
+	uint32_t indexed = PLAYERS;
+
+	std::vector<std::pair<double, uint32_t>> sorted;
+	std::vector<uint32_t> order;
+	size_t mismatches = 0, batches = 0;
+	auto compare = [&]
+	{
+		sorted.clear();
+		for (uint32_t id = 0; id < indexed; id++)
+			sorted.push_back({ key_of[id], id });
+		std::sort(sorted.begin(), sorted.end(), [](const std::pair<double, uint32_t>& a, const std::pair<double, uint32_t>& b)
+		{ return a.first != b.first ? a.first > b.first : a.second < b.second; });
+		order.assign(index.Size(), 0);
+		index.Copy_Order(order.data());
+
+		size_t wrong = index.Size() != sorted.size() || index.Rank_Of(indexed) != RankIndex::npos;
+		for (size_t rank = 0; !wrong && rank < sorted.size(); rank++)
+			wrong += index.At(rank) != sorted[rank].second || index.Key_At(rank) != sorted[rank].first || order[rank] != sorted[rank].second
+				|| index.Rank_Of(sorted[rank].second) != rank;
+		for (int range = 0; !wrong && range < 20; range++)
+		{
+			double low = 900 + random() % 1200, high = low + random() % 300;
+			size_t first = std::partition_point(sorted.begin(), sorted.end(), [=](const std::pair<double, uint32_t>& e) { return e.first > high; }) - sorted.begin();
+			size_t last = std::partition_point(sorted.begin(), sorted.end(), [=](const std::pair<double, uint32_t>& e) { return e.first >= low; }) - sorted.begin();
+			wrong += index.Range(low, high) != std::make_pair(first, std::max(first, last));
+		}
+		mismatches += wrong != 0;
+		++batches;
+	};
+	compare();
+
+	// the best players sink to the bottom in small batches, emptying the
+	// top blocks and splitting the last
+	for (int batch = 0; batch < 3; batch++)
+	{
+		ids.clear();
+		keys.clear();
+		for (uint32_t i = 0; i < SMALL; i++)
+			rekey(index.At(i), 500 + random() % 10);
+		index.Update(ids.data(), keys.data(), ids.size());
+		compare();
+	}
+	// small batches of random players, some of them new
+	for (int batch = 0; batch < 10; batch++)
+	{
+		ids.clear();
+		keys.clear();
+		for (uint32_t i = 0; i < SMALL - 10; i++)
+		{
+			uint32_t id = random() % indexed;
+			if (std::find(ids.begin(), ids.end(), id) == ids.end())
+				rekey(id, 1000 + random() % 1000);
+		}
+		for (uint32_t i = 0; i < 10; i++)
+			rekey(indexed++, 1000 + random() % 1000);
+		index.Update(ids.data(), keys.data(), ids.size());
+		compare();
+	}
+	// one large batch, merged in bulk, again with new players
+	ids.clear();
+	keys.clear();
+	for (uint32_t id = 0; id < indexed; id += 6)
+		rekey(id, 1000 + random() % 1000);
+	while (ids.size() < LARGE && indexed < key_of.size())
+		rekey(indexed++, 1000 + random() % 1000);
+	index.Update(ids.data(), keys.data(), ids.size());
+	compare();
+
+	return Check{ "rank_index", mismatches == 0,
+		format("%zu of %zu batches with a rank, key, order or range unlike a sort of %u players", mismatches, batches, indexed) };
+}
+
+// random pairings of the league's first players, after a few periods
+// that only half of them played, so the others' RDs have grown unwritten:
+// Predict() must give the expected score of the scalar E() to within
+// Kernel::Ulp_Tolerance(1), and the change a win or a loss brings to
+// within a billionth of a point of the one-game update with the volatility
+// held; against the player really rated on that one game, volatility and
+// all, it must be under a point off
+Check check_predict (const Glicko2& league, uint64_t seed)
+{
+	const size_t PLAYERS = 2000, PERIODS = 3, PAIRS = 1000, RATED = 100;
+	typedef Engine<double> Math;
+	Glicko2 system { league.Get_Tau() };
+	uint32_t count = std::min(league.Num_Players(), PLAYERS);
+	for (uint32_t id = 0; id < count; id++)
+	{
+		Glicko2::Player_Ref player = league.Get_Player_Ref(id);
+		system.Add_Player(Player{ player.name, player.rating, player.rd, player.vol });
+	}
+	uint64_t state = seed;
+	for (size_t period = 0; period < PERIODS; period++)
+	{
+		for (uint32_t id = 0; id + 2 < count; id += 2)
+		{
+			state = state * 6364136223846793005ull + 1442695040888963407ull;
+			system.Add_Match(id, id + 2, (state >> 33) & 1);
+		}
+		system.Close_Period();
+	}
+
+	std::vector<uint32_t> players (PAIRS), opponents (PAIRS);
+	for (size_t i = 0; i < PAIRS; i++)
+	{
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		players[i] = (state >> 32) % system.Num_Players();
+		opponents[i] = ((state & 0xFFFFFFFF) % (system.Num_Players() - 1) + players[i] + 1) % system.Num_Players();
+	}
+	std::vector<double> expected (PAIRS), win_change (PAIRS), loss_change (PAIRS);
+	system.Predict(players.data(), opponents.data(), PAIRS, expected.data(), win_change.data(), loss_change.data());
+
+	uint64_t expected_ulps = 0;
+	double held_difference = 0, rated_difference = 0;
+	for (size_t i = 0; i < PAIRS; i++)
+	{
+		Glicko2::Player_Ref player = system.Get_Player_Ref(players[i]), opponent = system.Get_Player_Ref(opponents[i]);
+		double mu = Math::Mu(player.rating), phi = Math::Phi(player.rd), mu_j = Math::Mu(opponent.rating), phi_j = Math::Phi(opponent.rd);
+		double E = Math::E(mu, mu_j, phi_j), g = Math::g(phi_j);
+		double phi_new2 = 1 / (1 / (phi*phi + player.vol*player.vol) + g*g * E * (1 - E));
+		expected_ulps = std::max(expected_ulps, ulps_apart(expected[i], E));
+		held_difference = std::max({ held_difference, std::fabs(win_change[i] - Math::SCALE * phi_new2 * g * (1 - E)),
+			std::fabs(loss_change[i] + Math::SCALE * phi_new2 * g * E) });
+
+		if (i >= RATED)
+			continue;
+		for (int won = 0; won < 2; won++)
+		{
+			Glicko2 one { system.Get_Tau() };
+			one.Set_Scoring(system.Get_Scoring());
+			one.Add_Player(Player{ player.name, player.rating, player.rd, player.vol });
+			one.Add_Player(Player{ opponent.name, opponent.rating, opponent.rd, opponent.vol });
+			one.Add_Match(0, 1, won ? one.Get_Max_Score() : 0);
+			one.Run(player.name);
+			double change = one.Get_Player_Ref(0).rating - player.rating;
+			rated_difference = std::max(rated_difference, std::fabs(change - (won ? win_change[i] : loss_change[i])));
+		}
+	}
+
+	return Check{ "predict", expected_ulps <= Kernel::Ulp_Tolerance(1) && held_difference <= 1e-9 && rated_difference < 1,
+		format("%zu pairs: expected scores up to %llu ULPs from E(), changes up to %.3g points from the held-volatility update; %zu rated on the game, up to %.3g points off",
+			PAIRS, static_cast<unsigned long long>(expected_ulps), held_difference, RATED, rated_difference) };
+}
+
+// the league exported in each format and read back: the CSV rows with
+// CsvReader, the JSON Lines objects with their opponents and scores, and
+// the binary columns after verifying the header and checksum; every player
+// must come back in name order with their name, rating, current RD and
+// volatility exactly as the system has them
+Check check_exports (const Glicko2& system, unsigned threads, const std::string& filename)
+{
+	Exporter exporter { threads };
+	const std::vector<uint32_t>& order = system.Get_Name_Order();
+	auto differs = [&](size_t row, std::string_view name, double rating, double rd, double vol)
+	{
+		if (row >= order.size())
+			return true;
+		Glicko2::Player_Ref player = system.Get_Player_Ref(order[row]);
+		return name != player.name || rating != player.rating || rd != player.rd || vol != player.vol;
+	};
+	auto read_file = [](const std::string& filename)
+	{
+		std::string contents;
+		if (FILE* file = std::fopen(filename.c_str(), "rb"))
+		{
+			char buffer[1 << 16];
+			size_t read;
+			while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+				contents.append(buffer, read);
+			std::fclose(file);
+		}
+		return contents;
+	};
+
+	// CSV: name,rating,rd,volatility, and no results file
+	size_t csv_rows = 0, csv_mismatches = 0;
+	int csv_status = exporter.Write(filename.c_str(), system, Exporter::CSV);
+	CsvReader reader;
+	if (csv_status == Exporter::OK && reader.Open(filename.c_str()))
+	{
+		double rating = 0, rd = 0, vol = 0;
+		while (reader.Next_Row())
+			csv_mismatches += reader.Num_Fields() != 5 || !reader.Get_Double(1, rating) || !reader.Get_Double(2, rd) || !reader.Get_Double(3, vol)
+				|| !reader.Field(4).empty() || differs(csv_rows++, reader.Field(0), rating, rd, vol);
+		reader.Close();
+	}
+	csv_mismatches += csv_rows != order.size();
+
+	// JSON Lines, with the opponents and scores
+	size_t json_rows = 0, json_mismatches = 0;
+	int json_status = exporter.Write(filename.c_str(), system, Exporter::JSON_LINES, P_tmpdir);
+	std::string json = json_status == Exporter::OK ? read_file(filename) : std::string{};
+	const char* p = json.c_str();
+	auto expect = [&](const char* text)
+	{
+		size_t length = std::strlen(text);
+		bool found = std::strncmp(p, text, length) == 0;
+		if (found)
+			p += length;
+		return found;
+	};
+	auto get_string = [&](std::string& s)
+	{
+		s.clear();
+		if (*p++ != '"')
+			return false;
+		for (; *p != '"'; p++)
+		{
+			if (*p == '\0')
+				return false;
+			if (*p != '\\')
+				s += *p;
+			else if (p[1] == 'u')
+			{
+				s += static_cast<char>(std::strtol(std::string(p + 2, 4).c_str(), nullptr, 16));
+				p += 5;
+			}
+			else
+				s += *++p;
+		}
+		++p;
+		return true;
+	};
+	auto get_double = [&](double& x)
+	{
+		char* end;
+		x = std::strtod(p, &end);
+		bool read = end != p;
+		p = end;
+		return read;
+	};
+	auto get_int = [&](int& x)
+	{
+		char* end;
+		x = std::strtol(p, &end, 10);
+		bool read = end != p;
+		p = end;
+		return read;
+	};
+	std::string name, opponent_name;
+	std::vector<std::pair<std::string, int>> listed, recorded;
+	while (*p != '\0')
+	{
+		double rating = 0, rd = 0, vol = 0;
+		bool ok = expect("{\"name\":") && get_string(name) && expect(",\"rating\":") && get_double(rating) && expect(",\"rd\":") && get_double(rd)
+			&& expect(",\"vol\":") && get_double(vol) && expect(",\"opponents\":[");
+		listed.clear();
+		while (ok && *p != ']')
+		{
+			ok = (listed.empty() || expect(",")) && get_string(opponent_name);
+			listed.push_back({ opponent_name, 0 });
+		}
+		ok = ok && expect("],\"scores\":[");
+		for (size_t i = 0; ok && i < listed.size(); i++)
+			ok = (i == 0 || expect(",")) && get_int(listed[i].second);
+		ok = ok && expect("]}\n");
+
+		recorded.clear();
+		if (json_rows < order.size())
+			system.For_Each_Match(order[json_rows], [&](const Glicko2::Player_Ref& opp, int score) { recorded.push_back({ opp.name, score }); });
+		json_mismatches += !ok || differs(json_rows++, name, rating, rd, vol) || listed != recorded;
+		if (!ok)
+			break;
+	}
+	json_mismatches += json_rows != order.size();
+
+	// binary: the header, the checksum over everything after it, then the
+	// columns and names
+	size_t binary_mismatches = 0;
+	bool checksum_ok = false;
+	int binary_status = exporter.Write(filename.c_str(), system, Exporter::BINARY);
+	std::string binary = binary_status == Exporter::OK ? read_file(filename) : std::string{};
+	Export_Header header;
+	size_t n = order.size();
+	if (binary.size() >= sizeof(header))
+	{
+		std::memcpy(&header, binary.data(), sizeof(header));
+		checksum_ok = header.checksum == Snapshot::Checksum(binary.data() + header.header_size, binary.size() - header.header_size);
+	}
+	if (checksum_ok && std::memcmp(header.magic, "GLICKO2X", 8) == 0 && header.version == Exporter::VERSION && header.header_size == sizeof(header)
+		&& header.count == n && binary.size() == sizeof(header) + 3 * n * sizeof(double) + (n + 1) * sizeof(uint64_t) + header.strings_size)
+	{
+		const char* columns = binary.data() + sizeof(header);
+		const char* strings = columns + 3 * n * sizeof(double) + (n + 1) * sizeof(uint64_t);
+		for (size_t i = 0; i < n; i++)
+		{
+			double rating, rd, vol;
+			uint64_t offset, next;
+			std::memcpy(&rating, columns + i * sizeof(double), sizeof(double));
+			std::memcpy(&rd, columns + (n + i) * sizeof(double), sizeof(double));
+			std::memcpy(&vol, columns + (2 * n + i) * sizeof(double), sizeof(double));
+			std::memcpy(&offset, columns + 3 * n * sizeof(double) + i * sizeof(uint64_t), sizeof(uint64_t));
+			std::memcpy(&next, columns + 3 * n * sizeof(double) + (i + 1) * sizeof(uint64_t), sizeof(uint64_t));
+			binary_mismatches += next <= offset || next > header.strings_size || strings[next - 1] != '\0'
+				|| differs(i, std::string_view(strings + offset, next - offset - 1), rating, rd, vol);
+		}
+	}
+	else
+		binary_mismatches = n;
+
+	std::remove(filename.c_str());
+	bool written = csv_status == Exporter::OK && json_status == Exporter::OK && binary_status == Exporter::OK;
+	return Check{ "exports", written && csv_mismatches == 0 && json_mismatches == 0 && binary_mismatches == 0 && checksum_ok,
+		format("%zu players: %zu CSV rows, %zu JSON Lines objects and %zu binary entries unlike the store; binary checksum %s",
+			n, csv_mismatches, json_mismatches, binary_mismatches, checksum_ok ? "verified" : "wrong") };
+}
+
+// a timeline appended to over periods in which only some players play, and
+// that gains players part way, must read back after a reopen, through
+// Get() and Get_All() alike, exactly the stored rating and volatility and
+// the current RD each player had at every period recorded
+Check check_timeline (const std::string& filename, uint64_t seed)
+{
+	const uint32_t PLAYERS = 300, LATE = 40, PERIODS = 12, JOIN = 5, INTERVAL = 4;
+	uint64_t state = seed;
+	auto random = [&]
+	{
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		return uint32_t(state >> 33);
+	};
+
+	Glicko2 system;
+	auto add = [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t k = begin; k < end; k++)
+			system.Add_Player(Player{ "p" + std::to_string(k), 1300.0 + random() % 400, 50.0 + random() % 250, 0.06 });
+	};
+	add(0, PLAYERS);
+
+	// what the system held at each period, by name
+	std::vector<std::vector<Timeline::Entry>> expected;
+	auto record = [&]
+	{
+		expected.emplace_back(PLAYERS + LATE);
+		for (uint32_t id = 0; id < system.Num_Players(); id++)
+		{
+			uint32_t k = std::stoul(system.Get_Store().Get_Name(id).substr(1));
+			expected.back()[k] = Timeline::Entry{ system.Get_Store().Get_Rating(id), system.Get_Current_RD(id), system.Get_Store().Get_Vol(id), 0 };
+		}
+	};
+
+	std::remove(filename.c_str());
+	Timeline timeline;
+	bool appended = timeline.Open(filename.c_str(), INTERVAL) == Timeline::OK && timeline.Append(system) == Timeline::OK;
+	record();
+	for (uint32_t p = 0; p < PERIODS && appended; p++)
+	{
+		if (p == JOIN)
+			add(PLAYERS, PLAYERS + LATE);
+		uint32_t n = system.Num_Players();
+		for (uint32_t m = 0; m < n / 3; m++)
+		{
+			uint32_t a = random() % n, b = random() % n;
+			if (a != b)
+				system.Add_Match(a, b, random() % 2);
+		}
+		system.Close_Period();
+		appended = timeline.Append(system) == Timeline::OK;
+		record();
+	}
+	timeline.Close();
+
+	size_t differences = 0;
+	bool reopened = appended && timeline.Open(filename.c_str()) == Timeline::OK && timeline.Num_Periods() == PERIODS + 1;
+	std::vector<Timeline::Entry> all;
+	for (uint32_t p = 0; reopened && p <= PERIODS; p++)
+	{
+		timeline.Get_All(p, all);
+		for (uint32_t k = 0; k < PLAYERS + LATE; k++)
+		{
+			uint32_t tid = timeline.Find("p" + std::to_string(k));
+			Timeline::Entry entry;
+			bool joined = k < PLAYERS || p > JOIN;
+			bool found = tid != Timeline::npos && timeline.Get(tid, p, entry);
+			const Timeline::Entry& want = expected[p][k];
+			if (!joined)
+				differences += found || (tid < all.size() && all[tid].recorded != Timeline::NO_PERIOD);
+			else
+				differences += !found || tid >= all.size() || entry.rating != want.rating || entry.rd != want.rd || entry.vol != want.vol
+					|| all[tid].rating != want.rating || all[tid].rd != want.rd || all[tid].vol != want.vol;
+		}
+	}
+	timeline.Close();
+	std::remove(filename.c_str());
+
+	return Check{ "timeline", reopened && differences == 0,
+		format("%u periods %s; %zu of %u player-periods read back unlike the system", PERIODS + 1,
+			reopened ? "recorded and reopened" : "not recorded", differences, (PERIODS + 1) * (PLAYERS + LATE)) };
+}
+
+void usage (const char* prog)
+{
+	std::fprintf(stderr, "Usage: %s [--players=n] [--games=n] [--skill-sd=x] [--exponent=x] [--seed=n] [--repeat=n] [--threads=n] [--isa=scalar|avx2|avx512] [--precision=double|float] [--accuracy=exact|approximate] [--output=filename]\n", prog);
+}
+
+int main (int argc, char* argv[])
+{
+	SyntheticLeague_Config config;
+	int repeat = 5;
+	unsigned threads = 1;
+	Glicko2::Precision precision = Glicko2::DOUBLE;
+	Glicko2::Accuracy accuracy = Glicko2::EXACT;
+	const char* output = nullptr;
+
+	static struct option long_opts[] = {
+		{"players", required_argument, 0, 'p'},
+		{"games", required_argument, 0, 'g'},
+		{"skill-sd", required_argument, 0, 'k'},
+		{"exponent", required_argument, 0, 'e'},
+		{"seed", required_argument, 0, 'x'},
+		{"repeat", required_argument, 0, 'n'},
+		{"threads", required_argument, 0, 't'},
+		{"isa", required_argument, 0, 'i'},
+		{"precision", required_argument, 0, 'f'},
+		{"accuracy", required_argument, 0, 'a'},
+		{"output", required_argument, 0, 'o'},
+		{0, 0, 0, 0}
+	};
+
+	int opt_index = 0;
+	int val;
+	while ((val = getopt_long(argc, argv, "p:g:k:e:x:n:t:i:f:a:o:", long_opts, &opt_index)) != -1)
+	{
+		switch (val)
+		{
+			case 'p': config.players = std::strtoul(optarg, nullptr, 10); break;
+			case 'g': config.games_per_period = std::strtoul(optarg, nullptr, 10); break;
+			case 'k': config.skill_sd = std::strtod(optarg, nullptr); break;
+			case 'e': config.activity_exponent = std::strtod(optarg, nullptr); break;
+			case 'x': config.seed = std::strtoull(optarg, nullptr, 10); break;
+			case 'n': repeat = std::max(1, std::atoi(optarg)); break;
+			case 't': threads = std::strtoul(optarg, nullptr, 10); break;
+			case 'i':
+				{
+					std::string isa { optarg };
+					Kernel::Select_ISA(isa == "avx512" ? Kernel::AVX512 : isa == "avx2" ? Kernel::AVX2 : Kernel::SCALAR);
+				}
+				break;
+			case 'f': precision = std::string{ optarg } == "float" ? Glicko2::FLOAT : Glicko2::DOUBLE; break;
+			case 'a': accuracy = std::string{ optarg } == "approximate" ? Glicko2::APPROXIMATE : Glicko2::EXACT; break;
+			case 'o': output = optarg; break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	SyntheticLeague league { config };
+	std::vector<Result> results;
+
+	Glicko2 system;
+	results.push_back(measure("populate", 1, league.Size(), "player", "players", []{}, [&]{ league.Populate(system); }));
+	system.Set_Threads(threads);
+	system.Set_Precision(precision);
+	system.Set_Accuracy(accuracy);
+
+	// recording one period's games, each entered for both of its players;
+	// once only, since the matches accumulate
+	results.push_back(measure("add_match", 1, 2 * size_t{config.games_per_period}, "match", "matches", []{}, [&]{ league.Play_Period(system); }));
+
+	// a full period over every player, against the same matches each time
+	results.push_back(measure("run", repeat, league.Size(), "player", "players", []{}, [&]{ system.Run(); }));
+
+	// the same with the approximate math, whatever the accuracy chosen
+	system.Set_Accuracy(Glicko2::APPROXIMATE);
+	results.push_back(measure("run_approximate", repeat, league.Size(), "player", "players", []{}, [&]{ system.Run(); }));
+	system.Set_Accuracy(accuracy);
+
+	// the old Single_Run path: one player rated on their own
+	size_t sample = std::min<size_t>(league.Size(), 1000);
+	results.push_back(measure("single_run", repeat, sample, "call", "calls", []{}, [&]
+	{
+		for (uint32_t id = 0; id < sample; id++)
+			system.Run(league.Get_Name(id));
+	}));
+
+	// incremental periods: fresh games, then a close over the active players;
+	// the games the runs above rated are dropped first
+	system.Clear_Matches();
+	results.push_back(measure("close_period", repeat, league.Size(), "player", "players", [&]{ league.Play_Period(system); }, [&]{ system.Close_Period(); }));
+
+	// many small ladders of LEAGUE_SIZE players, each with its own tau,
+	// closed together: in one LeagueSet, then as one Glicko2 per league
+	// (check_leagues() compares the two)
+	const uint32_t LEAGUE_SIZE = 20;
+	uint32_t num_leagues = std::max<uint32_t>(1, league.Size() / LEAGUE_SIZE);
+	LeagueSet leagues { threads };
+	std::vector<std::unique_ptr<Glicko2>> instances;
+	for (uint32_t l = 0; l < num_leagues; l++)
+	{
+		double tau = 0.3 + 0.9 * l / num_leagues;
+		leagues.Add_League(tau);
+		instances.emplace_back(new Glicko2{ tau });
+		for (uint32_t i = 0; i < LEAGUE_SIZE; i++)
+		{
+			leagues.Add_Player(l, league.Get_Name(l * LEAGUE_SIZE + i));
+			instances.back()->Add_Player(Player{ league.Get_Name(l * LEAGUE_SIZE + i) });
+		}
+	}
+	// ten random games per player, entered for both sides
+	auto play_leagues = [&](bool in_set)
+	{
+		uint64_t state = config.seed;
+		for (uint32_t l = 0; l < num_leagues; l++)
+			for (uint32_t game = 0; game < 5 * LEAGUE_SIZE; game++)
+			{
+				state = state * 6364136223846793005ull + 1442695040888963407ull;
+				uint32_t a = (state >> 33) % LEAGUE_SIZE, b = (a + 1 + (state >> 13) % (LEAGUE_SIZE - 1)) % LEAGUE_SIZE;
+				int score = (state >> 7) & 1;
+				if (in_set)
+				{
+					leagues.Add_Match(l * LEAGUE_SIZE + a, l * LEAGUE_SIZE + b, score);
+					leagues.Add_Match(l * LEAGUE_SIZE + b, l * LEAGUE_SIZE + a, 1 - score);
+					leagues.Schedule_Close(l);
+				}
+				else
+				{
+					instances[l]->Add_Match(a, b, score);
+					instances[l]->Add_Match(b, a, 1 - score);
+				}
+			}
+	};
+	size_t league_players = size_t{num_leagues} * LEAGUE_SIZE;
+	results.push_back(measure("close_leagues", repeat, league_players, "player", "players", [&]{ play_leagues(true); }, [&]{ leagues.Close_Due(); }));
+	results.push_back(measure("close_instances", repeat, league_players, "player", "players", [&]{ play_leagues(false); }, [&]
+	{
+		for (auto& instance : instances)
+			instance->Close_Period();
+	}));
+	instances.clear();
+
+	// matchmaking queries against the current ratings: random pairings,
+	// then the best opponents of a sample of players
+	std::vector<uint32_t> pair_players (1 << 20), pair_opponents (pair_players.size());
+	uint64_t state = config.seed;
+	for (size_t i = 0; i < pair_players.size(); i++)
+	{
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		pair_players[i] = (state >> 32) % system.Num_Players();
+		pair_opponents[i] = (state & 0xFFFFFFFF) % system.Num_Players();
+	}
+	std::vector<double> expected (pair_players.size()), win_change (pair_players.size()), loss_change (pair_players.size());
+	results.push_back(measure("predict", repeat, pair_players.size(), "pair", "pairs", []{}, [&]
+	{
+		system.Predict(pair_players.data(), pair_opponents.data(), pair_players.size(), expected.data(), win_change.data(), loss_change.data());
+	}));
+	std::vector<uint32_t> best (16);
+	system.Get_Ranking();
+	results.push_back(measure("best_opponents", repeat, sample, "call", "calls", []{}, [&]
+	{
+		for (uint32_t id = 0; id < sample; id++)
+			system.Best_Opponents(id, best.size(), best.data());
+	}));
+
+	// the random pairings again, streamed in through an ingestion queue by
+	// several producers while this thread drains them, then closed as a
+	// period; a producer that finds the queue full yields and retries
+	IngestQueue queue { 1 << 16 };
+	unsigned producers = std::max(2u, threads);
+	results.push_back(measure("ingest", repeat, pair_players.size(), "match", "matches", []{}, [&]
+	{
+		std::atomic<unsigned> running { producers };
+		std::vector<std::thread> pushing;
+		for (unsigned t = 0; t < producers; t++)
+			pushing.emplace_back([&, t]
+			{
+				for (size_t i = t; i < pair_players.size(); i += producers)
+					while (!queue.Push(pair_players[i], pair_opponents[i], expected[i] >= 0.5))
+						std::this_thread::yield();
+				running.fetch_sub(1);
+			});
+		while (running.load() != 0)
+			if (queue.Drain(system) == 0)
+				std::this_thread::yield();
+		for (std::thread& thread : pushing)
+			thread.join();
+		queue.Seal();
+		queue.Drain(system);
+	}));
+
+	std::string snapshot_file { P_tmpdir };
+	snapshot_file += "/glicko2-bench-" + std::to_string(getpid()) + ".snap";
+	league.Play_Period(system);
+	results.push_back(measure("save_snapshot", repeat, league.Size(), "player", "players", []{}, [&]{ Snapshot::Write(snapshot_file.c_str(), system); }));
+	results.push_back(measure("load_snapshot", repeat, league.Size(), "player", "players", []{}, [&]
+	{
+		Snapshot snapshot;
+		Glicko2 loaded;
+		if (snapshot.Open(snapshot_file.c_str()) == Snapshot::OK)
+			loaded.Load(snapshot);
+	}));
+	std::remove(snapshot_file.c_str());
+
+	// ratings exports, without results files
+	Exporter exporter { threads };
+	for (Exporter::Format format : { Exporter::CSV, Exporter::JSON_LINES, Exporter::BINARY })
+	{
+		static const char* const NAMES[] = { "export_csv", "export_jsonl", "export_binary" };
+		std::string export_file { P_tmpdir };
+		export_file += "/glicko2-bench-" + std::to_string(getpid()) + ".export";
+		results.push_back(measure(NAMES[format], repeat, league.Size(), "player", "players", []{}, [&]{ exporter.Write(export_file.c_str(), system, format); }));
+		std::remove(export_file.c_str());
+	}
+
+	// the client's cycle through Player objects: enter every player with
+	// their results, rate them, and write them all out again
+	std::vector<Player> players;
+	results.push_back(measure("load_run_save", repeat, system.Num_Players() + system.Get_Matches().Size(), "item", "items", [&]
+	{
+		players.clear();
+		for (const auto& kv : system.Get_Players())
+			players.push_back(kv.second);
+	}, [&]
+	{
+		Glicko2 cycle;
+		for (Player& player : players)
+			cycle.Add_Player(std::move(player));
+		cycle.Run();
+
+		std::string out;
+		char line[128];
+		cycle.For_Each_Player([&](const Glicko2::Player_Ref& player)
+		{
+			out += player.name;
+			out.append(line, std::snprintf(line, sizeof(line), ",%.17g,%.17g,%.17g\n", player.rating, player.rd, player.vol));
+			cycle.For_Each_Match(player.id, [&](const Glicko2::Player_Ref& opp, int score)
+			{
+				out += opp.name;
+				out.append(line, std::snprintf(line, sizeof(line), ",%.17g,%.17g,%.17g,%d\n", opp.rating, opp.rd, opp.vol, score));
+			});
+		});
+	}));
+
+	// drift of the approximate math from the exact one, over the same games
+	double rating_drift = 0, rd_drift = 0, vol_drift = 0;
+	{
+		SyntheticLeague exact_league { config }, approximate_league { config };
+		Glicko2 exact, approximate;
+		exact_league.Populate(exact);
+		approximate_league.Populate(approximate);
+		exact.Set_Precision(precision);
+		approximate.Set_Precision(precision);
+		approximate.Set_Accuracy(Glicko2::APPROXIMATE);
+		for (int p = 0; p < Kernel::APPROXIMATE_PERIODS; p++)
+		{
+			exact_league.Play_Period(exact);
+			exact.Close_Period();
+			approximate_league.Play_Period(approximate);
+			approximate.Close_Period();
+		}
+		for (uint32_t id = 0; id < exact.Num_Players(); id++)
+		{
+			Glicko2::Player_Ref a = exact.Get_Player_Ref(id), b = approximate.Get_Player_Ref(id);
+			rating_drift = std::max(rating_drift, std::fabs(a.rating - b.rating));
+			rd_drift = std::max(rd_drift, std::fabs(a.rd - b.rd));
+			vol_drift = std::max(vol_drift, std::fabs(a.vol - b.vol));
+		}
+	}
+
+	// the SIMD kernels against the scalar one, and float against double,
+	// over the same period; each player's difference is measured as a
+	// fraction of their tolerance, which grows with their opponents
+	struct Kernel_Check
+	{
+		const char* isa;
+		uint64_t rating_ulps = 0;
+		uint64_t rd_ulps = 0;
+		double vol_difference = 0;
+		double worst = 0;		// the largest difference over its tolerance
+	};
+	std::vector<Kernel_Check> kernel_checks;
+	double float_rating_difference = 0, float_rd_difference = 0, float_worst = 0;
+	{
+		Kernel::ISA selected = Kernel::Get_ISA();
+		std::unique_ptr<Glicko2> scalar = rate_period(config, Kernel::SCALAR, Glicko2::DOUBLE);
+
+		// as the kernel counts them: games against the same opponent in a
+		// row are one
+		std::vector<size_t> opponents (scalar->Get_Store().Size());
+		for (uint32_t id = 0; id < opponents.size(); id++)
+		{
+			uint32_t previous = RatingStore::npos;
+			scalar->For_Each_Match(id, [&](const Glicko2::Player_Ref& opponent, int)
+			{
+				opponents[id] += opponent.id != previous;
+				previous = opponent.id;
+			});
+		}
+
+		for (Kernel::ISA isa : { Kernel::AVX2, Kernel::AVX512 })
+		{
+			if (Kernel::Select_ISA(isa) != isa)
+				continue;
+			std::unique_ptr<Glicko2> simd = rate_period(config, isa, Glicko2::DOUBLE);
+			Kernel_Check check;
+			check.isa = Kernel::Get_ISA_Name();
+			for (uint32_t id = 0; id < opponents.size(); id++)
+			{
+				Glicko2::Player_Ref a = scalar->Get_Player_Ref(id), b = simd->Get_Player_Ref(id);
+				uint64_t rating_ulps = ulps_apart(a.rating, b.rating), rd_ulps = ulps_apart(a.rd, b.rd);
+				double vol_difference = relative_difference(a.vol, b.vol);
+				check.rating_ulps = std::max(check.rating_ulps, rating_ulps);
+				check.rd_ulps = std::max(check.rd_ulps, rd_ulps);
+				check.vol_difference = std::max(check.vol_difference, vol_difference);
+				check.worst = std::max({ check.worst, std::max(rating_ulps, rd_ulps) / Kernel::Ulp_Tolerance(opponents[id]), vol_difference / Volatility::EPSILON });
+			}
+			kernel_checks.push_back(check);
+		}
+
+		std::unique_ptr<Glicko2> exact = rate_period(config, selected, Glicko2::DOUBLE);
+		std::unique_ptr<Glicko2> single = rate_period(config, selected, Glicko2::FLOAT);
+		for (uint32_t id = 0; id < opponents.size(); id++)
+		{
+			Glicko2::Player_Ref a = exact->Get_Player_Ref(id), b = single->Get_Player_Ref(id);
+			double rating_difference = relative_difference(a.rating, b.rating), rd_difference = relative_difference(a.rd, b.rd);
+			float_rating_difference = std::max(float_rating_difference, rating_difference);
+			float_rd_difference = std::max(float_rd_difference, rd_difference);
+			float_worst = std::max(float_worst, std::max(rating_difference, rd_difference) / Kernel::Float_Tolerance(opponents[id]));
+		}
+	}
+
+	std::vector<Check> checks;
+	std::string check_file { P_tmpdir };
+	check_file += "/glicko2-bench-" + std::to_string(getpid()) + ".csv";
+	checks.push_back(check_csv_reader(system, check_file));
+	{
+		const Result& cycle = *std::find_if(results.begin(), results.end(), [](const Result& r) { return r.name == "load_run_save"; });
+		size_t players = system.Num_Players(), matches = cycle.items - players;
+		size_t allowed = players + 1024;
+		checks.push_back(Check{ "load_run_save_allocations", cycle.allocations <= allowed,
+			format("%zu allocations for %zu players and %zu matches, at most %zu allowed", cycle.allocations, players, matches, allowed) });
+	}
+	checks.push_back(check_move_mutation());
+	checks.push_back(check_ingest_invalid());
+	checks.push_back(check_run_then_close(P_tmpdir + ("/glicko2-bench-" + std::to_string(getpid()) + ".snap")));
+	checks.push_back(check_snapshot_periods(P_tmpdir + ("/glicko2-bench-" + std::to_string(getpid()) + ".snap")));
+	checks.push_back(check_warm_periods(config, threads, precision, accuracy));
+	checks.push_back(check_run_aggregation(config.seed));
+	checks.push_back(check_leagues(config.seed, threads));
+	checks.push_back(check_rank_index(config.seed));
+	checks.push_back(check_predict(system, config.seed));
+	checks.push_back(check_exports(system, threads, P_tmpdir + ("/glicko2-bench-" + std::to_string(getpid()) + ".export")));
+	checks.push_back(check_timeline(P_tmpdir + ("/glicko2-bench-" + std::to_string(getpid()) + ".timeline"), config.seed));
+	checks.push_back(check_parallel_load(system, P_tmpdir + ("/glicko2-bench-" + std::to_string(getpid()))));
+	checks.push_back(check_shards(system, P_tmpdir + ("/glicko2-bench-shards-" + std::to_string(getpid()))));
+	bool checks_passed = std::all_of(checks.begin(), checks.end(), [](const Check& check) { return check.passed; });
+
+	bool within_tolerance = rating_drift <= Kernel::APPROXIMATE_TOLERANCE && rd_drift <= Kernel::APPROXIMATE_TOLERANCE && float_worst <= 1;
+	for (const Kernel_Check& check : kernel_checks)
+		within_tolerance = within_tolerance && check.worst <= 1;
+
+	FILE* out = output ? std::fopen(output, "w") : stdout;
+	if (!out)
+	{
+		std::fprintf(stderr, "%s: could not write file %s\n", argv[0], output);
+		return 1;
+	}
+
+	std::fprintf(out, "{\n");
+	std::fprintf(out, "  \"config\": { \"players\": %u, \"games_per_period\": %u, \"skill_mean\": %g, \"skill_sd\": %g, \"activity_exponent\": %g, \"seed\": %llu, \"repeat\": %d },\n",
+		config.players, config.games_per_period, config.skill_mean, config.skill_sd, config.activity_exponent, static_cast<unsigned long long>(config.seed), repeat);
+	std::fprintf(out, "  \"isa\": \"%s\",\n  \"precision\": \"%s\",\n  \"accuracy\": \"%s\",\n  \"threads\": %u,\n", Kernel::Get_ISA_Name(), precision == Glicko2::FLOAT ? "float" : "double", accuracy == Glicko2::APPROXIMATE ? "approximate" : "exact", system.Get_Threads());
+	std::fprintf(out, "  \"approximation\": { \"periods\": %d, \"max_rating_drift\": %.3g, \"max_rd_drift\": %.3g, \"max_vol_drift\": %.3g, \"tolerance\": %g },\n",
+		Kernel::APPROXIMATE_PERIODS, rating_drift, rd_drift, vol_drift, Kernel::APPROXIMATE_TOLERANCE);
+	std::fprintf(out, "  \"kernels\": { \"ulp_tolerance\": %d, \"ulps_per_opponent\": %g, \"vol_tolerance\": %g, \"simd\": [", Kernel::ULP_TOLERANCE, Kernel::ULPS_PER_OPPONENT, Volatility::EPSILON);
+	for (size_t i = 0; i < kernel_checks.size(); i++)
+	{
+		const Kernel_Check& check = kernel_checks[i];
+		std::fprintf(out, "%s{ \"isa\": \"%s\", \"max_rating_ulps\": %llu, \"max_rd_ulps\": %llu, \"max_vol_difference\": %.3g, \"worst_of_tolerance\": %.3g }",
+			i > 0 ? ", " : " ", check.isa, static_cast<unsigned long long>(check.rating_ulps), static_cast<unsigned long long>(check.rd_ulps), check.vol_difference, check.worst);
+	}
+	std::fprintf(out, " ],\n    \"float\": { \"max_rating_difference\": %.3g, \"max_rd_difference\": %.3g, \"tolerance\": %g, \"tolerance_per_opponent\": %g, \"worst_of_tolerance\": %.3g } },\n",
+		float_rating_difference, float_rd_difference, Kernel::FLOAT_TOLERANCE, Kernel::FLOAT_TOLERANCE_PER_OPPONENT, float_worst);
+	std::fprintf(out, "  \"within_tolerance\": %s,\n", within_tolerance ? "true" : "false");
+	std::fprintf(out, "  \"checks\": [\n");
+	for (size_t i = 0; i < checks.size(); i++)
+		std::fprintf(out, "    { \"name\": \"%s\", \"passed\": %s, \"detail\": \"%s\" }%s\n",
+			checks[i].name, checks[i].passed ? "true" : "false", checks[i].detail.c_str(), i+1 < checks.size() ? "," : "");
+	std::fprintf(out, "  ],\n");
+	std::fprintf(out, "  \"benchmarks\": [\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Result& r = results[i];
+		std::fprintf(out, "    { \"name\": \"%s\", \"seconds\": %.9f, \"%s\": %zu, \"ns_per_%s\": %.3f, \"%s_per_s\": %.1f, \"allocations\": %zu, \"allocations_per_%s\": %.3f, \"peak_rss_kb\": %ld }%s\n",
+			r.name.c_str(), r.seconds, r.units, r.items, r.unit, r.seconds * 1e9 / r.items, r.units, r.items / r.seconds, r.allocations, r.unit, double(r.allocations) / r.items, r.peak_rss_kb, i+1 < results.size() ? "," : "");
+	}
+	std::fprintf(out, "  ]");
+	if (Stats::Enabled())
+	{
+		std::string stats { Stats::To_JSON() };
+		stats.pop_back();
+		std::fprintf(out, ",\n  \"stats\": %s", stats.c_str());
+	}
+	std::fprintf(out, "\n}\n");
+
+	if (out != stdout)
+		std::fclose(out);
+	if (!within_tolerance)
+	{
+		std::fprintf(stderr, "%s: results outside the tolerances of Kernel.h, see \"approximation\" and \"kernels\"\n", argv[0]);
+		return 2;
+	}
+	if (!checks_passed)
+	{
+		std::fprintf(stderr, "%s: checks failed, see \"checks\"\n", argv[0]);
+		return 3;
+	}
+	return 0;
+}
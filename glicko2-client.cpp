@@ -1,4 +1,12 @@
+#include "CsvLoader.h"
+#include "Exporter.h"
 #include "Glicko2.h"
+#include "Server.h"
+#include "Shard.h"
+#include "Snapshot.h"
+#include "Stats.h"
+#include "Timeline.h"
+#include <algorithm>
 #include <limits>
 #include <string>
 #include <iostream>
@@ -12,9 +20,16 @@
 #include <ctime>
 
 #include <getopt.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 double tau = 0.6;
 Glicko2 glicko_system { tau };
+Timeline timeline;
+unsigned num_shards = 1;
+unsigned num_threads = 0;	// --threads, for loading too; 0 for one per hardware thread
+uint64_t snapshot_checksum = 0;
 
 bool prompt (const char* message, char& readch);
 
@@ -24,6 +39,32 @@ int load (const char* filename);
 
 int run_glicko2(const char* filename);
 
+int run_sharded ();
+
+int run_shard (const char* spec);
+
+int load_snapshot (const char* filename);
+
+int save_snapshot (const char* filename);
+
+int serve (const char* socket_path);
+
+int open_journal (const char* filename);
+
+int output_top (const char* count);
+
+int output_stats (const char* filename);
+
+int open_timeline (const char* filename);
+
+int record_timeline ();
+
+int output_at (const char* spec);
+
+int output_to_csv(const char* filename, bool results_flag);
+
+void usage (const char* prog);
+
 int main (int argc, char* argv[])
 {
 	std::unique_ptr<char[]> filename;
@@ -34,18 +75,56 @@ int main (int argc, char* argv[])
 	 *
 	 * Format of a line in a results CSV file:
 	 * [opponent name],[rating],[rd],[volatility],[score]
+	 *
+	 * --save-snapshot and --load-snapshot convert to and from the binary
+	 * snapshot format described in Snapshot.h.
+	 *
+	 * --serve keeps the loaded system running as a daemon answering the
+	 * socket protocol described in Server.h. Results a --run has rated are
+	 * dropped first, so the served periods start afresh.
+	 *
+	 * --journal=file recovers the system from file.checkpoint and the match
+	 * log in file, then logs every change made by the options after it (see
+	 * MatchLog.h).
+	 *
+	 * --stats=file writes the engine's instrumentation (Stats.h) on exit, as
+	 * Prometheus text if file ends in .prom and as JSON otherwise; it needs
+	 * a build with `make STATS=1`.
+	 *
+	 * --timeline=file opens the rating history in file (see Timeline.h),
+	 * recording the current ratings if it's new, and every --run after it
+	 * records its period there. --at=period[:name] prints the ratings, or
+	 * one player's, as of a period in the timeline.
+	 *
+	 * --shards=n makes every --run after it a coordinator: the system is
+	 * broadcast to n worker processes as a snapshot, each rates the players
+	 * it owns (see Shard.h) with --shard=k/n:file, and the results are
+	 * merged, coming to exactly the ratings of a plain --run.
 	 */
 	bool did_something = false;
+	const char* stats_filename = nullptr;
 
 	static struct option long_opts[] = {
 		{"create", required_argument, 0, 'c'},
 		{"load", required_argument, 0, 'l'},
 		{"run", no_argument, 0, 'r'},
+		{"threads", required_argument, 0, 't'},
+		{"save", required_argument, 0, 's'},
+		{"load-snapshot", required_argument, 0, 'L'},
+		{"save-snapshot", required_argument, 0, 'S'},
+		{"serve", required_argument, 0, 'd'},
+		{"journal", required_argument, 0, 'j'},
+		{"top", required_argument, 0, 'T'},
+		{"stats", required_argument, 0, 'm'},
+		{"timeline", required_argument, 0, 'H'},
+		{"at", required_argument, 0, 'A'},
+		{"shards", required_argument, 0, 'P'},
+		{"shard", required_argument, 0, 'K'},
 		{0, 0, 0, 0}
 	};
 
 	int opt_index = 0;
-	int val = getopt_long(argc, argv, "c:l:r", long_opts, &opt_index);
+	int val = getopt_long(argc, argv, "c:l:rt:s:L:S:d:j:T:m:H:A:P:K:", long_opts, &opt_index);
 	while (val != -1)
 	{
 		switch (val)
@@ -85,6 +164,11 @@ int main (int argc, char* argv[])
 						std::fprintf(stderr, "%s: invalid csv; could not open one of the results csv files that were in %s, it may not be present in the current directory or the player-data directory.\n\n", argv[0], filename.get());
 						std::exit(1);
 					}
+					if (ret == 3)	// malformed row, already reported with its line number
+					{
+						std::fprintf(stderr, "%s: invalid csv; could not load %s.\n\n", argv[0], filename.get());
+						std::exit(1);
+					}
 				}
 				break;
 			case 'r':
@@ -96,70 +180,352 @@ int main (int argc, char* argv[])
 						std::fprintf(stderr, "%s: there are currently no data loaded on which to run the Glicko-2 system.\nEither load data from a CSV file with `%s --load=filename --run`,\nor create new data on which to run, with `%s --create=filename --run`.\n\n", argv[0], argv[0], argv[0]);
 						std::exit(1);
 					}
+					if (ret == 2)
+					{
+						std::fprintf(stderr, "%s: the sharded run failed; the system is unchanged.\n\n", argv[0]);
+						std::exit(1);
+					}
+					if (ret == 3)
+					{
+						std::fprintf(stderr, "%s: could not write the calibrated data to the player-data directory.\n\n", argv[0]);
+						std::exit(1);
+					}
+					if (ret == 4)
+					{
+						std::fprintf(stderr, "%s: --run needs the name of the file the system came from, to name the calibrated data after it.\nA system recovered from a journal has none; load it with `%s --load=filename --run` or `%s --load-snapshot=filename --run` instead.\n\n", argv[0], argv[0], argv[0]);
+						std::exit(1);
+					}
+					if (timeline.Is_Open() && record_timeline() != Timeline::OK)
+					{
+						std::fprintf(stderr, "%s: could not write to the timeline.\n\n", argv[0]);
+						std::exit(1);
+					}
+				}
+				break;
+			case 't':
+				{
+					// 0 means one thread per hardware thread
+					char* end;
+					long threads = std::strtol(optarg, &end, 10);
+					if (*end != '\0' || threads < 0)
+					{
+						std::fprintf(stderr, "%s: invalid thread count %s\n\n", argv[0], optarg);
+						std::exit(1);
+					}
+					glicko_system.Set_Threads(threads);
+					num_threads = threads;
+				}
+				break;
+			case 's':
+				{
+					int ret = output_to_csv(optarg, true);
+					did_something = true;
+					if (ret == 1)	// file already exists
+					{
+						std::fprintf(stderr, "%s: could not write file %s, it may already exist in the player-data directory.\n\n", argv[0], optarg);
+						std::exit(1);
+					}
+					if (ret == 2)
+					{
+						std::fprintf(stderr, "%s: could not write file %s.\n\n", argv[0], optarg);
+						std::exit(1);
+					}
+				}
+				break;
+			case 'L':
+				{
+					size_t tmp_optarglength = std::strlen(optarg);
+					filename.reset(new char[tmp_optarglength+1]);
+					for (size_t i = 0; i < tmp_optarglength; i++)
+						filename[i] = optarg[i];
+					filename[tmp_optarglength] = '\0';
+					int ret = load_snapshot(filename.get());
+					did_something = true;
+					if (ret == Snapshot::CANNOT_OPEN)
+					{
+						std::fprintf(stderr, "%s: could not open file %s, it may not be present in the current directory or the player-data directory.\n\n", argv[0], filename.get());
+						std::exit(1);
+					}
+					if (ret != Snapshot::OK)
+					{
+						std::fprintf(stderr, "%s: %s is not a valid Glicko-2 snapshot (%s).\n\n", argv[0], filename.get(), ret == Snapshot::BAD_CHECKSUM ? "checksum mismatch" : "bad header");
+						std::exit(1);
+					}
+				}
+				break;
+			case 'S':
+				{
+					int ret = save_snapshot(optarg);
+					did_something = true;
+					if (ret != Snapshot::OK)
+					{
+						std::fprintf(stderr, "%s: could not write snapshot %s.\n\n", argv[0], optarg);
+						std::exit(1);
+					}
+				}
+				break;
+			case 'd':
+				{
+					int ret = serve(optarg);
+					did_something = true;
+					if (ret == 1)	// couldn't set up the socket
+					{
+						std::fprintf(stderr, "%s: could not listen on socket %s.\n\n", argv[0], optarg);
+						std::exit(1);
+					}
+				}
+				break;
+			case 'j':
+				{
+					int ret = open_journal(optarg);
+					if (ret == Snapshot::CANNOT_OPEN)
+					{
+						std::fprintf(stderr, "%s: could not open journal %s.\n\n", argv[0], optarg);
+						std::exit(1);
+					}
+					if (ret != Snapshot::OK)
+					{
+						std::fprintf(stderr, "%s: could not recover from journal %s (%s).\n\n", argv[0], optarg, ret == Snapshot::WRITE_FAILED ? "write failed" : ret == Snapshot::BAD_CHECKSUM ? "checkpoint checksum mismatch" : "bad format");
+						std::exit(1);
+					}
+				}
+				break;
+			case 'T':
+				{
+					int ret = output_top(optarg);
+					did_something = true;
+					if (ret == 1)	// not a count
+					{
+						std::fprintf(stderr, "%s: invalid player count %s\n\n", argv[0], optarg);
+						std::exit(1);
+					}
+				}
+				break;
+			case 'H':
+				{
+					int ret = open_timeline(optarg);
+					if (ret == Timeline::CANNOT_OPEN)
+					{
+						std::fprintf(stderr, "%s: could not open timeline %s.\n\n", argv[0], optarg);
+						std::exit(1);
+					}
+					if (ret != Timeline::OK)
+					{
+						std::fprintf(stderr, "%s: could not use timeline %s (%s).\n\n", argv[0], optarg, ret == Timeline::WRITE_FAILED ? "write failed" : "bad format");
+						std::exit(1);
+					}
+				}
+				break;
+			case 'A':
+				{
+					int ret = output_at(optarg);
+					did_something = true;
+					if (ret == 1)	// not period[:name]
+					{
+						std::fprintf(stderr, "%s: invalid period %s\n\n", argv[0], optarg);
+						std::exit(1);
+					}
+					if (ret == 2)
+					{
+						std::fprintf(stderr, "%s: --at needs a timeline, open one with --timeline=filename first\n\n", argv[0]);
+						std::exit(1);
+					}
+					if (ret == 3)
+					{
+						std::fprintf(stderr, "%s: no rating recorded for %s\n\n", argv[0], optarg);
+						std::exit(1);
+					}
 				}
 				break;
+			case 'P':
+				{
+					char* end;
+					unsigned long n = std::strtoul(optarg, &end, 10);
+					if (*end != '\0' || n == 0 || n > 1024)
+					{
+						std::fprintf(stderr, "%s: invalid shard count %s\n\n", argv[0], optarg);
+						std::exit(1);
+					}
+					num_shards = n;
+				}
+				break;
+			case 'K':
+				{
+					int ret = run_shard(optarg);
+					did_something = true;
+					if (ret == 1)	// not k/n:file
+					{
+						std::fprintf(stderr, "%s: invalid shard %s, expected k/n:filename\n\n", argv[0], optarg);
+						std::exit(1);
+					}
+					if (ret == 2)
+					{
+						std::fprintf(stderr, "%s: could not write the results of shard %s\n\n", argv[0], optarg);
+						std::exit(1);
+					}
+				}
+				break;
+			case 'm':
+				stats_filename = optarg;
+				if (!Stats::Enabled())
+					std::fprintf(stderr, "%s: built without instrumentation, --stats will be empty (rebuild with make STATS=1)\n\n", argv[0]);
+				break;
 			default:
-				std::fprintf(stderr, "Usage: %s [--create=filename] [--load=filename] [--run]\n", argv[0]);
+				usage(argv[0]);
 				std::exit(1);
 		}
-		val = getopt_long(argc, argv, "c:l:r", long_opts, &opt_index);
+		val = getopt_long(argc, argv, "c:l:rt:s:L:S:d:j:T:m:H:A:P:K:", long_opts, &opt_index);
 	}
 
 	if (!did_something)
-		std::fprintf(stderr, "Usage: %s [--create=filename] [--load=filename] [--run]\n", argv[0]);
+		usage(argv[0]);
 
+	if (!glicko_system.Commit_Log())
+	{
+		std::fprintf(stderr, "%s: could not write to the journal.\n\n", argv[0]);
+		return 1;
+	}
+	if (stats_filename && output_stats(stats_filename) != 0)
+	{
+		std::fprintf(stderr, "%s: could not write file %s\n\n", argv[0], stats_filename);
+		return 1;
+	}
 	return 0;
 }
 
+void usage (const char* prog)
+{
+	std::fprintf(stderr, "Usage: %s [--threads=n] [--journal=filename] [--create=filename] [--load=filename] [--load-snapshot=filename] [--shards=n] [--run] [--save=filename] [--save-snapshot=filename] [--timeline=filename] [--at=period[:name]] [--top=n] [--serve=socket] [--shard=k/n:filename] [--stats=filename]\n", prog);
+}
+
 void output_to_console()
 {
-	for (const auto& kv : glicko_system.Get_Players())
+	glicko_system.For_Each_Player([](const Glicko2::Player_Ref& player)
 	{
-		std::printf("Player:\t%s\n", kv.first.c_str());
-		std::printf("Rating:\t%.0f\n", kv.second.Get_Rating());
-		std::printf("Rating Deviation (+/-):\t%.0f\n", kv.second.Get_RD());
-		std::printf("Volatility:\t%.6f\n", kv.second.Get_Vol());
+		std::printf("Player:\t%s\n", player.name.c_str());
+		std::printf("Rating:\t%.0f\n", player.rating);
+		std::printf("Rating Deviation (+/-):\t%.0f\n", player.rd);
+		std::printf("Volatility:\t%.6f\n", player.vol);
 
-		auto match_history { kv.second.Get_Match_History() };
+		size_t count = glicko_system.Num_Matches(player.id), i = 0;
 		std::printf("Opponents:\t[");
-		for (size_t i = 0; i < match_history.size(); i++)
-			std::cout << match_history[i].first.Get_Name() << (i+1 < match_history.size() ? ", " : "]\n");
+		glicko_system.For_Each_Match(player.id, [&](const Glicko2::Player_Ref& opp, int)
+		{ std::cout << opp.name << (++i < count ? ", " : "]\n"); });
+		i = 0;
 		std::printf("Scores:\t[");
-		for (size_t i = 0; i < match_history.size(); i++)
-			std::cout << match_history[i].second << (i+1 < match_history.size() ? ", " : "]\n");
+		glicko_system.For_Each_Match(player.id, [&](const Glicko2::Player_Ref&, int score)
+		{ std::cout << score << (++i < count ? ", " : "]\n"); });
 
-		std::cout << std::endl;
+		std::cout << '\n';
+	});
+}
+
+int output_top (const char* count)
+{
+	char* end;
+	long n = std::strtol(count, &end, 10);
+	if (*end != '\0' || n < 0)
+		return 1;
+
+	const RankIndex& ranking = glicko_system.Get_Ranking();
+	const RatingStore& store = glicko_system.Get_Store();
+	size_t shown = std::min<size_t>(n, ranking.Size());
+	std::printf("\nTop %zu of %zu players:\n\n", shown, ranking.Size());
+	for (size_t rank = 0; rank < shown; rank++)
+	{
+		uint32_t id = ranking.At(rank);
+		std::printf("%zu.\t%s\t%.0f (+/- %.0f)\n", rank+1, store.Get_Name(id).c_str(), store.Get_Rating(id), glicko_system.Get_Current_RD(id));
+	}
+	std::cout << std::endl;
+	return 0;
+}
+
+int open_timeline (const char* filename)
+{
+	int ret = timeline.Open(filename);
+	if (ret != Timeline::OK)
+		return ret;
+	if (timeline.Num_Periods() == 0 && glicko_system.Num_Players() != 0)
+		return record_timeline();
+	return Timeline::OK;
+}
+
+int record_timeline ()
+{
+	// a system loaded from CSV starts its period clock over, so carry on
+	// from the timeline's instead
+	uint32_t period = glicko_system.Get_Period();
+	if (timeline.Num_Periods() != 0 && period <= timeline.Last_Period())
+		period = timeline.Last_Period() + 1;
+
+	int ret = timeline.Append(glicko_system, period);
+	if (ret == Timeline::OK)
+		std::cout << "Recorded period " << period << " in the timeline (" << timeline.Num_Periods() << " periods, " << timeline.Get_File_Size() << " bytes).\n\n";
+	return ret;
+}
+
+int output_at (const char* spec)
+{
+	char* end;
+	unsigned long period = std::strtoul(spec, &end, 10);
+	if (end == spec || (*end != '\0' && *end != ':') || period >= Timeline::NO_PERIOD)
+		return 1;
+	if (!timeline.Is_Open())
+		return 2;
+
+	// by the timeline's own IDs, which the system's needn't match
+	Timeline::Entry entry;
+	if (*end == ':')
+	{
+		uint32_t id = timeline.Find(end + 1);
+		if (id == Timeline::npos || !timeline.Get(id, period, entry))
+			return 3;
+		std::printf("\n%s at period %lu:\t%.0f (+/- %.0f), volatility %.6f\n\n", end + 1, period, entry.rating, entry.rd, entry.vol);
+		return 0;
 	}
+
+	std::vector<Timeline::Entry> entries;
+	timeline.Get_All(period, entries);
+	std::vector<uint32_t> order;
+	for (uint32_t id = 0; id < entries.size(); id++)
+		if (entries[id].recorded != Timeline::NO_PERIOD)
+			order.push_back(id);
+	std::sort(order.begin(), order.end(), [](uint32_t a, uint32_t b) { return timeline.Get_Name(a) < timeline.Get_Name(b); });
+	std::printf("\nRatings at period %lu:\n\n", period);
+	for (uint32_t id : order)
+		std::printf("%s\t%.0f (+/- %.0f)\n", timeline.Get_Name(id).c_str(), entries[id].rating, entries[id].rd);
+	std::cout << std::endl;
+	return 0;
+}
+
+int output_stats (const char* filename)
+{
+	size_t length = std::strlen(filename);
+	bool prometheus = length >= 5 && std::strcmp(filename + length - 5, ".prom") == 0;
+	std::string text { prometheus ? Stats::To_Prometheus() : Stats::To_JSON() };
+
+	FILE* out = std::fopen(filename, "w");
+	if (!out)
+		return 1;
+	bool ok = std::fwrite(text.data(), 1, text.size(), out) == text.size();
+	return std::fclose(out) == 0 && ok ? 0 : 1;
 }
 
 int output_to_csv(const char* filename, bool results_flag)
 {
-	// write to csv
+	// written in the format its extension names, CSV unless .jsonl or .bin
 	std::string tmp_filename {filename};
 	tmp_filename.insert(0, "./player-data/");
-	std::fstream fout; std::ifstream f{tmp_filename};
+	std::ifstream f{tmp_filename};
 	if (f.good())
 		return 1;
-	fout.open(tmp_filename, std::fstream::out);
 
-	for (const auto& kv : glicko_system.Get_Players())
+	Exporter exporter { num_threads };
+	if (exporter.Write(tmp_filename.c_str(), glicko_system, Exporter::Format_Of(filename), results_flag ? "./player-data/" : nullptr) != Exporter::OK)
 	{
-		fout << kv.first.c_str() << "," << kv.second.Get_Rating() << "," << kv.second.Get_RD() << "," << kv.second.Get_Vol() << ",";
-		if (kv.second.Get_Match_History().size() != 0 && results_flag)
-		{
-			fout << kv.first.c_str() << "-results.csv";
-
-			std::fstream fresultsout; fresultsout.open(("./player-data/" + kv.first + "-results.csv").c_str(), std::fstream::out);
-			for (const auto& match : kv.second.Get_Match_History())
-				fresultsout << match.first.Get_Name() << "," << match.first.Get_Rating() << "," << match.first.Get_RD() << "," << match.first.Get_Vol() << "," << match.second << std::endl;
-
-			fresultsout.close();
-		}
-		fout << std::endl;
+		std::fprintf(stderr, "Could not write \"%s\".\n", exporter.Get_Error_File().c_str());
+		return 2;
 	}
-
-	fout.close();
-
 	return 0;
 }
 
@@ -182,75 +548,31 @@ bool prompt (const char* message, char& readch)
 
 int load (const char* filename)
 {
-	std::string tmp_filename {filename};
-
-	std::fstream fin;
-	fin.open(filename, std::fstream::in);
-	if (!fin.is_open())
-	{
-		fin.close();
-		fin.clear();
-		fin.open(("./player-data/"+tmp_filename).c_str(), std::fstream::in);
-		if (!fin.is_open())
-			return 1;
-	}
-
-	std::vector<std::string> row;
-	std::string line;
-	std::string token;
-	while (std::getline(fin, line))
-	{
-		row.clear();
-		std::stringstream linestream {line};
-
-		while (std::getline(linestream, token, ','))
-			row.push_back(token);
-
-		Player tmp_player { row[0], std::stoi(row[1]), std::stoi(row[2]), std::stod(row[3]) };
-		if (!linestream && !token.empty())
-		{
-			std::fstream fresultsin;
-			fresultsin.open(row[4].c_str(), std::fstream::in);
-			if (!fresultsin.is_open())
-			{
-				fresultsin.close();
-				fresultsin.clear();
-				fresultsin.open(("./player-data/"+row[4]).c_str(), std::fstream::in);
-				if (!fresultsin.is_open())
-					return 2;
-			}
-
-			std::vector<std::string> results_row;
-			std::string results_line;
-			std::string results_token;
-			while (std::getline(fresultsin, results_line))
-			{
-				results_row.clear();
-				std::stringstream results_linestream {results_line};
-
-				while (std::getline(results_linestream, results_token, ','))
-					results_row.push_back(results_token);
-
-				Player tmp_opp { results_row[0], std::stoi(results_row[1]), std::stoi(results_row[2]), std::stod(results_row[3]) };
-				tmp_player.Add_Match(tmp_opp, std::stoi(results_row[4]));
-			}
-
-			fresultsin.close();
-		}
-		glicko_system.Add_Player(tmp_player);
-	}
-
-	fin.close();
+	Stats::Timer timer { Stats::CSV_LOAD };
+	// the results files are read by as many threads as rating uses, or
+	// without --threads by one per hardware thread
+	CsvLoader loader { num_threads, "./player-data/" };
+	int ret = loader.Load(filename, glicko_system);
+	if (ret == CsvLoader::BAD_SYSTEM_ROW)
+		std::fprintf(stderr, "%s:%zu: malformed row, expected [player name],[rating],[rd],[volatility],[results-file.csv]\n", filename, loader.Get_Error_Line());
+	if (ret == CsvLoader::BAD_RESULTS_ROW)
+		std::fprintf(stderr, "%s:%zu: malformed row, expected [opponent name],[rating],[rd],[volatility],[score]\n", loader.Get_Error_File().c_str(), loader.Get_Error_Line());
+	if (ret == CsvLoader::BAD_SYSTEM_ROW || ret == CsvLoader::BAD_RESULTS_ROW)
+		return 3;
+	if (ret != CsvLoader::OK)
+		return ret;
+	timer.Stop();
 
 	std::cout << "\nSuccessfully loaded Glicko-2 System from \"" << filename << "\"." << std::endl;
 
 	std::cout << std::endl << std::endl;
 
-	if (glicko_system.Get_Players().size() == 0)
+	if (glicko_system.Num_Players() == 0)
 		return 0;
 
 	std::cout << "Players in this Glicko-2 System:\n\n" << std::endl;
 	output_to_console();
+	return 0;
 }
 
 int create (const char* filename)
@@ -350,7 +672,7 @@ int create (const char* filename)
 						std::cout << "\nInvalid selection, please try again.\n\n";
 					}
 				}
-				glicko_system.Add_Player(tmp);
+				glicko_system.Add_Player(std::move(tmp));
 				break;
 			}
 			if (selection == '\n' || selection == 'N' || selection == 'n')
@@ -411,8 +733,7 @@ int create (const char* filename)
 						std::cout << "\nPlease enter either a value of 1 or 0, for whether the player or opponent won, respectively.\n\n";
 					} while (true);
 
-					Player opp_tmp { opponent_name, opp_tmp_rtg, opp_tmp_rd, opp_tmp_vol };
-					tmp.Add_Match(opp_tmp, opp_tmp_score);
+					tmp.Add_Match(Player{ opponent_name, opp_tmp_rtg, opp_tmp_rd, opp_tmp_vol }, opp_tmp_score);
 
 					std::cout << std::endl;
 
@@ -431,7 +752,7 @@ int create (const char* filename)
 					}
 				}
 
-				glicko_system.Add_Player(tmp);
+				glicko_system.Add_Player(std::move(tmp));
 				break;
 			}
 			std::cout << "\nInvalid selection, please try again.\n\n";
@@ -456,7 +777,7 @@ int create (const char* filename)
 
 	std::cout << std::endl << std::endl;
 
-	if (glicko_system.Get_Players().size() == 0)
+	if (glicko_system.Num_Players() == 0)
 		return 0;
 
 	std::cout << "Players in this Glicko-2 System:\n\n" << std::endl;
@@ -468,12 +789,19 @@ int create (const char* filename)
 
 int run_glicko2 (const char* filename)
 {
-	if (glicko_system.Get_Players().size() == 0)
+	if (glicko_system.Num_Players() == 0)
 		return 1;
+	// the calibrated data are named after the file the system came from,
+	// which a system recovered from a journal doesn't have
+	if (!filename)
+		return 4;
 
 	std::cout << "\nRunning Glicko-2 on current player data ... \n\n";
 
-	glicko_system.Run();
+	if (num_shards == 1)
+		glicko_system.Run();
+	else if (run_sharded() != 0)
+		return 2;
 
 	std::cout << "Calibrated Glicko-2 ratings:\n\n" << std::endl;
 	output_to_console();
@@ -487,5 +815,117 @@ int run_glicko2 (const char* filename)
 	fnm += filename;
 
 	std::cout << "Writing calibrated data to \"" << fnm << "\"\n\n";
-	return output_to_csv(fnm.c_str(), false);
+	return output_to_csv(fnm.c_str(), false) == 0 ? 0 : 3;
+}
+
+int run_sharded ()
+{
+	// the snapshot broadcast to the workers and their results go in a
+	// scratch directory
+	const char* tmpdir = std::getenv("TMPDIR");
+	std::string dir { tmpdir && *tmpdir ? tmpdir : "/tmp" };
+	dir += "/glicko2-shards-XXXXXX";
+	if (!mkdtemp(&dir[0]))
+		return 1;
+	std::string snapshot_filename { dir + "/system.snapshot" };
+
+	Snapshot snapshot;
+	bool ok = Snapshot::Write(snapshot_filename.c_str(), glicko_system) == Snapshot::OK
+		&& snapshot.Open(snapshot_filename.c_str(), false) == Snapshot::OK;
+
+	std::vector<std::string> result_filenames;
+	std::vector<pid_t> workers;
+	for (unsigned k = 0; ok && k < num_shards; k++)
+	{
+		result_filenames.push_back(dir + "/" + std::to_string(k) + ".shard");
+		std::string load { "--load-snapshot=" + snapshot_filename };
+		std::string shard { "--shard=" + std::to_string(k) + "/" + std::to_string(num_shards) + ":" + result_filenames.back() };
+
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			// the workers' reports would only interleave with ours
+			int null = ::open("/dev/null", O_WRONLY);
+			if (null >= 0)
+				dup2(null, STDOUT_FILENO);
+			execl("/proc/self/exe", "glicko2-client", load.c_str(), shard.c_str(), static_cast<char*>(nullptr));
+			_exit(127);
+		}
+		if (pid < 0)
+			ok = false;
+		else
+			workers.push_back(pid);
+	}
+	for (pid_t pid : workers)
+	{
+		int status;
+		ok = waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 && ok;
+	}
+
+	std::vector<Shard> shards (num_shards);
+	for (unsigned k = 0; ok && k < num_shards; k++)
+		ok = shards[k].Read(result_filenames[k].c_str()) == Shard::OK && shards[k].Get_Source() == snapshot.Get_Checksum();
+	ok = ok && glicko_system.Merge_Shards(shards);
+
+	snapshot.Close();
+	for (const std::string& result_filename : result_filenames)
+		std::remove(result_filename.c_str());
+	std::remove(snapshot_filename.c_str());
+	::rmdir(dir.c_str());
+	return ok ? 0 : 1;
+}
+
+int run_shard (const char* spec)
+{
+	unsigned shard, count;
+	int length = 0;
+	if (std::sscanf(spec, "%u/%u:%n", &shard, &count, &length) != 2 || length == 0 || spec[length] == '\0' || count == 0 || shard >= count)
+		return 1;
+
+	Shard result;
+	glicko_system.Run_Shard(shard, count, result);
+	result.Set_Source(snapshot_checksum);
+	return result.Write(spec + length) == Shard::OK ? 0 : 2;
+}
+
+int load_snapshot (const char* filename)
+{
+	std::string tmp_filename {filename};
+
+	Snapshot snapshot;
+	int ret = snapshot.Open(filename);
+	if (ret == Snapshot::CANNOT_OPEN)
+		ret = snapshot.Open(("./player-data/"+tmp_filename).c_str());
+	if (ret != Snapshot::OK)
+		return ret;
+
+	glicko_system.Load(snapshot);
+	snapshot_checksum = snapshot.Get_Checksum();
+
+	std::cout << "\nSuccessfully loaded Glicko-2 System from \"" << filename << "\" (" << snapshot.Size() << " players, " << snapshot.Num_Matches() << " matches)." << std::endl << std::endl;
+	return Snapshot::OK;
+}
+
+int save_snapshot (const char* filename)
+{
+	std::cout << "Writing snapshot to \"" << filename << "\"\n\n";
+	return Snapshot::Write(filename, glicko_system);
+}
+
+int serve (const char* socket_path)
+{
+	if (glicko_system.Has_Rated_Matches())
+		glicko_system.Clear_Matches();
+	Server server { glicko_system };
+	return server.Run(socket_path);
+}
+
+int open_journal (const char* filename)
+{
+	std::string checkpoint_filename { filename };
+	checkpoint_filename += ".checkpoint";
+	int ret = glicko_system.Open_Log(filename, checkpoint_filename.c_str());
+	if (ret == Snapshot::OK)
+		std::cout << "\nRecovered Glicko-2 System from journal \"" << filename << "\" (" << glicko_system.Get_Store().Size() << " players)." << std::endl << std::endl;
+	return ret;
 }